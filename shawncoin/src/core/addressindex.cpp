@@ -0,0 +1,68 @@
+#include "core/addressindex.hpp"
+#include <cstring>
+
+namespace shawncoin {
+
+std::optional<Hash160> scriptHash160(const Script& s) {
+    if (s.size() != 25 || s[0] != 0x76 || s[1] != 0xa9 || s[2] != 0x14 || s[23] != 0x88 || s[24] != 0xac)
+        return std::nullopt;
+    Hash160 h;
+    memcpy(h.data(), s.data() + 3, h.size());
+    return h;
+}
+
+size_t AddressIndex::KeyHasher::operator()(const Hash160& h) const {
+    // hash160 output is already uniform
+    size_t v = 0;
+    memcpy(&v, h.data(), sizeof(v));
+    return v;
+}
+
+void AddressIndex::add(const OutPoint& out, uint64_t amount, const Script& script) {
+    auto h = scriptHash160(script);
+    if (!h) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (map_[*h].insert_or_assign(out, amount).second) ++count_;
+}
+
+void AddressIndex::remove(const OutPoint& out, const Script& script) {
+    auto h = scriptHash160(script);
+    if (!h) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = map_.find(*h);
+    if (it == map_.end() || it->second.erase(out) == 0) return;
+    --count_;
+    if (it->second.empty()) map_.erase(it);
+}
+
+std::vector<AddressIndex::Entry> AddressIndex::get(const Hash160& hash) const {
+    std::vector<Entry> out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = map_.find(hash);
+    if (it == map_.end()) return out;
+    out.reserve(it->second.size());
+    for (const auto& kv : it->second) out.push_back({ kv.first, kv.second });
+    return out;
+}
+
+uint64_t AddressIndex::getBalance(const Hash160& hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = map_.find(hash);
+    if (it == map_.end()) return 0;
+    uint64_t sum = 0;
+    for (const auto& kv : it->second) sum += kv.second;
+    return sum;
+}
+
+size_t AddressIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+void AddressIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    map_.clear();
+    count_ = 0;
+}
+
+} // namespace shawncoin
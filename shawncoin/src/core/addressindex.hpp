@@ -0,0 +1,49 @@
+#ifndef SHAWNCOIN_CORE_ADDRESSINDEX_HPP
+#define SHAWNCOIN_CORE_ADDRESSINDEX_HPP
+
+#include "core/types.hpp"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace shawncoin {
+
+using Hash160 = std::array<uint8_t, 20>;
+
+/** Hash160 paid to by a standard P2PKH script, if it is one. */
+std::optional<Hash160> scriptHash160(const Script& script);
+
+/** Secondary index of unspent P2PKH coins by hash160. Thread-safe.
+ *  Lookups cost O(coins returned), not O(UTXO set). */
+class AddressIndex {
+public:
+    struct Entry {
+        OutPoint outpoint;
+        uint64_t amount = 0;
+    };
+
+    /** Record a new coin; scripts that are not P2PKH are ignored. */
+    void add(const OutPoint& out, uint64_t amount, const Script& script);
+    void remove(const OutPoint& out, const Script& script);
+    std::vector<Entry> get(const Hash160& hash) const;
+    uint64_t getBalance(const Hash160& hash) const;
+    size_t size() const;
+    void clear();
+
+private:
+    struct KeyHasher {
+        size_t operator()(const Hash160& h) const;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Hash160, std::map<OutPoint, uint64_t>, KeyHasher> map_;
+    size_t count_ = 0;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_ADDRESSINDEX_HPP
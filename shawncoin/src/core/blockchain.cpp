@@ -1,9 +1,18 @@
 #include "core/blockchain.hpp"
 #include "core/block.hpp"
 #include "core/consensus.hpp"
+#include "core/mempool.hpp"
 #include "storage/chainstate.hpp"
+#include "storage/utxosnapshot.hpp"
+#include "mining/difficulty.hpp"
+#include "util/checkqueue.hpp"
+#include "util/logger.hpp"
+#include "util/util.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 namespace shawncoin {
 
@@ -13,7 +22,15 @@ Blockchain::Blockchain() {
     height_ = 0;
     blockCache_[bestBlockHash_] = genesis;
     heightIndex_[0] = bestBlockHash_;
+    BlockIndex idx;
+    idx.hash = bestBlockHash_;
+    idx.height = 0;
+    idx.timestamp = genesis.header.timestamp;
+    idx.bits = genesis.header.difficulty_target;
+    idx.chainWork = getBlockWork(idx.bits);
+    index_[bestBlockHash_] = idx;
     connectBlockUTXO(genesis, utxo_);
+    stats_.push_back(makeStats(genesis, 0, BlockUndo{}));
 }
 
 Blockchain::~Blockchain() = default;
@@ -34,30 +51,168 @@ bool Blockchain::init(const std::string& dataDir) {
     return true;
 }
 
+void Blockchain::setCoinsBackend(CoinsView* coins, size_t cacheBytes) {
+    std::lock_guard<std::mutex> vlock(validationMutex_);
+    bool current = coins && coins->getBestBlock() == getBestBlockHash();
+    if (coins && !current) coins->clear();
+    utxo_.setBackend(coins, cacheBytes, !current);
+    SHAWNCOIN_LOG(Info, "chain", "UTXO backend %s, %zu coins, cache budget %zu bytes",
+        current ? "resumed" : "rebuilt", utxo_.size(), cacheBytes);
+}
+
+UTXOSetInfo Blockchain::getUTXOSetInfo() {
+    std::lock_guard<std::mutex> vlock(validationMutex_);
+    UTXOSetInfo info;
+    info.bestBlock = getBestBlockHash();
+    info.height = getHeight();
+    info.stats = utxo_.stats();
+    return info;
+}
+
+bool Blockchain::dumpUTXOSet(const std::string& path, UTXOSnapshotMeta& meta) {
+    std::lock_guard<std::mutex> vlock(validationMutex_); // the tip must not move during the scan
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const BlockIndex& tip = index_.at(bestBlockHash_);
+        meta.blockHash = tip.hash;
+        meta.height = tip.height;
+        meta.bits = tip.bits;
+        meta.timestamp = tip.timestamp;
+        meta.chainWork = tip.chainWork;
+        meta.totalSupply = stats_.back().totalSupply;
+        meta.totalTxCount = stats_.back().totalTxCount;
+    }
+    meta.setHash = utxo_.stats().muhash.digest();
+    return writeUTXOSnapshot(path, meta, utxo_);
+}
+
+bool Blockchain::loadUTXOSet(const std::string& path, UTXOSnapshotMeta& meta) {
+    std::vector<std::vector<std::pair<OutPoint, Coin>>> segments;
+    if (!readUTXOSnapshot(path, meta, segments)) return false;
+    std::lock_guard<std::mutex> vlock(validationMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.count(meta.blockHash)) {
+            if (meta.blockHash != bestBlockHash_) {
+                SHAWNCOIN_LOG(Error, "chain", "Snapshot block %s is not the tip", uint256ToHex(meta.blockHash).c_str());
+                return false;
+            }
+        } else if (height_ != 0 || meta.height == 0) {
+            SHAWNCOIN_LOG(Error, "chain", "Snapshot block %s is unknown and the chain is past genesis",
+                uint256ToHex(meta.blockHash).c_str());
+            return false;
+        } else {
+            // The file vouches only for itself: its block must be one we were told to trust
+            auto trusted = trustedSnapshots_.find(meta.blockHash);
+            if (trusted == trustedSnapshots_.end()) {
+                SHAWNCOIN_LOG(Error, "chain", "Snapshot block %s is not a trusted snapshot",
+                    uint256ToHex(meta.blockHash).c_str());
+                return false;
+            }
+            if (trusted->second.height != meta.height || trusted->second.setHash != meta.setHash) {
+                SHAWNCOIN_LOG(Error, "chain", "Snapshot of block %s does not match its trusted height or coins hash",
+                    uint256ToHex(meta.blockHash).c_str());
+                return false;
+            }
+            // Start the active chain at the snapshot block; its ancestors stay unknown
+            BlockIndex idx;
+            idx.hash = meta.blockHash;
+            idx.height = meta.height;
+            idx.timestamp = meta.timestamp;
+            idx.bits = meta.bits;
+            idx.chainWork = meta.chainWork;
+            index_[idx.hash] = idx;
+            heightIndex_[idx.height] = idx.hash;
+            bestBlockHash_ = idx.hash;
+            height_ = idx.height;
+            ChainStats st;
+            st.height = idx.height;
+            st.timestamp = idx.timestamp;
+            st.totalSupply = meta.totalSupply;
+            st.totalTxCount = meta.totalTxCount;
+            stats_.resize(idx.height);
+            stats_.push_back(st);
+            undo_.clear();
+            if (chainState_) chainState_->setBestBlock(bestBlockHash_, height_);
+        }
+    }
+
+    utxo_.clear();
+    if (addressIndex_) {
+        addressIndex_->clear();
+        for (const auto& segment : segments)
+            for (const auto& kv : segment) addressIndex_->add(kv.first, kv.second.amount, kv.second.script_pubkey);
+    }
+    // The set is sharded, so segments can be inserted from several threads at once
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < segments.size();) {
+            for (auto& kv : segments[i]) {
+                utxo_.put(kv.first, kv.second.amount, std::move(kv.second.script_pubkey));
+            }
+            segments[i].clear();
+            segments[i].shrink_to_fit();
+        }
+    };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads && t < segments.size(); ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    if (!utxo_.flush(meta.blockHash)) {
+        SHAWNCOIN_LOG(Error, "chain", "Failed to write loaded UTXO snapshot to the coins database");
+        return false;
+    }
+    SHAWNCOIN_LOG(Info, "chain", "Loaded UTXO snapshot: %llu coins at height %llu (%s)",
+        (unsigned long long)meta.coinCount, (unsigned long long)meta.height, uint256ToHex(meta.blockHash).c_str());
+    return true;
+}
+
+void Blockchain::addTrustedSnapshot(const TrustedSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trustedSnapshots_[snapshot.blockHash] = snapshot;
+}
+
+void Blockchain::enableAddressIndex() {
+    std::lock_guard<std::mutex> vlock(validationMutex_);
+    if (addressIndex_) return;
+    auto index = std::make_unique<AddressIndex>();
+    utxo_.forEach([&index](const OutPoint& out, const Coin& coin) {
+        index->add(out, coin.amount, coin.script_pubkey);
+        return true;
+    });
+    SHAWNCOIN_LOG(Info, "chain", "Address index built: %zu coins", index->size());
+    addressIndex_ = std::move(index);
+}
+
+bool Blockchain::flushCoins() {
+    std::lock_guard<std::mutex> vlock(validationMutex_);
+    return utxo_.flush(getBestBlockHash());
+}
+
 bool Blockchain::connectBlock(const Block& block, uint64_t height) {
-    if (!validateBlockStructure(block)) return false;
-    // Enforce expected difficulty relative to chain
-    if (!checkDifficulty(*this, block.header)) return false;
     for (size_t i = 1; i < block.transactions.size(); ++i) {
         if (!validateTransactionStructure(block.transactions[i])) return false;
-        for (const auto& in : block.transactions[i].inputs) {
-            OutPoint op{ in.prev_tx_hash, in.output_index };
-            if (!utxo_.has(op)) return false; // double-spend or missing
-        }
     }
-    if (!connectBlockUTXO(block, utxo_)) return false;
+    BlockUndo undo;
+    if (!connectBlockUTXO(block, utxo_, &undo, addressIndex_.get())) return false; // double-spend or missing
+    if (!checkSignatures(block, undo)) {
+        disconnectBlockUTXO(block, utxo_, undo, addressIndex_.get());
+        return false;
+    }
     std::lock_guard<std::mutex> lock(mutex_);
     uint256 hash = block.getHash();
-    blockCache_[hash] = block;
+    stats_.resize(height);
+    stats_.push_back(makeStats(block, height, undo));
     heightIndex_[height] = hash;
     bestBlockHash_ = hash;
     height_ = height;
-    
+
     // Save to persistent storage
     if (chainState_) {
-        chainState_->putBlock(hash, block);
+        chainState_->putUndo(hash, undo);
         chainState_->setBestBlock(hash, height);
-        
+
         // Save blockchain state to disk every 10 blocks
         if (height % 10 == 0) {
             auto* memoryState = dynamic_cast<MemoryChainState*>(chainState_);
@@ -66,19 +221,295 @@ bool Blockchain::connectBlock(const Block& block, uint64_t height) {
             }
         }
     }
-    
+    undo_[hash] = std::move(undo);
+    if (height > UNDO_CACHE_DEPTH) {
+        auto old = heightIndex_.find(height - UNDO_CACHE_DEPTH);
+        if (old != heightIndex_.end()) undo_.erase(old->second);
+    }
+    if (mempool_) mempool_->removeForBlock(block, height);
+
     return true;
 }
 
+bool Blockchain::checkSignatures(const Block& block, const BlockUndo& undo) const {
+    std::vector<uint256> hashes(block.transactions.size());
+    std::vector<SignatureCheck> ecdsa, schnorr;
+    std::vector<size_t> ecdsaTx, schnorrTx; // transaction of each check, for the log
+    size_t spent = 0;
+    for (size_t i = 1; i < block.transactions.size(); ++i) {
+        const Transaction& tx = block.transactions[i];
+        hashes[i] = signatureHash(tx);
+        bool isSchnorr = tx.version == TX_VERSION_SCHNORR;
+        for (const auto& in : tx.inputs) {
+            if (spent >= undo.spent.size()) return false;
+            (isSchnorr ? schnorr : ecdsa).push_back({ &in, &undo.spent[spent++].script_pubkey, &hashes[i] });
+            (isSchnorr ? schnorrTx : ecdsaTx).push_back(i);
+        }
+    }
+    // ECDSA inputs are checked one by one; Schnorr inputs in batches, each one job
+    size_t batches = (schnorr.size() + SCHNORR_BATCH_SIZE - 1) / SCHNORR_BATCH_SIZE;
+    SignatureCache* cache = sigCache_;
+    std::atomic<size_t> badTx{ 0 };
+    auto verify = [&](size_t job) {
+        if (job < ecdsa.size()) {
+            const SignatureCheck& c = ecdsa[job];
+            if (verifyInputSignature(*c.input, *c.scriptPubKey, *c.hash, cache)) return true;
+            badTx = ecdsaTx[job];
+            return false;
+        }
+        size_t begin = (job - ecdsa.size()) * SCHNORR_BATCH_SIZE;
+        size_t count = std::min(SCHNORR_BATCH_SIZE, schnorr.size() - begin);
+        if (verifySchnorrBatch(&schnorr[begin], count, cache)) return true;
+        // Find the culprit
+        for (size_t k = begin; k < begin + count; ++k) {
+            const SignatureCheck& c = schnorr[k];
+            if (!verifyInputSchnorr(*c.input, *c.scriptPubKey, *c.hash, cache)) {
+                badTx = schnorrTx[k];
+                break;
+            }
+        }
+        return false;
+    };
+    size_t jobs = ecdsa.size() + batches;
+    bool ok;
+    if (checkQueue_) {
+        ok = checkQueue_->run(jobs, verify);
+    } else {
+        ok = true;
+        for (size_t i = 0; i < jobs && ok; ++i) ok = verify(i);
+    }
+    if (!ok) {
+        size_t tx = badTx.load();
+        SHAWNCOIN_LOG(Warn, "chain", "Block %s has an invalid input signature (tx %s)",
+            uint256ToHex(block.getHash()).c_str(), tx ? uint256ToHex(block.transactions[tx].getTxid()).c_str() : "?");
+    }
+    return ok;
+}
+
+ChainStats Blockchain::makeStats(const Block& block, uint64_t height, const BlockUndo& undo) const {
+    ChainStats st;
+    st.height = height;
+    st.timestamp = block.header.timestamp;
+    st.size = serializeBlock(block).size();
+    st.txCount = block.transactions.size();
+    uint64_t spentValue = 0;
+    for (const auto& c : undo.spent) spentValue += c.amount;
+    uint64_t outputValue = 0;
+    int64_t created = 0;
+    for (size_t i = 0; i < block.transactions.size(); ++i) {
+        created += (int64_t)block.transactions[i].outputs.size();
+        if (i > 0) outputValue += block.transactions[i].getTotalOutput();
+    }
+    st.fees = spentValue > outputValue ? spentValue - outputValue : 0;
+    st.utxoDelta = created - (int64_t)undo.spent.size();
+    uint64_t coinbaseValue = block.transactions.empty() ? 0 : block.transactions[0].getTotalOutput();
+    uint64_t issued = coinbaseValue > st.fees ? coinbaseValue - st.fees : 0;
+    if (height > 0 && height - 1 < stats_.size()) {
+        const ChainStats& prev = stats_[height - 1];
+        st.interval = st.timestamp > prev.timestamp ? st.timestamp - prev.timestamp : 0;
+        st.totalSupply = prev.totalSupply + issued;
+        st.totalTxCount = prev.totalTxCount + st.txCount;
+    } else {
+        st.totalSupply = issued;
+        st.totalTxCount = st.txCount;
+    }
+    return st;
+}
+
+bool Blockchain::disconnectTip(Block& out) {
+    uint256 hash;
+    uint64_t height = 0;
+    BlockUndo undo;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (height_ == 0) return false; // never disconnect genesis
+        hash = bestBlockHash_;
+        height = height_;
+        out = blockCache_.at(hash);
+        auto u = undo_.find(hash);
+        if (u != undo_.end()) undo = u->second;
+        else if (!chainState_ || !chainState_->getUndo(hash, undo)) return false;
+    }
+    if (!disconnectBlockUTXO(out, utxo_, undo, addressIndex_.get()))
+        SHAWNCOIN_LOG(Warn, "chain", "Unclean disconnect of block %s", uint256ToHex(hash).c_str());
+    std::lock_guard<std::mutex> lock(mutex_);
+    undo_.erase(hash);
+    stats_.resize(height);
+    heightIndex_.erase(height);
+    bestBlockHash_ = out.header.previous_hash;
+    height_ = height - 1;
+    if (chainState_) chainState_->setBestBlock(bestBlockHash_, height_);
+    return true;
+}
+
+bool Blockchain::acceptBlock(const Block& block, const uint256& hash) {
+    if (!validateBlockStructure(block)) return false;
+    BlockIndex parent;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(block.header.previous_hash);
+        if (it == index_.end()) return false; // unknown parent
+        if (it->second.failed) return false;  // builds on an invalid branch
+        parent = it->second;
+    }
+    // Enforce expected difficulty relative to the branch being extended
+    if (!checkDifficulty(*this, block.header)) return false;
+    BlockIndex idx;
+    idx.hash = hash;
+    idx.prevHash = parent.hash;
+    idx.height = parent.height + 1;
+    idx.timestamp = block.header.timestamp;
+    idx.bits = block.header.difficulty_target;
+    idx.chainWork = addWork(parent.chainWork, getBlockWork(idx.bits));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index_[hash] = idx;
+        blockCache_[hash] = block;
+    }
+    if (chainState_) chainState_->putBlock(hash, block);
+    return true;
+}
+
+bool Blockchain::activateBestChain(const uint256& hash) {
+    // Walk the candidate branch back to the fork point on the active chain: O(reorg depth)
+    std::vector<BlockIndex> branch; // candidate first, fork child last
+    uint64_t forkHeight = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const BlockIndex& cand = index_.at(hash);
+        const BlockIndex& tip = index_.at(bestBlockHash_);
+        if (compareWork(cand.chainWork, tip.chainWork) <= 0) return true; // stays a side chain
+        const BlockIndex* p = &cand;
+        for (;;) {
+            auto active = heightIndex_.find(p->height);
+            if (active != heightIndex_.end() && active->second == p->hash) break;
+            branch.push_back(*p);
+            p = &index_.at(p->prevHash);
+        }
+        forkHeight = p->height;
+    }
+
+    std::vector<Block> disconnected; // old tip first
+    while (getHeight() > forkHeight) {
+        Block b;
+        if (!disconnectTip(b)) {
+            SHAWNCOIN_LOG(Warn, "chain", "Cannot reorganize to %s: no undo data at height %llu",
+                uint256ToHex(hash).c_str(), (unsigned long long)getHeight());
+            restoreChain(disconnected);
+            return false;
+        }
+        disconnected.push_back(std::move(b));
+    }
+
+    for (size_t i = branch.size(); i-- > 0;) {
+        Block block;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            block = blockCache_.at(branch[i].hash);
+        }
+        if (connectBlock(block, branch[i].height)) continue;
+        // Invalid block: mark it and its descendants on this branch, then restore the old chain
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t j = 0; j <= i; ++j) index_[branch[j].hash].failed = true;
+        }
+        SHAWNCOIN_LOG(Warn, "chain", "Block %s failed to connect at height %llu",
+            uint256ToHex(branch[i].hash).c_str(), (unsigned long long)branch[i].height);
+        while (getHeight() > forkHeight) {
+            Block b;
+            if (!disconnectTip(b)) break;
+        }
+        restoreChain(disconnected);
+        return false;
+    }
+
+    if (!disconnected.empty()) {
+        SHAWNCOIN_LOG(Info, "chain", "Reorganized: disconnected %zu block(s), connected %zu, new tip %s",
+            disconnected.size(), branch.size(), uint256ToHex(hash).c_str());
+        resubmitTransactions(disconnected);
+    }
+    if (utxo_.needsFlush() && !utxo_.flush(getBestBlockHash()))
+        SHAWNCOIN_LOG(Error, "chain", "Failed to flush UTXO cache at height %llu", (unsigned long long)getHeight());
+    return true;
+}
+
+bool Blockchain::restoreChain(const std::vector<Block>& disconnected) {
+    for (auto it = disconnected.rbegin(); it != disconnected.rend(); ++it) {
+        if (connectBlock(*it, getHeight() + 1)) continue;
+        // The UTXO set still matches the tip, but the tip is now behind the best valid chain
+        SHAWNCOIN_LOG(Error, "chain", "Failed to reconnect block %s; tip left at height %llu",
+            uint256ToHex(it->getHash()).c_str(), (unsigned long long)getHeight());
+        return false;
+    }
+    return true;
+}
+
+void Blockchain::resubmitTransactions(const std::vector<Block>& disconnected) {
+    if (!mempool_) return;
+    size_t added = 0;
+    for (auto b = disconnected.rbegin(); b != disconnected.rend(); ++b) {
+        for (size_t i = 1; i < b->transactions.size(); ++i) {
+            const Transaction& tx = b->transactions[i];
+            // Inputs must still be unspent coins or outputs of transactions put back before it
+            uint64_t in = 0;
+            bool available = true;
+            for (const auto& input : tx.inputs) {
+                if (auto coin = utxo_.get({ input.prev_tx_hash, input.output_index })) {
+                    in += coin->amount;
+                } else if (auto parent = mempool_->get(input.prev_tx_hash);
+                           parent && input.output_index < parent->outputs.size()) {
+                    in += parent->outputs[input.output_index].amount;
+                } else {
+                    available = false;
+                    break;
+                }
+            }
+            uint64_t out = tx.getTotalOutput();
+            if (available && in >= out && mempool_->add(tx, in - out)) ++added;
+        }
+    }
+    if (added)
+        SHAWNCOIN_LOG(Info, "chain", "Returned %zu transaction(s) from disconnected blocks to the mempool", added);
+}
+
 bool Blockchain::addBlock(const Block& block, uint64_t height) {
+    (void)height; // derived from the parent in the block index
+    std::lock_guard<std::mutex> vlock(validationMutex_);
     uint256 hash = block.getHash();
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (blockCache_.count(hash)) return true; // already have it
-        if (height != height_ + 1) return false;   // must be next block
-        if (block.header.previous_hash != bestBlockHash_) return false; // wrong prev
+        auto it = index_.find(hash);
+        if (it != index_.end()) return !it->second.failed; // already have it
     }
-    return connectBlock(block, height);
+    if (!acceptBlock(block, hash)) return false;
+    return activateBestChain(hash);
+}
+
+std::optional<BlockIndex> Blockchain::getBlockIndex(const uint256& hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(hash);
+    if (it == index_.end()) return std::nullopt;
+    return it->second;
+}
+
+std::optional<BlockIndex> Blockchain::getAncestor(const uint256& hash, uint64_t height) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(hash);
+    if (it == index_.end() || it->second.height < height) return std::nullopt;
+    const BlockIndex* p = &it->second;
+    while (p->height > height) {
+        auto active = heightIndex_.find(p->height);
+        if (active != heightIndex_.end() && active->second == p->hash) {
+            // On the best chain: jump directly. Below a loaded snapshot's base it is unknown.
+            auto target = heightIndex_.find(height);
+            if (target == heightIndex_.end()) return std::nullopt;
+            return index_.at(target->second);
+        }
+        auto prev = index_.find(p->prevHash);
+        if (prev == index_.end()) return std::nullopt;
+        p = &prev->second;
+    }
+    return *p;
 }
 
 std::optional<Block> Blockchain::getBlock(const uint256& hash) const {
@@ -101,6 +532,26 @@ std::optional<Block> Blockchain::getBlockByHeight(uint64_t height) const {
     return std::nullopt;
 }
 
+std::optional<ChainStats> Blockchain::getChainStats(uint64_t height) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (height >= stats_.size()) return std::nullopt;
+    return stats_[height];
+}
+
+std::vector<ChainStats> Blockchain::getChainStatsRange(uint64_t start, uint64_t count) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ChainStats> out;
+    if (start >= stats_.size()) return out;
+    uint64_t end = std::min<uint64_t>(stats_.size(), start + std::min<uint64_t>(count, stats_.size()));
+    out.assign(stats_.begin() + start, stats_.begin() + end);
+    return out;
+}
+
+uint64_t Blockchain::getTotalSupply() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.empty() ? 0 : stats_.back().totalSupply;
+}
+
 uint256 Blockchain::getBestBlockHash() const {
     std::lock_guard<std::mutex> lock(mutex_);
     return bestBlockHash_;
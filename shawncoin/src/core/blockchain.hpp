@@ -5,6 +5,8 @@
 #include "core/block.hpp"
 #include "core/utxo.hpp"
 #include "core/consensus.hpp"
+#include "core/undo.hpp"
+#include "storage/utxosnapshot.hpp"
 #include <map>
 #include <memory>
 #include <mutex>
@@ -12,24 +14,72 @@
 #include <string>
 #include <cstdint>
 #include <functional>
+#include <vector>
 
 namespace shawncoin {
 
 class ChainState;
-struct BlockIndex;
+class CheckQueue;
+class Mempool;
+class SignatureCache;
+
+/** Block index entry: one per known block, whether on the best chain or a side chain. */
+struct BlockIndex {
+    uint256 hash;
+    uint256 prevHash;
+    uint64_t height = 0;
+    uint64_t timestamp = 0;
+    uint32_t bits = 0;
+    uint256 chainWork;   // cumulative work of the branch up to and including this block
+    bool failed = false; // failed to connect; never selected as tip again
+};
+
+/** Per-height statistics of the best chain, maintained incrementally as blocks connect. */
+struct ChainStats {
+    uint64_t height = 0;
+    uint64_t timestamp = 0;
+    uint64_t interval = 0;     // seconds since the parent block (0 if timestamps go backwards)
+    uint64_t size = 0;         // serialized block size in bytes
+    uint64_t txCount = 0;      // transactions in the block, including coinbase
+    uint64_t fees = 0;         // input value minus output value of non-coinbase transactions
+    int64_t utxoDelta = 0;     // outputs created minus coins spent
+    uint64_t totalSupply = 0;  // coins issued up to and including this block
+    uint64_t totalTxCount = 0; // transactions up to and including this block
+};
+
+/** UTXO set totals and commitment, with the tip they describe. */
+struct UTXOSetInfo {
+    uint256 bestBlock{};
+    uint64_t height = 0;
+    CoinsStats stats;
+};
 
 /** In-memory blockchain with optional persistent storage. */
 class Blockchain {
 public:
+    /** Schnorr inputs checked together in one batch verification (one check queue job). */
+    static constexpr size_t SCHNORR_BATCH_SIZE = 64;
+    /** Recent blocks whose undo records stay in memory. Older ones are read back from the
+     *  chain state; without one, reorgs deeper than this are refused. */
+    static constexpr uint64_t UNDO_CACHE_DEPTH = 288;
+
     Blockchain();
     ~Blockchain();
 
     /** Initialize with genesis; load from storage if available. */
     bool init(const std::string& dataDir);
 
-    /** Add block; returns true if accepted (best or side chain). */
+    /** Add block; returns true if accepted (best or side chain). The height is derived from
+     *  the parent in the block index; the argument is kept for callers that know it. If the
+     *  block's branch has more cumulative work than the tip, the chain reorganizes to it. */
     bool addBlock(const Block& block, uint64_t height);
 
+    /** Index entry for a known block (best or side chain). */
+    std::optional<BlockIndex> getBlockIndex(const uint256& hash) const;
+
+    /** Ancestor of the given block at the given height, following that block's branch. */
+    std::optional<BlockIndex> getAncestor(const uint256& hash, uint64_t height) const;
+
     /** Get block by hash (from storage/cache). */
     std::optional<Block> getBlock(const uint256& hash) const;
 
@@ -40,6 +90,15 @@ public:
     uint256 getBestBlockHash() const;
     uint64_t getHeight() const;
 
+    /** Statistics for a best-chain height; O(1). */
+    std::optional<ChainStats> getChainStats(uint64_t height) const;
+
+    /** Statistics for up to count best-chain heights starting at start. */
+    std::vector<ChainStats> getChainStatsRange(uint64_t start, uint64_t count) const;
+
+    /** Coins issued up to the tip; O(1). */
+    uint64_t getTotalSupply() const;
+
     /** Get genesis block. */
     Block getGenesisBlock() const;
 
@@ -47,21 +106,85 @@ public:
     UTXOSet& utxo() { return utxo_; }
     const UTXOSet& utxo() const { return utxo_; }
 
-    /** Validate and connect a block (consensus + UTXO). */
-    bool connectBlock(const Block& block, uint64_t height);
+    /** Back the UTXO set with a persistent store, caching up to cacheBytes in memory.
+     *  A store whose best block is not the current tip is wiped and rebuilt from the cache. */
+    void setCoinsBackend(CoinsView* coins, size_t cacheBytes);
+
+    /** Write the UTXO cache to its backend as of the current tip. */
+    bool flushCoins();
+
+    /** Coin count, total amount and MuHash of the UTXO set at the tip; no scan involved. */
+    UTXOSetInfo getUTXOSetInfo();
+
+    /** Write the UTXO set at the tip to a snapshot file; meta describes what was written. */
+    bool dumpUTXOSet(const std::string& path, UTXOSnapshotMeta& meta);
+
+    /** Replace the UTXO set with a snapshot. The snapshot block must be the tip, or, on a
+     *  chain that has only genesis, becomes the new tip (blocks below it are not available);
+     *  the latter only for a block registered with addTrustedSnapshot(). False if the coins
+     *  could not be written to the coins database. */
+    bool loadUTXOSet(const std::string& path, UTXOSnapshotMeta& meta);
+
+    /** Allow loadUTXOSet() to start the chain at this snapshot. */
+    void addTrustedSnapshot(const TrustedSnapshot& snapshot);
+
+    /** Build the hash160 -> coins index from the UTXO set and keep it updated from now on. */
+    void enableAddressIndex();
+    /** Address index, or null when not enabled. */
+    const AddressIndex* addressIndex() const { return addressIndex_.get(); }
 
     /** Chainstate / storage backend (optional). */
     void setChainState(ChainState* state) { chainState_ = state; }
     ChainState* getChainState() const { return chainState_; }
 
+    /** Mempool to clear of transactions confirmed or conflicted by each connected block. */
+    void setMempool(Mempool* mempool) { mempool_ = mempool; }
+
+    /** Queue to spread input signature checks over when connecting blocks; without one they
+     *  run on the connecting thread. */
+    void setCheckQueue(CheckQueue* queue) { checkQueue_ = queue; }
+
+    /** Signatures verified on mempool entry, so confirming them needs no ECDSA work. Block
+     *  signatures are not added: a confirmed transaction is not checked again. */
+    void setSignatureCache(SignatureCache* cache) { sigCache_ = cache; }
+
 private:
+    /** Validate block against its parent and add it to the index (does not connect it). */
+    bool acceptBlock(const Block& block, const uint256& hash);
+    /** Make the branch ending at hash active if it has more work than the tip. */
+    bool activateBestChain(const uint256& hash);
+    /** Validate and connect a block on top of the tip (consensus + UTXO + undo). */
+    bool connectBlock(const Block& block, uint64_t height);
+    /** Verify every non-coinbase input signature against the coin it spent (undo.spent, in
+     *  input order): ECDSA inputs one per job, Schnorr ones in batches of SCHNORR_BATCH_SIZE.
+     *  Stops at the first invalid job. */
+    bool checkSignatures(const Block& block, const BlockUndo& undo) const;
+    /** Statistics for a block about to become the tip at height (requires mutex_). */
+    ChainStats makeStats(const Block& block, uint64_t height, const BlockUndo& undo) const;
+    /** Disconnect the tip using its undo record; the removed block is returned in out. */
+    bool disconnectTip(Block& out);
+    /** Reconnect blocks disconnected by a reorg that could not complete (old tip first). */
+    bool restoreChain(const std::vector<Block>& disconnected);
+    /** Return transactions of blocks a reorg disconnected (old tip first) to the mempool,
+     *  unless the new chain confirmed or conflicted with them. */
+    void resubmitTransactions(const std::vector<Block>& disconnected);
+
     UTXOSet utxo_;
     mutable std::mutex mutex_;
+    std::mutex validationMutex_; // serializes addBlock (accept, connect, reorg)
     uint256 bestBlockHash_;
     uint64_t height_ = 0;
     std::map<uint256, Block> blockCache_;
-    std::map<uint64_t, uint256> heightIndex_;
+    std::map<uint256, BlockIndex> index_;     // every known block
+    std::map<uint64_t, uint256> heightIndex_; // best chain only
+    std::map<uint256, BlockUndo> undo_;       // last UNDO_CACHE_DEPTH connected blocks
+    std::vector<ChainStats> stats_;           // best chain, indexed by height
+    std::map<uint256, TrustedSnapshot> trustedSnapshots_; // by block hash
     ChainState* chainState_ = nullptr;
+    Mempool* mempool_ = nullptr;
+    CheckQueue* checkQueue_ = nullptr;
+    SignatureCache* sigCache_ = nullptr;
+    std::unique_ptr<AddressIndex> addressIndex_; // optional, set once by enableAddressIndex
 };
 
 } // namespace shawncoin
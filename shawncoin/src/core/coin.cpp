@@ -0,0 +1,108 @@
+#include "core/coin.hpp"
+#include <cstring>
+
+namespace shawncoin {
+
+namespace {
+
+const size_t P2PKH_SIZE = 25;
+
+void writeVarInt(std::vector<uint8_t>& out, uint64_t n) {
+    while (n >= 0x80) {
+        out.push_back((uint8_t)(n | 0x80));
+        n >>= 7;
+    }
+    out.push_back((uint8_t)n);
+}
+
+bool readVarInt(const uint8_t* data, size_t len, size_t& pos, uint64_t& n) {
+    n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= len) return false;
+        uint8_t b = data[pos++];
+        n |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool isP2PKH(const Script& s) {
+    return s.size() == P2PKH_SIZE && s[0] == 0x76 && s[1] == 0xa9 && s[2] == 0x14 && s[23] == 0x88 && s[24] == 0xac;
+}
+
+uint64_t compressAmount(uint64_t n) {
+    if (n == 0) return 0;
+    int e = 0;
+    while ((n % 10) == 0 && e < 9) {
+        n /= 10;
+        ++e;
+    }
+    if (e < 9) {
+        int d = (int)(n % 10);
+        n /= 10;
+        return 1 + (n * 9 + d - 1) * 10 + e;
+    }
+    return 1 + (n - 1) * 10 + 9;
+}
+
+uint64_t decompressAmount(uint64_t x) {
+    if (x == 0) return 0;
+    --x;
+    int e = (int)(x % 10);
+    x /= 10;
+    uint64_t n = 0;
+    if (e < 9) {
+        int d = (int)(x % 9) + 1;
+        x /= 9;
+        n = x * 10 + d;
+    } else {
+        n = x + 1;
+    }
+    while (e--) n *= 10;
+    return n;
+}
+
+void encodeCoin(const Coin& coin, std::vector<uint8_t>& out) {
+    writeVarInt(out, compressAmount(coin.amount));
+    const Script& s = coin.script_pubkey;
+    if (isP2PKH(s)) {
+        out.push_back(0);
+        out.insert(out.end(), s.begin() + 3, s.begin() + 23);
+        return;
+    }
+    writeVarInt(out, s.size() + 1);
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+bool decodeCoin(const uint8_t* data, size_t len, Coin& coin, size_t& used) {
+    size_t pos = 0;
+    uint64_t x = 0, tag = 0;
+    if (!readVarInt(data, len, pos, x) || !readVarInt(data, len, pos, tag)) return false;
+    coin.amount = decompressAmount(x);
+    if (tag == 0) {
+        if (len - pos < 20) return false;
+        coin.script_pubkey.assign({ 0x76, 0xa9, 0x14 });
+        coin.script_pubkey.insert(coin.script_pubkey.end(), data + pos, data + pos + 20);
+        coin.script_pubkey.push_back(0x88);
+        coin.script_pubkey.push_back(0xac);
+        used = pos + 20;
+        return true;
+    }
+    uint64_t size = tag - 1;
+    if (len - pos < size) return false;
+    coin.script_pubkey.assign(data + pos, data + pos + size);
+    used = pos + size;
+    return true;
+}
+
+size_t encodedCoinSize(const uint8_t* data) {
+    size_t pos = 0;
+    uint64_t x = 0, tag = 0;
+    readVarInt(data, SIZE_MAX, pos, x);
+    readVarInt(data, SIZE_MAX, pos, tag);
+    return pos + (tag == 0 ? 20 : tag - 1);
+}
+
+} // namespace shawncoin
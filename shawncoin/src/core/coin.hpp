@@ -0,0 +1,35 @@
+#ifndef SHAWNCOIN_CORE_COIN_HPP
+#define SHAWNCOIN_CORE_COIN_HPP
+
+#include "core/types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shawncoin {
+
+/** Unspent transaction output. */
+struct Coin {
+    uint64_t amount = 0;
+    Script script_pubkey;
+};
+
+/** OP_DUP OP_HASH160 <20-byte key hash> OP_EQUALVERIFY OP_CHECKSIG */
+bool isP2PKH(const Script& s);
+
+/** Amount with trailing decimal zeros folded into an exponent (round amounts become small). */
+uint64_t compressAmount(uint64_t amount);
+uint64_t decompressAmount(uint64_t x);
+
+/** Compact coin encoding: varint(compressAmount(amount)) then the script, where a standard
+ *  P2PKH script is a 0 tag plus its 20-byte hash and anything else is varint(size + 1) plus
+ *  the raw bytes. Used for cached coins in memory and for coins on disk. */
+void encodeCoin(const Coin& coin, std::vector<uint8_t>& out);
+/** Decode one coin from data; used is set to the bytes consumed. */
+bool decodeCoin(const uint8_t* data, size_t len, Coin& coin, size_t& used);
+/** Bytes taken by the encoded coin at data (which must be well formed). */
+size_t encodedCoinSize(const uint8_t* data);
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_COIN_HPP
@@ -0,0 +1,151 @@
+#include "core/coinsmap.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace shawncoin {
+
+namespace {
+
+const size_t MIN_CAPACITY = 16;
+const size_t MIN_CHUNK = 256;
+
+} // namespace
+
+size_t CoinsMap::findSlot(const OutPoint& out, uint32_t hash) const {
+    if (slots_.empty()) return npos;
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& s = slots_[i];
+        if (!s.used) return npos;
+        if (s.hash == hash && s.out == out) return i;
+    }
+}
+
+size_t CoinsMap::find(const OutPoint& out, uint64_t hash) const {
+    return findSlot(out, (uint32_t)hash);
+}
+
+void CoinsMap::grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(old.empty() ? MIN_CAPACITY : old.size() * 2);
+    size_t mask = slots_.size() - 1;
+    for (auto& s : old) {
+        if (!s.used) continue;
+        size_t i = s.hash & mask;
+        while (slots_[i].used) i = (i + 1) & mask;
+        slots_[i] = s;
+    }
+}
+
+const uint8_t* CoinsMap::coinData(uint32_t ref) const {
+    return chunks_[ref >> CHUNK_BITS].data.get() + (ref & (CHUNK_SIZE - 1));
+}
+
+uint32_t CoinsMap::allocate(const uint8_t* data, size_t len) {
+    if (chunks_.empty() || chunks_.back().capacity - chunks_.back().used < len) {
+        // Encodings never span chunks; an oversized script gets a chunk of its own
+        Chunk c;
+        c.capacity = std::max(len, std::min(CHUNK_SIZE, std::max(MIN_CHUNK, arenaBytes_)));
+        c.data.reset(new uint8_t[c.capacity]);
+        arenaBytes_ += c.capacity;
+        chunks_.push_back(std::move(c));
+    }
+    Chunk& c = chunks_.back();
+    uint32_t ref = (uint32_t)((chunks_.size() - 1) << CHUNK_BITS | c.used);
+    memcpy(c.data.get() + c.used, data, len);
+    c.used += len;
+    return ref;
+}
+
+void CoinsMap::release(uint32_t ref) {
+    if (ref != NO_COIN) garbageBytes_ += encodedCoinSize(coinData(ref));
+}
+
+void CoinsMap::maybeCompact() {
+    if (garbageBytes_ < CHUNK_SIZE || garbageBytes_ * 2 < arenaBytes_) return;
+    std::vector<Chunk> old;
+    old.swap(chunks_);
+    arenaBytes_ = 0;
+    garbageBytes_ = 0;
+    for (auto& s : slots_) {
+        if (!s.used || s.ref == NO_COIN) continue;
+        const uint8_t* p = old[s.ref >> CHUNK_BITS].data.get() + (s.ref & (CHUNK_SIZE - 1));
+        s.ref = allocate(p, encodedCoinSize(p));
+    }
+}
+
+size_t CoinsMap::put(const OutPoint& out, uint64_t hash64, const Coin& coin, uint8_t flags) {
+    uint32_t hash = (uint32_t)hash64;
+    std::vector<uint8_t> enc;
+    encodeCoin(coin, enc);
+    size_t i = findSlot(out, hash);
+    if (i == npos) {
+        // Keep the load factor at or below 3/4 so probe sequences stay short
+        if ((size_ + 1) * 4 > slots_.size() * 3) grow();
+        size_t mask = slots_.size() - 1;
+        i = hash & mask;
+        while (slots_[i].used) i = (i + 1) & mask;
+        slots_[i].out = out;
+        slots_[i].hash = hash;
+        slots_[i].used = true;
+        ++size_;
+    } else {
+        release(slots_[i].ref);
+        slots_[i].ref = NO_COIN;
+        maybeCompact();
+    }
+    slots_[i].ref = allocate(enc.data(), enc.size());
+    slots_[i].flags = flags;
+    return i;
+}
+
+void CoinsMap::markSpent(size_t slot, uint8_t flags) {
+    release(slots_[slot].ref);
+    slots_[slot].ref = NO_COIN;
+    slots_[slot].flags = flags;
+    maybeCompact();
+}
+
+bool CoinsMap::erase(const OutPoint& out, uint64_t hash64) {
+    size_t i = findSlot(out, (uint32_t)hash64);
+    if (i == npos) return false;
+    release(slots_[i].ref);
+    size_t mask = slots_.size() - 1;
+    // Backward-shift deletion: pull later members of the probe run into the hole
+    for (size_t j = (i + 1) & mask; slots_[j].used; j = (j + 1) & mask) {
+        size_t home = slots_[j].hash & mask;
+        bool movable = (j > i) ? (home <= i || home > j) : (home <= i && home > j);
+        if (!movable) continue;
+        slots_[i] = slots_[j];
+        i = j;
+    }
+    slots_[i] = Slot();
+    --size_;
+    maybeCompact();
+    return true;
+}
+
+void CoinsMap::clear() {
+    std::vector<Slot>().swap(slots_);
+    std::vector<Chunk>().swap(chunks_);
+    size_ = 0;
+    arenaBytes_ = 0;
+    garbageBytes_ = 0;
+}
+
+Coin CoinsMap::coin(size_t slot) const {
+    Coin c;
+    uint32_t ref = slots_[slot].ref;
+    if (ref == NO_COIN) return c;
+    const uint8_t* p = coinData(ref);
+    size_t used = 0;
+    decodeCoin(p, encodedCoinSize(p), c, used);
+    return c;
+}
+
+size_t CoinsMap::memoryUsage() const {
+    return slots_.capacity() * sizeof(Slot) + chunks_.capacity() * sizeof(Chunk) + arenaBytes_;
+}
+
+} // namespace shawncoin
@@ -0,0 +1,91 @@
+#ifndef SHAWNCOIN_CORE_COINSMAP_HPP
+#define SHAWNCOIN_CORE_COINSMAP_HPP
+
+#include "core/types.hpp"
+#include "core/coin.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace shawncoin {
+
+/** Open-addressing (linear probing) table of cached coins for one UTXO shard.
+ *  Slots are fixed-size (outpoint, arena reference, flags); coins are stored in the compact
+ *  encoding in a chunked byte arena that is compacted once most of it is garbage. Chunks
+ *  start small and double up to CHUNK_SIZE, so a table of a few entries stays small.
+ *  Callers pass a precomputed, salted outpoint hash; deletion shifts entries back so lookups
+ *  never need tombstones. Not thread-safe: the owning shard's lock guards it. */
+class CoinsMap {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    CoinsMap() = default;
+    CoinsMap(const CoinsMap&) = delete;
+    CoinsMap& operator=(const CoinsMap&) = delete;
+
+    /** Slot holding out, or npos. Slot numbers are invalidated by put and erase. */
+    size_t find(const OutPoint& out, uint64_t hash) const;
+    /** Store coin for out (inserting or overwriting) and return its slot. */
+    size_t put(const OutPoint& out, uint64_t hash, const Coin& coin, uint8_t flags);
+    /** Keep the slot as a spent marker; its coin data is released. */
+    void markSpent(size_t slot, uint8_t flags);
+    bool erase(const OutPoint& out, uint64_t hash);
+    void clear();
+
+    Coin coin(size_t slot) const;
+    uint8_t flags(size_t slot) const { return slots_[slot].flags; }
+    bool spent(size_t slot) const { return slots_[slot].ref == NO_COIN; }
+
+    size_t size() const { return size_; }
+    /** Bytes held by the slot array and the arena. */
+    size_t memoryUsage() const;
+
+    /** Visit every entry as fn(outpoint, flags, spent, coin), where coin is empty when spent;
+     *  stops early and returns false when fn returns false. */
+    template <typename Fn>
+    bool forEach(Fn&& fn) const {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i].used) continue;
+            bool isSpent = spent(i);
+            if (!fn(slots_[i].out, slots_[i].flags, isSpent, isSpent ? Coin() : coin(i))) return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint32_t NO_COIN = UINT32_MAX;
+    static constexpr size_t CHUNK_BITS = 16;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+    struct Slot {
+        OutPoint out;
+        uint32_t hash = 0;       // low bits of the outpoint hash, enough to rehash on growth
+        uint32_t ref = NO_COIN;  // arena reference: chunk << CHUNK_BITS | offset
+        uint8_t flags = 0;
+        bool used = false;
+    };
+    struct Chunk {
+        std::unique_ptr<uint8_t[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+
+    size_t findSlot(const OutPoint& out, uint32_t hash) const;
+    void grow();
+    const uint8_t* coinData(uint32_t ref) const;
+    uint32_t allocate(const uint8_t* data, size_t len);
+    void release(uint32_t ref);
+    /** Rewrite live coins into fresh chunks when at least half of the arena is garbage. */
+    void maybeCompact();
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+    std::vector<Chunk> chunks_;
+    size_t arenaBytes_ = 0;   // allocated chunk capacity
+    size_t garbageBytes_ = 0; // released encodings not yet compacted away
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_COINSMAP_HPP
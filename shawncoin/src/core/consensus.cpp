@@ -1,9 +1,12 @@
 #include "core/consensus.hpp"
 #include "core/block.hpp"
 #include "core/blockchain.hpp"
+#include "core/sigcache.hpp"
 #include "core/types.hpp"
 #include "util/util.hpp"
 #include "crypto/hash.h"
+#include "crypto/schnorr.h"
+#include "crypto/signatures.h"
 #include "mining/merkle.hpp"
 #include "mining/difficulty.hpp"
 #include <algorithm>
@@ -23,25 +26,7 @@ bool checkProofOfWork(const BlockHeader& header) {
     memcpy(buf.data() + 72, &header.difficulty_target, 4);
     memcpy(buf.data() + 76, &header.nonce, 4);
     shawncoin_sha256d(buf.data(), 80, h.data());
-    // Compact format: byte 0 = size (exponent), bytes 1-3 = mantissa. Target = mantissa * 2^(8*(size-3)).
-    uint32_t compact = header.difficulty_target;
-    int nSize = (int)(compact >> 24);
-    uint32_t nWord = compact & 0x007fffff;
-    uint256 target{};
-    if (nSize <= 3) {
-        nWord >>= 8 * (3 - nSize);
-        target[31] = (nWord >> 0) & 0xff;
-        target[30] = (nWord >> 8) & 0xff;
-        target[29] = (nWord >> 16) & 0xff;
-    } else {
-        int shift = 8 * (nSize - 3);
-        int bytePos = 32 - (shift / 8) - 1;
-        if (bytePos >= 0) {
-            target[bytePos] = (nWord >> 0) & 0xff;
-            if (bytePos > 0) target[bytePos - 1] = (nWord >> 8) & 0xff;
-            if (bytePos > 1) target[bytePos - 2] = (nWord >> 16) & 0xff;
-        }
-    }
+    uint256 target = compactToTarget(header.difficulty_target);
     // Hash (LE) must be <= target (LE)
     for (int i = 31; i >= 0; --i) {
         if (h[i] < target[i]) return true;
@@ -78,35 +63,122 @@ bool validateTransactionStructure(const Transaction& tx) {
     return true;
 }
 
-bool connectBlockUTXO(const Block& block, UTXOSet& utxo) {
-    for (size_t i = 1; i < block.transactions.size(); ++i) {
-        const auto& tx = block.transactions[i];
-        for (const auto& in : tx.inputs) {
-            OutPoint op{ in.prev_tx_hash, in.output_index };
-            if (!utxo.has(op)) return false;
-            utxo.spend(op);
-        }
+uint256 signatureHash(const Transaction& tx) {
+    Transaction stripped = tx;
+    for (auto& in : stripped.inputs) {
+        in.signature.clear();
+        in.pubkey.clear();
+    }
+    std::vector<uint8_t> raw;
+    serializeTransaction(stripped, raw);
+    uint256 hash;
+    shawncoin_sha256d(raw.data(), raw.size(), hash.data());
+    return hash;
+}
+
+namespace {
+
+/** Sizes are right and the pubkey is the one a P2PKH scriptPubKey pays to. */
+bool checkInputKey(const TxInput& in, const Script& scriptPubKey) {
+    if (!isP2PKH(scriptPubKey) || in.pubkey.size() != 33 || in.signature.size() != 64) return false;
+    unsigned char keyHash[20];
+    shawncoin_hash160(in.pubkey.data(), in.pubkey.size(), keyHash);
+    return memcmp(keyHash, scriptPubKey.data() + 3, 20) == 0;
+}
+
+template <typename Verify>
+bool verifyCached(const TxInput& in, const uint256& hash, SignatureCache* cache, bool store, Verify verify) {
+    uint256 key;
+    if (cache) {
+        key = cache->entryKey(hash, in.pubkey, in.signature);
+        if (cache->contains(key)) return true;
+    }
+    if (!verify()) return false;
+    if (cache && store) cache->insert(key);
+    return true;
+}
+
+} // namespace
+
+bool verifyInputSignature(const TxInput& in, const Script& scriptPubKey, const uint256& hash,
+                          SignatureCache* cache, bool store) {
+    if (!checkInputKey(in, scriptPubKey)) return false;
+    return verifyCached(in, hash, cache, store, [&]() {
+        return shawncoin_verify(in.pubkey.data(), hash.data(), in.signature.data(), in.signature.size()) == 1;
+    });
+}
+
+bool verifyInputSchnorr(const TxInput& in, const Script& scriptPubKey, const uint256& hash,
+                        SignatureCache* cache, bool store) {
+    if (!checkInputKey(in, scriptPubKey)) return false;
+    return verifyCached(in, hash, cache, store, [&]() {
+        return shawncoin_schnorr_verify(in.pubkey.data(), hash.data(), in.signature.data()) == 1;
+    });
+}
+
+bool verifySchnorrBatch(const SignatureCheck* checks, size_t count, SignatureCache* cache) {
+    std::vector<const unsigned char*> pubkeys, hashes, sigs;
+    pubkeys.reserve(count);
+    hashes.reserve(count);
+    sigs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const TxInput& in = *checks[i].input;
+        if (!checkInputKey(in, *checks[i].scriptPubKey)) return false;
+        if (cache && cache->contains(cache->entryKey(*checks[i].hash, in.pubkey, in.signature))) continue;
+        pubkeys.push_back(in.pubkey.data());
+        hashes.push_back(checks[i].hash->data());
+        sigs.push_back(in.signature.data());
     }
+    return shawncoin_schnorr_verify_batch(pubkeys.data(), hashes.data(), sigs.data(), pubkeys.size()) == 1;
+}
+
+bool connectBlockUTXO(const Block& block, UTXOSet& utxo, BlockUndo* undo, AddressIndex* index) {
+    BlockUndo local;
+    BlockUndo& spent = undo ? *undo : local;
+    spent.spent.clear();
+    // Stage the whole block in an overlay so a failure leaves the set untouched. Transactions
+    // apply in order, so an output may be spent by a later transaction of the same block.
+    UTXOBatch batch(utxo);
     for (size_t i = 0; i < block.transactions.size(); ++i) {
         const auto& tx = block.transactions[i];
+        if (i > 0) {
+            for (const auto& in : tx.inputs) {
+                OutPoint op{ in.prev_tx_hash, in.output_index };
+                Coin coin;
+                if (!batch.spend(op, &coin)) { // missing or double-spent input
+                    spent.spent.clear();
+                    return false;
+                }
+                spent.spent.push_back({ op, coin.amount, std::move(coin.script_pubkey) });
+            }
+        }
         uint256 txid = tx.getTxid();
         for (size_t j = 0; j < tx.outputs.size(); ++j) {
-            OutPoint op{ txid, (uint32_t)j };
-            utxo.put(op, tx.outputs[j].amount, tx.outputs[j].script_pubkey);
+            // Coinbase txids are not unique by consensus, so their outputs may overwrite
+            batch.put({ txid, (uint32_t)j }, tx.outputs[j].amount, tx.outputs[j].script_pubkey, i == 0);
+        }
+    }
+    if (!batch.commit()) return false;
+    if (index) {
+        for (const auto& tx : block.transactions) {
+            uint256 txid = tx.getTxid();
+            for (size_t j = 0; j < tx.outputs.size(); ++j)
+                index->add({ txid, (uint32_t)j }, tx.outputs[j].amount, tx.outputs[j].script_pubkey);
         }
+        for (const auto& c : spent.spent) index->remove(c.outpoint, c.script_pubkey);
     }
     return true;
 }
 
 bool checkDifficulty(const Blockchain& chain, const BlockHeader& header) {
+    // Difficulty is checked against the branch the header extends, which may be a side chain
+    auto prevOpt = chain.getBlockIndex(header.previous_hash);
+    if (!prevOpt) return false;
+    const BlockIndex& prev = *prevOpt;
     // If chain is too short, accept header as-is
-    uint64_t height = chain.getHeight();
+    uint64_t height = prev.height;
     if (height == 0) return true;
-    // previous block at 'height'
-    auto prevOpt = chain.getBlockByHeight(height);
-    if (!prevOpt) return true;
-    const Block& prev = *prevOpt;
-    uint32_t prevTarget = prev.header.difficulty_target;
+    uint32_t prevTarget = prev.bits;
     uint64_t nextHeight = height + 1;
     // If this is not a retarget point, difficulty must equal previous target
     if ((nextHeight % DIFFICULTY_INTERVAL) != 0) {
@@ -114,33 +186,47 @@ bool checkDifficulty(const Blockchain& chain, const BlockHeader& header) {
     }
     // Retarget: need first block timestamp from height - (DIFFICULTY_INTERVAL-1)
     if (height < DIFFICULTY_INTERVAL - 1) return header.difficulty_target == prevTarget;
-    auto firstOpt = chain.getBlockByHeight(height - (DIFFICULTY_INTERVAL - 1));
+    auto firstOpt = chain.getAncestor(prev.hash, height - (DIFFICULTY_INTERVAL - 1));
     if (!firstOpt) return header.difficulty_target == prevTarget;
-    uint64_t lastTime = prev.header.timestamp;
-    uint64_t firstTime = (*firstOpt).header.timestamp;
+    uint64_t lastTime = prev.timestamp;
+    uint64_t firstTime = firstOpt->timestamp;
     uint32_t expected = getAdaptiveNextDifficulty(prevTarget, lastTime, firstTime, DIFFICULTY_INTERVAL, nextHeight);
     return header.difficulty_target == expected;
 }
 
-void disconnectBlockUTXO(const Block& block, UTXOSet& utxo) {
-    for (size_t i = 0; i < block.transactions.size(); ++i) {
+bool disconnectBlockUTXO(const Block& block, UTXOSet& utxo, const BlockUndo& undo, AddressIndex* index) {
+    size_t expected = 0;
+    for (size_t i = 1; i < block.transactions.size(); ++i)
+        expected += block.transactions[i].inputs.size();
+    if (undo.spent.size() != expected) return false;
+    // Undo transactions last to first, so coins created and spent inside the block come back
+    // before their creating transaction removes them again
+    bool clean = true;
+    UTXOBatch batch(utxo);
+    size_t k = undo.spent.size();
+    for (size_t i = block.transactions.size(); i-- > 0;) {
         const auto& tx = block.transactions[i];
         uint256 txid = tx.getTxid();
         for (size_t j = 0; j < tx.outputs.size(); ++j) {
-            OutPoint op{ txid, (uint32_t)j };
-            utxo.spend(op);
+            if (!batch.spend({ txid, (uint32_t)j })) clean = false;
+        }
+        if (i == 0) break;
+        for (size_t n = tx.inputs.size(); n-- > 0;) {
+            const SpentCoin& c = undo.spent[--k];
+            batch.put(c.outpoint, c.amount, c.script_pubkey);
         }
     }
-    for (size_t i = 1; i < block.transactions.size(); ++i) {
-        const auto& tx = block.transactions[i];
-        for (const auto& in : tx.inputs) {
-            // We need to restore the output - but we don't have script_pubkey/amount here.
-            // In a full implementation we'd read from block undo or from previous block state.
-            // For simplicity we skip restore (used only for reorg; full node would store undo).
-            (void)in;
+    if (!batch.commit()) clean = false;
+    if (index) {
+        // Restore first: coins both created and spent in this block are then removed below
+        for (const auto& c : undo.spent) index->add(c.outpoint, c.amount, c.script_pubkey);
+        for (const auto& tx : block.transactions) {
+            uint256 txid = tx.getTxid();
+            for (size_t j = 0; j < tx.outputs.size(); ++j)
+                index->remove({ txid, (uint32_t)j }, tx.outputs[j].script_pubkey);
         }
     }
+    return clean;
 }
 
-
 } // namespace shawncoin
@@ -5,15 +5,19 @@
 #include "core/block.hpp"
 #include "core/transaction.hpp"
 #include "core/utxo.hpp"
+#include "core/addressindex.hpp"
+#include "core/undo.hpp"
 #include <cstdint>
 #include <optional>
 
 namespace shawncoin {
 
+class SignatureCache;
+
 /** Check block header proof-of-work (hash below target). */
 bool checkProofOfWork(const BlockHeader& header);
 
-/** Check that the header's difficulty target matches expected chain difficulty. */
+/** Check that the header's difficulty target matches the expected difficulty on the branch it extends. */
 bool checkDifficulty(const class Blockchain& chain, const BlockHeader& header);
 
 /** Validate block (header, merkle, tx count, coinbase, sizes). Does not validate tx inputs against UTXO. */
@@ -22,11 +26,40 @@ bool validateBlockStructure(const Block& block);
 /** Validate transaction (basic: inputs/outputs, amounts, scripts). Double-spend checked separately. */
 bool validateTransactionStructure(const Transaction& tx);
 
-/** Apply block to UTXO set (spend inputs, add outputs). Returns false if any input missing. */
-bool connectBlockUTXO(const Block& block, UTXOSet& utxo);
+/** Hash every input of tx signs: SHA-256d of tx with all signatures and pubkeys cleared. */
+uint256 signatureHash(const Transaction& tx);
+
+/** Check an input spending a P2PKH output: its 33-byte pubkey must hash to the script's
+ *  hash160 and its 64-byte signature must verify against hash. With a cache, a signature
+ *  found there skips the ECDSA check, and with store a newly verified one is added. */
+bool verifyInputSignature(const TxInput& in, const Script& scriptPubKey, const uint256& hash,
+                          SignatureCache* cache = nullptr, bool store = false);
+
+/** As verifyInputSignature, for inputs of TX_VERSION_SCHNORR transactions: the 64-byte
+ *  signature is a BIP340 Schnorr signature by the x coordinate of the pubkey. Cache entries
+ *  cannot be confused with ECDSA ones, as the signature hash commits to the version. */
+bool verifyInputSchnorr(const TxInput& in, const Script& scriptPubKey, const uint256& hash,
+                        SignatureCache* cache = nullptr, bool store = false);
+
+/** An input signature to check against the script of the coin it spends. */
+struct SignatureCheck {
+    const TxInput* input;
+    const Script* scriptPubKey;
+    const uint256* hash;
+};
+
+/** Check count Schnorr inputs with one batch verification, skipping those in cache (which is
+ *  not added to). False if any is invalid, without saying which. */
+bool verifySchnorrBatch(const SignatureCheck* checks, size_t count, SignatureCache* cache = nullptr);
+
+/** Apply block to UTXO set (spend inputs, add outputs) transaction by transaction, so outputs
+ *  may be spent later in the same block. Returns false if any input missing, leaving the set
+ *  unchanged. If undo is given, the spent coins are recorded in it; if index
+ *  is given, it is updated to match. */
+bool connectBlockUTXO(const Block& block, UTXOSet& utxo, BlockUndo* undo = nullptr, AddressIndex* index = nullptr);
 
-/** Disconnect block from UTXO set (remove outputs, restore inputs). */
-void disconnectBlockUTXO(const Block& block, UTXOSet& utxo);
+/** Disconnect block from UTXO set (remove outputs, restore inputs from undo). */
+bool disconnectBlockUTXO(const Block& block, UTXOSet& utxo, const BlockUndo& undo, AddressIndex* index = nullptr);
 
 } // namespace shawncoin
 
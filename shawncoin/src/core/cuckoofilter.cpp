@@ -0,0 +1,95 @@
+#include "core/cuckoofilter.hpp"
+
+namespace shawncoin {
+
+CuckooFilter::CuckooFilter(size_t capacity) {
+    // Insertions start failing at around 95% load; aim to stay below that
+    size_t buckets = 1;
+    while (buckets * BUCKET_SIZE * 9 < capacity * 10) buckets <<= 1;
+    table_.assign(buckets * BUCKET_SIZE, 0);
+    mask_ = buckets - 1;
+}
+
+uint16_t CuckooFilter::fingerprint(uint64_t hash) {
+    uint16_t fp = (uint16_t)hash;
+    return fp ? fp : 1;
+}
+
+bool CuckooFilter::bucketHas(size_t bucket, uint16_t fp) const {
+    const uint16_t* b = &table_[bucket * BUCKET_SIZE];
+    return b[0] == fp || b[1] == fp || b[2] == fp || b[3] == fp;
+}
+
+bool CuckooFilter::bucketAdd(size_t bucket, uint16_t fp) {
+    uint16_t* b = &table_[bucket * BUCKET_SIZE];
+    for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+        if (b[i] == 0) {
+            b[i] = fp;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::bucketRemove(size_t bucket, uint16_t fp) {
+    uint16_t* b = &table_[bucket * BUCKET_SIZE];
+    for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+        if (b[i] == fp) {
+            b[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::insert(uint64_t hash) {
+    if (victim_) return false;
+    uint16_t fp = fingerprint(hash);
+    size_t i1 = index(hash);
+    size_t i2 = altIndex(i1, fp);
+    ++count_;
+    if (bucketAdd(i1, fp) || bucketAdd(i2, fp)) return true;
+    // Both buckets full: evict a random resident to its other bucket, and so on
+    size_t bucket = (kickState_ & 1) ? i1 : i2;
+    for (int kick = 0; kick < MAX_KICKS; ++kick) {
+        kickState_ ^= kickState_ << 13;
+        kickState_ ^= kickState_ >> 7;
+        kickState_ ^= kickState_ << 17;
+        uint16_t& slot = table_[bucket * BUCKET_SIZE + (kickState_ & (BUCKET_SIZE - 1))];
+        std::swap(fp, slot);
+        bucket = altIndex(bucket, fp);
+        if (bucketAdd(bucket, fp)) return true;
+    }
+    victim_ = fp;
+    victimBucket_ = bucket;
+    return false;
+}
+
+bool CuckooFilter::contains(uint64_t hash) const {
+    uint16_t fp = fingerprint(hash);
+    size_t i1 = index(hash);
+    size_t i2 = altIndex(i1, fp);
+    if (bucketHas(i1, fp) || bucketHas(i2, fp)) return true;
+    return victim_ == fp && (victimBucket_ == i1 || victimBucket_ == i2);
+}
+
+bool CuckooFilter::erase(uint64_t hash) {
+    uint16_t fp = fingerprint(hash);
+    size_t i1 = index(hash);
+    size_t i2 = altIndex(i1, fp);
+    if (bucketRemove(i1, fp) || bucketRemove(i2, fp)) {
+        --count_;
+        // A slot opened up; the stranded victim can move back in
+        if (victim_ && (bucketAdd(victimBucket_, victim_) || bucketAdd(altIndex(victimBucket_, victim_), victim_)))
+            victim_ = 0;
+        return true;
+    }
+    if (victim_ == fp && (victimBucket_ == i1 || victimBucket_ == i2)) {
+        victim_ = 0;
+        --count_;
+        return true;
+    }
+    return false;
+}
+
+} // namespace shawncoin
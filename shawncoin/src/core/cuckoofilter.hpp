@@ -0,0 +1,49 @@
+#ifndef SHAWNCOIN_CORE_CUCKOOFILTER_HPP
+#define SHAWNCOIN_CORE_CUCKOOFILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shawncoin {
+
+/** Cuckoo filter over 64-bit item hashes: 16-bit fingerprints in buckets of four, each item
+ *  living in one of two buckets. Membership never has false negatives and false positives
+ *  are about 8 in 65536; unlike a Bloom filter, items can be erased. A lookup reads two
+ *  8-byte buckets. When an insert cannot find room it returns false and the filter is full:
+ *  it still answers correctly but further inserts fail, so it should be rebuilt larger.
+ *  Callers must only erase items they inserted. Not thread-safe. */
+class CuckooFilter {
+public:
+    /** Room for about capacity items (rounded up to a power-of-two bucket count). */
+    explicit CuckooFilter(size_t capacity = 0);
+
+    bool insert(uint64_t hash);
+    bool contains(uint64_t hash) const;
+    bool erase(uint64_t hash);
+
+    size_t size() const { return count_; }
+    size_t memoryUsage() const { return table_.capacity() * sizeof(uint16_t); }
+
+private:
+    static constexpr size_t BUCKET_SIZE = 4;
+    static constexpr int MAX_KICKS = 500;
+
+    static uint16_t fingerprint(uint64_t hash);
+    size_t index(uint64_t hash) const { return (size_t)(hash >> 16) & mask_; }
+    size_t altIndex(size_t bucket, uint16_t fp) const { return (bucket ^ (fp * 0x5bd1e995u)) & mask_; }
+    bool bucketHas(size_t bucket, uint16_t fp) const;
+    bool bucketAdd(size_t bucket, uint16_t fp);
+    bool bucketRemove(size_t bucket, uint16_t fp);
+
+    std::vector<uint16_t> table_; // 0 marks an empty slot
+    size_t mask_ = 0;
+    size_t count_ = 0;
+    uint16_t victim_ = 0;      // fingerprint evicted by a failed insert, kept so it is not lost
+    size_t victimBucket_ = 0;
+    uint64_t kickState_ = 0x9e3779b97f4a7c15ULL;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_CUCKOOFILTER_HPP
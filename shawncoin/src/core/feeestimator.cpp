@@ -0,0 +1,100 @@
+#include "core/feeestimator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace shawncoin {
+
+namespace {
+
+const double MIN_BUCKET_RATE = 1000;
+const double MAX_BUCKET_RATE = 1e7;
+const double BUCKET_SPACING = 1.1;
+
+} // namespace
+
+FeeEstimator::FeeEstimator() {
+    bounds_.push_back(0); // everything below MIN_BUCKET_RATE
+    for (double b = MIN_BUCKET_RATE; b <= MAX_BUCKET_RATE; b *= BUCKET_SPACING) bounds_.push_back(b);
+    confirmed_.assign(bounds_.size(), 0);
+    rateSum_.assign(bounds_.size(), 0);
+    inTime_.assign(MAX_TARGET, std::vector<double>(bounds_.size(), 0));
+}
+
+size_t FeeEstimator::bucketFor(double rate) const {
+    return (size_t)(std::upper_bound(bounds_.begin(), bounds_.end(), rate) - bounds_.begin()) - 1;
+}
+
+void FeeEstimator::setHeight(uint64_t height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    height_ = height;
+}
+
+void FeeEstimator::trackTransaction(const uint256& txid, uint64_t fee, size_t size) {
+    if (size == 0) return;
+    double rate = (double)fee * 1000 / size;
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracked_[txid] = Tracked{ height_, rate, bucketFor(rate) };
+}
+
+void FeeEstimator::untrackTransaction(const uint256& txid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracked_.erase(txid);
+}
+
+void FeeEstimator::processBlock(uint64_t height, const std::vector<uint256>& confirmed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Blocks reconnected after a reorg are not new information about waiting times
+    bool newBlock = height > height_;
+    height_ = height;
+    if (newBlock) {
+        for (size_t b = 0; b < bounds_.size(); ++b) {
+            confirmed_[b] *= DECAY;
+            rateSum_[b] *= DECAY;
+            for (auto& row : inTime_) row[b] *= DECAY;
+        }
+    }
+    for (const auto& txid : confirmed) {
+        auto it = tracked_.find(txid);
+        if (it == tracked_.end()) continue;
+        const Tracked& t = it->second;
+        if (newBlock && height > t.height) {
+            uint64_t waited = height - t.height;
+            confirmed_[t.bucket] += 1;
+            rateSum_[t.bucket] += t.rate;
+            for (uint64_t target = waited; target <= MAX_TARGET; ++target) inTime_[target - 1][t.bucket] += 1;
+        }
+        tracked_.erase(it);
+    }
+}
+
+std::optional<uint64_t> FeeEstimator::estimateFee(unsigned target) const {
+    target = std::min(std::max(target, 1u), MAX_TARGET);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Still waiting after target blocks: these count against their bucket
+    std::vector<double> late(bounds_.size(), 0);
+    for (const auto& kv : tracked_) {
+        // Tracked above a tip a reorg has since lowered: not waiting yet
+        if (height_ > kv.second.height && height_ - kv.second.height >= target) late[kv.second.bucket] += 1;
+    }
+    const std::vector<double>& inTime = inTime_[target - 1];
+    std::optional<uint64_t> best;
+    double ok = 0, total = 0, failed = 0, rates = 0;
+    for (size_t b = bounds_.size(); b-- > 0;) {
+        ok += inTime[b];
+        total += confirmed_[b];
+        failed += late[b];
+        rates += rateSum_[b];
+        if (total + failed < MIN_SAMPLES) continue;
+        if (ok / (total + failed) < SUCCESS_THRESHOLD) break;
+        best = (uint64_t)std::ceil(rates / total);
+        ok = total = failed = rates = 0;
+    }
+    return best;
+}
+
+size_t FeeEstimator::tracked() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tracked_.size();
+}
+
+} // namespace shawncoin
@@ -0,0 +1,69 @@
+#ifndef SHAWNCOIN_CORE_FEEESTIMATOR_HPP
+#define SHAWNCOIN_CORE_FEEESTIMATOR_HPP
+
+#include "core/types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace shawncoin {
+
+/** Estimates the fee rate (satoshis per 1000 bytes) that gets a transaction confirmed within a
+ *  given number of blocks, from how long pooled transactions actually took. Transactions are
+ *  bucketed by fee rate on entering the mempool; when a block confirms one, every target at
+ *  least as long as its wait counts a success for its bucket. Counts decay each block so the
+ *  estimate follows current conditions. An estimate walks buckets from the highest rate down,
+ *  grouping them until there are enough samples, and stops at the first group where fewer than
+ *  SUCCESS_THRESHOLD of transactions confirmed in time (those still waiting past the target
+ *  count as failures); the answer is the average rate of the last group that passed. */
+class FeeEstimator {
+public:
+    static constexpr unsigned MAX_TARGET = 48;
+    static constexpr unsigned DEFAULT_TARGET = 6;
+    /** Rate to pay when there is no estimate yet. */
+    static constexpr uint64_t FALLBACK_FEE_RATE = 1000;
+    static constexpr double DECAY = 0.998; // per block: about a 350-block half-life
+    static constexpr double SUCCESS_THRESHOLD = 0.85;
+    static constexpr double MIN_SAMPLES = 4;
+
+    FeeEstimator();
+
+    /** Chain height at startup, so transactions tracked before the next block are not counted
+     *  as having waited since genesis. */
+    void setHeight(uint64_t height);
+    /** A transaction entered the mempool at the current height. */
+    void trackTransaction(const uint256& txid, uint64_t fee, size_t size);
+    /** A transaction left the mempool without being confirmed. */
+    void untrackTransaction(const uint256& txid);
+    /** A block at height confirmed the given pooled transactions. */
+    void processBlock(uint64_t height, const std::vector<uint256>& confirmed);
+
+    /** Rate for confirmation within target blocks (clamped to 1..MAX_TARGET), if known. */
+    std::optional<uint64_t> estimateFee(unsigned target) const;
+    /** Pooled transactions being followed. */
+    size_t tracked() const;
+
+private:
+    struct Tracked {
+        uint64_t height;
+        double rate;
+        size_t bucket;
+    };
+
+    size_t bucketFor(double rate) const;
+
+    mutable std::mutex mutex_;
+    std::vector<double> bounds_;                // lower fee rate of each bucket, ascending
+    std::vector<double> confirmed_;             // decayed count of confirmations per bucket
+    std::vector<double> rateSum_;               // and the sum of their fee rates
+    std::vector<std::vector<double>> inTime_;   // [target - 1][bucket]: confirmed within target
+    std::map<uint256, Tracked> tracked_;
+    uint64_t height_ = 0;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_FEEESTIMATOR_HPP
@@ -1,58 +1,491 @@
 #include "core/mempool.hpp"
 #include "core/consensus.hpp"
+#include "core/feeestimator.hpp"
+#include "core/utxo.hpp"
 #include "util/util.hpp"
 #include "util/realtime.hpp"
+#include "util/logger.hpp"
 #include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <cstring>
 #include <vector>
 
 namespace shawncoin {
 
-bool Mempool::add(const Transaction& tx, uint64_t fee) {
+namespace {
+
+/** a/b > c/d for nonzero b and d, exactly (products could overflow 64 bits). Compares
+ *  integer parts, then the reciprocals of the remainders, as in a continued fraction. */
+bool rateGreater(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    while (true) {
+        uint64_t q1 = a / b, q2 = c / d;
+        if (q1 != q2) return q1 > q2;
+        a %= b;
+        c %= d;
+        if (a == 0 || c == 0) return c == 0 && a != 0;
+        // a/b > c/d  <=>  d/c > b/a
+        uint64_t na = d, nb = c, nc = b, nd = a;
+        a = na;
+        b = nb;
+        c = nc;
+        d = nd;
+    }
+}
+
+} // namespace
+
+bool Mempool::RateKey::operator<(const RateKey& o) const {
+    if (rateGreater(fee, size, o.fee, o.size)) return true;
+    if (rateGreater(o.fee, o.size, fee, size)) return false;
+    return txid < o.txid;
+}
+
+size_t Mempool::OutPointHasher::operator()(const OutPoint& out) const {
+    // txids are already uniform
+    uint64_t v = 0;
+    memcpy(&v, out.hash.data(), sizeof(v));
+    return (size_t)(v ^ (out.index * 0x9e3779b97f4a7c15ULL));
+}
+
+Mempool::RateKey Mempool::evictKey(const MempoolEntry& e) {
+    if (rateGreater(e.fee, e.size, e.descendantFee, e.descendantSize)) return { e.fee, e.size, e.txid };
+    return { e.descendantFee, e.descendantSize, e.txid };
+}
+
+std::vector<uint256> Mempool::ancestorsOf(const std::set<uint256>& parents) const {
+    std::vector<uint256> out(parents.begin(), parents.end());
+    std::set<uint256> seen(parents.begin(), parents.end());
+    for (size_t i = 0; i < out.size(); ++i) {
+        for (const auto& p : entries_.at(out[i]).parents) {
+            if (seen.insert(p).second) out.push_back(p);
+        }
+    }
+    return out;
+}
+
+bool Mempool::add(const Transaction& tx, uint64_t fee, int64_t time) {
     if (!validateTransactionStructure(tx)) return false;
+    std::vector<uint8_t> raw;
+    serializeTransaction(tx, raw);
+    if (raw.size() > MAX_TX_SIZE) return false;
     uint256 txid = tx.getTxid();
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (txs_.size() >= MAX_MEMPOOL_SIZE && txs_.find(txid) == txs_.end())
-        return false; // evict lowest fee would go here
-    txs_[txid] = tx;
-    (void)fee;
-    // emit realtime event for new transaction (append to realtime feed)
+    int64_t now = (int64_t)std::time(nullptr);
+    std::unique_lock<std::mutex> lock(mutex_);
+    expireLocked(now - EXPIRY_SECONDS);
+    if (entries_.count(txid)) return true;
+    if ((double)fee * 1000 < (double)minFeeRateLocked(now) * raw.size()) return false;
+    if (coins_) {
+        for (const auto& in : tx.inputs) {
+            auto parent = entries_.find(in.prev_tx_hash);
+            if (parent != entries_.end() && in.output_index < parent->second.tx.outputs.size()) continue;
+            if (!coins_->has(OutPoint{ in.prev_tx_hash, in.output_index })) return false;
+        }
+    }
+    std::set<uint256> conflicts;
+    for (const auto& in : tx.inputs) {
+        auto it = spentBy_.find(OutPoint{ in.prev_tx_hash, in.output_index });
+        if (it == spentBy_.end()) continue;
+        if (!replaceByFee_) return false;
+        conflicts.insert(it->second);
+    }
+    std::set<uint256> replaced;
+    if (!conflicts.empty()) {
+        uint64_t replacedFees = 0;
+        for (const auto& c : conflicts) {
+            const MempoolEntry& ce = entries_.at(c);
+            if (!rateGreater(fee, raw.size(), ce.fee, ce.size)) return false;
+            for (const auto& id : withDescendants(c)) {
+                if (replaced.insert(id).second) replacedFees += entries_.at(id).fee;
+            }
+        }
+        if (replaced.size() > MAX_REPLACEMENTS) return false;
+        if (fee < replacedFees || fee - replacedFees < INCREMENTAL_RELAY_FEE * raw.size() / 1000) return false;
+    }
+
+    MempoolEntry entry;
+    entry.tx = tx;
+    entry.txid = txid;
+    entry.fee = fee;
+    entry.size = raw.size();
+    entry.time = time ? std::min(time, now) : now;
+    entry.ancestorFee = entry.descendantFee = fee;
+    entry.ancestorSize = entry.descendantSize = entry.size;
+    entry.ancestorCount = entry.descendantCount = 1;
+    for (const auto& in : tx.inputs) {
+        if (!entries_.count(in.prev_tx_hash)) continue;
+        if (replaced.count(in.prev_tx_hash)) return false; // spends what it would evict
+        entry.parents.insert(in.prev_tx_hash);
+    }
+    std::vector<uint256> ancestors = ancestorsOf(entry.parents);
+    for (const auto& id : ancestors) {
+        const MempoolEntry& a = entries_.at(id);
+        entry.ancestorFee += a.fee;
+        entry.ancestorSize += a.size;
+        ++entry.ancestorCount;
+        if (a.descendantCount + 1 > MAX_PACKAGE_COUNT || a.descendantSize + entry.size > MAX_PACKAGE_BYTES) return false;
+    }
+    // Limits are checked against the pool as it is, replaced transactions included, so a
+    // rejection never leaves the conflicts already evicted
+    if (entry.ancestorCount > MAX_PACKAGE_COUNT || entry.ancestorSize > MAX_PACKAGE_BYTES) return false;
+    for (const auto& c : conflicts) {
+        if (!entries_.count(c)) continue;
+        size_t evicted = removeWithDescendants(c);
+        SHAWNCOIN_LOG(Debug, "mempool", "%s replaces %s (%zu evicted)", uint256ToHex(txid).c_str(),
+                      uint256ToHex(c).c_str(), evicted);
+    }
+    for (const auto& id : ancestors) {
+        MempoolEntry& a = entries_.at(id);
+        byEvict_.erase(evictKey(a));
+        a.descendantFee += fee;
+        a.descendantSize += entry.size;
+        ++a.descendantCount;
+        byEvict_.insert(evictKey(a));
+    }
+
+    for (const auto& p : entry.parents) entries_.at(p).children.insert(txid);
+    for (const auto& in : tx.inputs) spentBy_[OutPoint{ in.prev_tx_hash, in.output_index }] = txid;
+    byRate_.insert(rateKey(entry));
+    byEvict_.insert(evictKey(entry));
+    byTime_.insert({ entry.time, txid });
+    totalBytes_ += entry.size;
+    totalFees_ += fee;
+    entries_.emplace(txid, std::move(entry));
+    trimLocked(now);
+    if (!entries_.count(txid)) return false; // it was the lowest-paying package
+    // Reloaded transactions (given an old entry time) say nothing about current waits
+    if (feeEstimator_ && !time) feeEstimator_->trackTransaction(txid, fee, raw.size());
+    lock.unlock();
+    // emit realtime event for new transaction (queued for the realtime feed)
     try {
         std::string id = shawncoin::uint256ToHex(txid);
         uint64_t value = tx.getTotalOutput();
         std::string evt = "{\"type\":\"tx\",\"txid\":\"" + id + "\",\"value\":" + std::to_string(value) + "}";
-        shawncoin::appendRealtimeEvent(evt);
+        shawncoin::appendRealtimeEvent(std::move(evt));
     } catch (...) { }
     return true;
 }
 
+std::vector<uint256> Mempool::withDescendants(const uint256& txid) const {
+    std::vector<uint256> out{ txid };
+    std::set<uint256> seen{ txid };
+    for (size_t i = 0; i < out.size(); ++i) {
+        for (const auto& c : entries_.at(out[i]).children) {
+            if (seen.insert(c).second) out.push_back(c);
+        }
+    }
+    return out;
+}
+
+size_t Mempool::removeWithDescendants(const uint256& txid) {
+    std::vector<uint256> doomed = withDescendants(txid);
+    std::set<uint256> removing(doomed.begin(), doomed.end());
+    // Ancestors that stay lose these descendants from their totals
+    for (const auto& id : doomed) {
+        const MempoolEntry& e = entries_.at(id);
+        for (const auto& aid : ancestorsOf(e.parents)) {
+            if (removing.count(aid)) continue;
+            MempoolEntry& a = entries_.at(aid);
+            byEvict_.erase(evictKey(a));
+            a.descendantFee -= e.fee;
+            a.descendantSize -= e.size;
+            --a.descendantCount;
+            byEvict_.insert(evictKey(a));
+        }
+    }
+    for (const auto& id : doomed) removeLocked(id);
+    return doomed.size();
+}
+
+void Mempool::removeConfirmed(const uint256& txid) {
+    const MempoolEntry& e = entries_.at(txid);
+    std::vector<uint256> family = withDescendants(txid);
+    for (size_t i = 1; i < family.size(); ++i) {
+        MempoolEntry& d = entries_.at(family[i]);
+        byRate_.erase(rateKey(d));
+        d.ancestorFee -= e.fee;
+        d.ancestorSize -= e.size;
+        --d.ancestorCount;
+        byRate_.insert(rateKey(d));
+    }
+    // Blocks confirm parents first, so ancestors are normally gone already
+    for (const auto& aid : ancestorsOf(e.parents)) {
+        MempoolEntry& a = entries_.at(aid);
+        byEvict_.erase(evictKey(a));
+        a.descendantFee -= e.fee;
+        a.descendantSize -= e.size;
+        --a.descendantCount;
+        byEvict_.insert(evictKey(a));
+    }
+    removeLocked(txid);
+}
+
+size_t Mempool::removeForBlock(const Block& block, uint64_t height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (feeEstimator_) {
+        std::vector<uint256> confirmed;
+        for (size_t i = 1; i < block.transactions.size(); ++i) {
+            uint256 txid = block.transactions[i].getTxid();
+            if (entries_.count(txid)) confirmed.push_back(txid);
+        }
+        feeEstimator_->processBlock(height, confirmed);
+    }
+    size_t removed = 0;
+    for (size_t i = 1; i < block.transactions.size(); ++i) {
+        const Transaction& tx = block.transactions[i];
+        uint256 txid = tx.getTxid();
+        for (const auto& in : tx.inputs) {
+            auto it = spentBy_.find(OutPoint{ in.prev_tx_hash, in.output_index });
+            if (it == spentBy_.end() || it->second == txid) continue;
+            removed += removeWithDescendants(it->second); // double-spent by the block
+        }
+        if (entries_.count(txid)) {
+            removeConfirmed(txid);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+void Mempool::removeLocked(const uint256& txid) {
+    auto it = entries_.find(txid);
+    if (it == entries_.end()) return;
+    const MempoolEntry& e = it->second;
+    for (const auto& p : e.parents) {
+        auto parent = entries_.find(p);
+        if (parent != entries_.end()) parent->second.children.erase(txid);
+    }
+    for (const auto& c : e.children) {
+        auto child = entries_.find(c);
+        if (child != entries_.end()) child->second.parents.erase(txid);
+    }
+    for (const auto& in : e.tx.inputs) spentBy_.erase(OutPoint{ in.prev_tx_hash, in.output_index });
+    if (feeEstimator_) feeEstimator_->untrackTransaction(txid);
+    byRate_.erase(rateKey(e));
+    byEvict_.erase(evictKey(e));
+    byTime_.erase({ e.time, txid });
+    totalBytes_ -= e.size;
+    totalFees_ -= e.fee;
+    entries_.erase(it);
+}
+
 bool Mempool::remove(const uint256& txid) {
     std::lock_guard<std::mutex> lock(mutex_);
-    return txs_.erase(txid) > 0;
+    if (!entries_.count(txid)) return false;
+    removeWithDescendants(txid);
+    return true;
+}
+
+size_t Mempool::expireLocked(int64_t cutoff) {
+    size_t removed = 0;
+    while (!byTime_.empty() && byTime_.begin()->first < cutoff) removed += removeWithDescendants(byTime_.begin()->second);
+    return removed;
+}
+
+void Mempool::trimLocked(int64_t now) {
+    while (totalBytes_ > maxBytes_ && !byEvict_.empty()) {
+        RateKey worst = *byEvict_.rbegin();
+        // Newcomers must now beat what was just thrown out
+        double rate = (double)worst.fee * 1000 / worst.size + INCREMENTAL_RELAY_FEE;
+        minFeeRateLocked(now);
+        if (rate > rollingMinFee_) {
+            rollingMinFee_ = rate;
+            rollingMinFeeTime_ = now;
+        }
+        removeWithDescendants(worst.txid);
+    }
+}
+
+uint64_t Mempool::minFeeRateLocked(int64_t now) const {
+    if (rollingMinFee_ == 0) return 0;
+    if (now > rollingMinFeeTime_) {
+        // Decay faster while the pool has room to spare
+        double halflife = MIN_FEE_HALFLIFE;
+        if (totalBytes_ < maxBytes_ / 4) halflife /= 4;
+        else if (totalBytes_ < maxBytes_ / 2) halflife /= 2;
+        rollingMinFee_ /= std::pow(2.0, (now - rollingMinFeeTime_) / halflife);
+        rollingMinFeeTime_ = now;
+        if (rollingMinFee_ < INCREMENTAL_RELAY_FEE / 2) rollingMinFee_ = 0;
+    }
+    return (uint64_t)std::ceil(rollingMinFee_);
+}
+
+void Mempool::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    trimLocked((int64_t)std::time(nullptr));
+}
+
+size_t Mempool::maxBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxBytes_;
+}
+
+uint64_t Mempool::getMinFeeRate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return minFeeRateLocked((int64_t)std::time(nullptr));
+}
+
+void Mempool::setFeeEstimator(FeeEstimator* estimator) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    feeEstimator_ = estimator;
+}
+
+void Mempool::setCoinsView(const UTXOSet* coins) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    coins_ = coins;
+}
+
+void Mempool::setReplaceByFee(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    replaceByFee_ = enabled;
+}
+
+bool Mempool::replaceByFee() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return replaceByFee_;
+}
+
+size_t Mempool::expire(int64_t cutoff) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expireLocked(cutoff);
 }
 
 std::optional<Transaction> Mempool::get(const uint256& txid) const {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto it = txs_.find(txid);
-    if (it == txs_.end()) return std::nullopt;
+    auto it = entries_.find(txid);
+    if (it == entries_.end()) return std::nullopt;
+    return it->second.tx;
+}
+
+std::optional<MempoolEntry> Mempool::getEntry(const uint256& txid) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(txid);
+    if (it == entries_.end()) return std::nullopt;
     return it->second;
 }
 
-std::vector<Transaction> Mempool::getBlockTemplate() const {
+std::vector<MempoolEntry> Mempool::getEntries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const MempoolEntry*> order;
+    order.reserve(entries_.size());
+    for (const auto& kv : entries_) order.push_back(&kv.second);
+    std::sort(order.begin(), order.end(), [](const MempoolEntry* a, const MempoolEntry* b) {
+        return a->ancestorCount < b->ancestorCount;
+    });
+    std::vector<MempoolEntry> out;
+    out.reserve(order.size());
+    for (const MempoolEntry* e : order) out.push_back(*e);
+    return out;
+}
+
+std::optional<uint256> Mempool::getSpender(const OutPoint& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = spentBy_.find(out);
+    if (it == spentBy_.end()) return std::nullopt;
+    return it->second;
+}
+
+std::vector<Transaction> Mempool::getBlockTemplate(size_t maxBytes) const {
     std::lock_guard<std::mutex> lock(mutex_);
     std::vector<Transaction> out;
-    for (const auto& p : txs_)
-        out.push_back(p.second);
+    std::set<uint256> taken, failed;
+    // Package totals of transactions some of whose ancestors are already in, without those
+    std::map<uint256, std::pair<uint64_t, size_t>> modified;
+    std::set<RateKey> modifiedByRate;
+    size_t bytes = 0;
+    // Once the block is nearly full and many candidates in a row have not fit, stop scanning
+    const int MAX_MISSES = 1000;
+    int misses = 0;
+    auto next = byRate_.begin();
+    while (true) {
+        while (next != byRate_.end() && (taken.count(next->txid) || failed.count(next->txid) || modified.count(next->txid)))
+            ++next;
+        bool fromModified = !modifiedByRate.empty() && (next == byRate_.end() || *modifiedByRate.begin() < *next);
+        if (!fromModified && next == byRate_.end()) break;
+        uint256 txid;
+        if (fromModified) {
+            txid = modifiedByRate.begin()->txid;
+            modifiedByRate.erase(modifiedByRate.begin());
+            modified.erase(txid);
+            if (taken.count(txid)) continue;
+        } else {
+            txid = (next++)->txid;
+        }
+
+        const MempoolEntry& e = entries_.at(txid);
+        std::vector<const MempoolEntry*> package{ &e };
+        size_t packageBytes = e.size;
+        for (const auto& id : ancestorsOf(e.parents)) {
+            if (taken.count(id)) continue;
+            package.push_back(&entries_.at(id));
+            packageBytes += package.back()->size;
+        }
+        if (bytes + packageBytes > maxBytes) {
+            failed.insert(txid);
+            if (++misses > MAX_MISSES && bytes + 1000 > maxBytes) break;
+            continue;
+        }
+        // A parent always has fewer ancestors than its child
+        std::sort(package.begin(), package.end(), [](const MempoolEntry* a, const MempoolEntry* b) {
+            return a->ancestorCount < b->ancestorCount;
+        });
+        for (const MempoolEntry* p : package) {
+            out.push_back(p->tx);
+            taken.insert(p->txid);
+            // An ancestor pulled in with this package may itself be waiting in modified
+            auto m = modified.find(p->txid);
+            if (m != modified.end()) {
+                modifiedByRate.erase({ m->second.first, m->second.second, p->txid });
+                modified.erase(m);
+            }
+        }
+        bytes += packageBytes;
+        misses = 0;
+        // Descendants no longer need to carry what just went in
+        for (const MempoolEntry* p : package) {
+            for (const auto& id : withDescendants(p->txid)) {
+                if (taken.count(id) || failed.count(id)) continue;
+                const MempoolEntry& d = entries_.at(id);
+                auto m = modified.find(id);
+                if (m == modified.end()) {
+                    m = modified.emplace(id, std::make_pair(d.ancestorFee, d.ancestorSize)).first;
+                } else {
+                    modifiedByRate.erase({ m->second.first, m->second.second, id });
+                }
+                m->second.first -= p->fee;
+                m->second.second -= p->size;
+                modifiedByRate.insert({ m->second.first, m->second.second, id });
+            }
+        }
+    }
     return out;
 }
 
 size_t Mempool::size() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    return txs_.size();
+    return entries_.size();
+}
+
+size_t Mempool::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytes_;
+}
+
+uint64_t Mempool::totalFees() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalFees_;
 }
 
 void Mempool::clear() {
     std::lock_guard<std::mutex> lock(mutex_);
-    txs_.clear();
+    entries_.clear();
+    byRate_.clear();
+    byEvict_.clear();
+    byTime_.clear();
+    spentBy_.clear();
+    totalBytes_ = 0;
+    totalFees_ = 0;
 }
 
 } // namespace shawncoin
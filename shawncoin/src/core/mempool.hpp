@@ -5,28 +5,158 @@
 #include "transaction.hpp"
 #include <vector>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <mutex>
 #include <optional>
 #include <cstddef>
+#include <cstdint>
+#include <utility>
 
 namespace shawncoin {
 
-/** Memory pool: unconfirmed transactions. Size limit and eviction by fee. */
+class FeeEstimator;
+class UTXOSet;
+
+/** A pooled transaction with its cached size, fee and in-pool ancestor totals. */
+struct MempoolEntry {
+    Transaction tx;
+    uint256 txid{};
+    uint64_t fee = 0;
+    size_t size = 0;            // serialized bytes
+    int64_t time = 0;           // unix time of entry
+    uint64_t ancestorFee = 0;   // fee of this tx plus all of its in-pool ancestors
+    size_t ancestorSize = 0;
+    size_t ancestorCount = 0;   // including this tx
+    uint64_t descendantFee = 0; // fee of this tx plus all in-pool transactions spending from it
+    size_t descendantSize = 0;
+    size_t descendantCount = 0; // including this tx
+    std::set<uint256> parents;  // in-pool transactions this one spends from
+    std::set<uint256> children; // in-pool transactions spending from this one
+};
+
+/** Memory pool: unconfirmed transactions, indexed by txid, by ancestor fee rate (fee per
+ *  byte of the transaction together with the unconfirmed parents it needs), by entry time
+ *  and by the outpoints they spend. A transaction spending an outpoint another pooled
+ *  transaction already spends is rejected, unless replace-by-fee is enabled and it pays
+ *  enough to replace the conflicting transactions and their descendants (see add()).
+ *  Transactions are also rejected if they would make a package
+ *  (a tx with its in-pool ancestors, or with its descendants) exceed the limits below, which
+ *  bound the work of keeping the cached package totals up to date.
+ *  The pool is bounded in serialized bytes. When an addition pushes it over, the package
+ *  with the lowest fee rate (a transaction with its descendants, rated by the better of its
+ *  own and the package's rate) is evicted until it fits, and the minimum fee rate for new
+ *  transactions rises above what was evicted, decaying again over time.
+ *  add() takes the fee on trust and does not check values or signatures; transactions from
+ *  outside go through MempoolAcceptor, which does. With a coins view attached, add() does
+ *  check under the pool lock that every input still exists, so a block or removal landing
+ *  after the acceptor's lookup cannot let in a transaction spending something gone. */
 class Mempool {
 public:
-    static constexpr size_t MAX_MEMPOOL_SIZE = 100000;
+    static constexpr size_t DEFAULT_MAX_BYTES = 300 * 1000 * 1000;
     static constexpr size_t MAX_TX_SIZE = 100000;
+    /** Added to the rate of an evicted package to get the new minimum (satoshis per 1000 bytes). */
+    static constexpr uint64_t INCREMENTAL_RELAY_FEE = 1000;
+    static constexpr int64_t MIN_FEE_HALFLIFE = 12 * 60 * 60;
+    static constexpr size_t MAX_TEMPLATE_BYTES = 1000000;
+    static constexpr size_t MAX_PACKAGE_COUNT = 25;
+    static constexpr size_t MAX_PACKAGE_BYTES = 101000;
+    static constexpr int64_t EXPIRY_SECONDS = 14 * 24 * 60 * 60;
+    /** Most transactions (conflicts plus their descendants) one replacement may evict. */
+    static constexpr size_t MAX_REPLACEMENTS = 100;
 
-    bool add(const Transaction& tx, uint64_t fee);
+    /** Admit tx paying fee. With replace-by-fee on, a tx conflicting with pooled ones replaces
+     *  them if it pays a higher fee rate than each, at least their fees plus those of their
+     *  descendants plus the incremental relay fee for its own size, evicts no more than
+     *  MAX_REPLACEMENTS transactions and does not spend from any of them. time is the entry
+     *  time (unix seconds) to record, 0 for now; reloaded transactions keep their original one. */
+    bool add(const Transaction& tx, uint64_t fee, int64_t time = 0);
+    /** Remove a transaction and everything in the pool that spends its outputs. */
     bool remove(const uint256& txid);
+    /** Drop what a newly connected block makes obsolete: its transactions, which leave their
+     *  in-pool children with confirmed parents, and anything else spending the same outpoints,
+     *  with descendants. One lock acquisition; the work follows the block, not the pool.
+     *  The fee estimator, if any, learns which entries the block at height confirmed.
+     *  Returns how many transactions were removed. */
+    size_t removeForBlock(const Block& block, uint64_t height);
     std::optional<Transaction> get(const uint256& txid) const;
-    std::vector<Transaction> getBlockTemplate() const;
+    std::optional<MempoolEntry> getEntry(const uint256& txid) const;
+    /** Every entry, parents before children. */
+    std::vector<MempoolEntry> getEntries() const;
+    /** Pooled transaction spending out, if any. */
+    std::optional<uint256> getSpender(const OutPoint& out) const;
+    /** Transactions for a block of at most maxBytes, chosen by ancestor package fee rate:
+     *  the best package goes in with its unconfirmed ancestors (parents first), and the
+     *  packages of their descendants are re-rated without what is already in, so a child
+     *  paying for its parent lifts both. */
+    std::vector<Transaction> getBlockTemplate(size_t maxBytes = MAX_TEMPLATE_BYTES) const;
+    /** Remove transactions that entered before cutoff (unix time); returns how many. */
+    size_t expire(int64_t cutoff);
     size_t size() const;
+    /** Serialized bytes and fees of all pooled transactions; O(1). */
+    size_t bytes() const;
+    uint64_t totalFees() const;
     void clear();
 
+    void setMaxBytes(size_t maxBytes);
+    size_t maxBytes() const;
+    /** Fee rate (satoshis per 1000 bytes) a new transaction must pay; 0 until the pool has had
+     *  to evict. */
+    uint64_t getMinFeeRate() const;
+    /** Report entries, confirmations and other removals to estimator (may be null). */
+    void setFeeEstimator(FeeEstimator* estimator);
+    /** Chain coins for add() to check inputs against (may be null): each input must be one
+     *  of them or an output of a pooled transaction. */
+    void setCoinsView(const UTXOSet* coins);
+    /** Allow conflicting transactions to replace pooled ones (off by default). */
+    void setReplaceByFee(bool enabled);
+    bool replaceByFee() const;
+
 private:
+    /** Orders entries by ancestor fee rate, best first; txid breaks ties. */
+    struct RateKey {
+        uint64_t fee;
+        size_t size;
+        uint256 txid;
+        bool operator<(const RateKey& o) const;
+    };
+    struct OutPointHasher {
+        size_t operator()(const OutPoint& out) const;
+    };
+    using EntryMap = std::map<uint256, MempoolEntry>;
+
+    static RateKey rateKey(const MempoolEntry& e) { return { e.ancestorFee, e.ancestorSize, e.txid }; }
+    /** Eviction score: the better of the tx's own rate and that of it with its descendants,
+     *  so a parent is not evicted while a child is paying for it. */
+    static RateKey evictKey(const MempoolEntry& e);
+    /** In-pool ancestors reachable from the given parents (parents included). */
+    std::vector<uint256> ancestorsOf(const std::set<uint256>& parents) const;
+    /** Entry and every in-pool transaction descending from it, parents before children. */
+    std::vector<uint256> withDescendants(const uint256& txid) const;
+    /** Remove txid and its descendants, updating the descendant totals of their ancestors. */
+    size_t removeWithDescendants(const uint256& txid);
+    /** Remove a transaction that was confirmed; its descendants stay, minus it as an ancestor. */
+    void removeConfirmed(const uint256& txid);
+    void removeLocked(const uint256& txid);
+    size_t expireLocked(int64_t cutoff);
+    /** Evict lowest-rate packages until the pool fits its byte limit. */
+    void trimLocked(int64_t now);
+    uint64_t minFeeRateLocked(int64_t now) const;
+
     mutable std::mutex mutex_;
-    std::map<uint256, Transaction> txs_;
+    EntryMap entries_;
+    std::set<RateKey> byRate_;
+    std::set<RateKey> byEvict_; // last element is evicted first
+    std::set<std::pair<int64_t, uint256>> byTime_;
+    std::unordered_map<OutPoint, uint256, OutPointHasher> spentBy_;
+    size_t totalBytes_ = 0;
+    uint64_t totalFees_ = 0;
+    size_t maxBytes_ = DEFAULT_MAX_BYTES;
+    bool replaceByFee_ = false;
+    FeeEstimator* feeEstimator_ = nullptr;
+    const UTXOSet* coins_ = nullptr;
+    mutable double rollingMinFee_ = 0; // satoshis per 1000 bytes
+    mutable int64_t rollingMinFeeTime_ = 0;
 };
 
 } // namespace shawncoin
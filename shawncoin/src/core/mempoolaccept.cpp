@@ -0,0 +1,121 @@
+#include "core/mempoolaccept.hpp"
+#include "core/consensus.hpp"
+#include "core/mempool.hpp"
+#include "core/orphanpool.hpp"
+#include "core/utxo.hpp"
+#include "util/checkqueue.hpp"
+#include <set>
+#include <vector>
+
+namespace shawncoin {
+
+const char* acceptStatusName(AcceptStatus status) {
+    switch (status) {
+    case AcceptStatus::Accepted: return "accepted";
+    case AcceptStatus::Invalid: return "invalid";
+    case AcceptStatus::MissingInputs: return "missing-inputs";
+    case AcceptStatus::InsufficientValue: return "insufficient-value";
+    case AcceptStatus::BadSignature: return "bad-signature";
+    case AcceptStatus::Rejected: return "rejected";
+    }
+    return "unknown";
+}
+
+MempoolAcceptor::MempoolAcceptor(Mempool& pool, const UTXOSet& utxo, unsigned threads)
+    : pool_(pool), utxo_(utxo), workers_(threads) {}
+
+std::future<AcceptResult> MempoolAcceptor::submit(Transaction tx, int64_t time, int64_t peer) {
+    return workers_.submit([this, tx = std::move(tx), time, peer]() { return accept(tx, time, peer); });
+}
+
+AcceptResult MempoolAcceptor::accept(const Transaction& tx, int64_t time, int64_t peer) {
+    std::vector<uint256> missing;
+    AcceptResult result = check(tx, time, missing);
+    if (!orphans_) return result;
+    if (result.status == AcceptStatus::MissingInputs) {
+        holdOrphan(tx, peer, missing);
+    } else if (result.status == AcceptStatus::Accepted) {
+        // Children that were waiting on this one; results arrive through their own acceptance
+        for (auto& o : orphans_->takeChildren(tx)) submit(std::move(o.tx), 0, o.peer);
+    }
+    return result;
+}
+
+void MempoolAcceptor::holdOrphan(const Transaction& tx, int64_t peer, const std::vector<uint256>& missing) {
+    if (!orphans_->add(tx, peer)) return;
+    // A parent accepted between the lookup and the add would never release this orphan
+    for (const auto& parent : missing) {
+        if (pool_.get(parent).has_value() && orphans_->erase(tx.getTxid())) {
+            submit(tx, 0, peer);
+            return;
+        }
+    }
+}
+
+AcceptResult MempoolAcceptor::check(const Transaction& tx, int64_t time, std::vector<uint256>& missing) {
+    AcceptResult result;
+    if (tx.isCoinbase() || !validateTransactionStructure(tx)) return result;
+    std::set<OutPoint> spends;
+    for (const auto& in : tx.inputs) {
+        if (!spends.insert(OutPoint{ in.prev_tx_hash, in.output_index }).second) return result;
+    }
+
+    // Coins spent, from the chain or from pooled parents
+    std::vector<Coin> coins;
+    coins.reserve(tx.inputs.size());
+    for (const auto& in : tx.inputs) {
+        if (auto coin = utxo_.get(OutPoint{ in.prev_tx_hash, in.output_index })) {
+            coins.push_back(std::move(*coin));
+            continue;
+        }
+        auto parent = pool_.get(in.prev_tx_hash);
+        if (!parent || in.output_index >= parent->outputs.size()) {
+            missing.push_back(in.prev_tx_hash);
+            continue;
+        }
+        const TxOutput& out = parent->outputs[in.output_index];
+        coins.push_back(Coin{ out.amount, out.script_pubkey });
+    }
+    if (!missing.empty()) {
+        result.status = AcceptStatus::MissingInputs;
+        return result;
+    }
+
+    uint64_t inValue = 0;
+    for (const auto& c : coins) {
+        if (c.amount > MAX_MONEY || inValue + c.amount > MAX_MONEY) {
+            result.status = AcceptStatus::Invalid;
+            return result;
+        }
+        inValue += c.amount;
+    }
+    uint64_t outValue = tx.getTotalOutput();
+    if (inValue < outValue) {
+        result.status = AcceptStatus::InsufficientValue;
+        return result;
+    }
+    result.fee = inValue - outValue;
+
+    uint256 hash = signatureHash(tx);
+    bool schnorr = tx.version == TX_VERSION_SCHNORR;
+    auto verify = [&](size_t i) {
+        const Script& script = coins[i].script_pubkey;
+        return schnorr ? verifyInputSchnorr(tx.inputs[i], script, hash, sigCache_, true)
+                       : verifyInputSignature(tx.inputs[i], script, hash, sigCache_, true);
+    };
+    bool valid = true;
+    if (checkQueue_ && tx.inputs.size() > 1) {
+        valid = checkQueue_->run(tx.inputs.size(), verify);
+    } else {
+        for (size_t i = 0; i < tx.inputs.size() && valid; ++i) valid = verify(i);
+    }
+    if (!valid) {
+        result.status = AcceptStatus::BadSignature;
+        return result;
+    }
+
+    result.status = pool_.add(tx, result.fee, time) ? AcceptStatus::Accepted : AcceptStatus::Rejected;
+    return result;
+}
+
+} // namespace shawncoin
@@ -0,0 +1,77 @@
+#ifndef SHAWNCOIN_CORE_MEMPOOLACCEPT_HPP
+#define SHAWNCOIN_CORE_MEMPOOLACCEPT_HPP
+
+#include "core/types.hpp"
+#include "util/threadpool.hpp"
+#include <cstdint>
+#include <future>
+#include <vector>
+
+namespace shawncoin {
+
+class CheckQueue;
+class Mempool;
+class OrphanPool;
+class SignatureCache;
+class UTXOSet;
+
+enum class AcceptStatus {
+    Accepted,
+    Invalid,           // malformed, coinbase, or spends an outpoint twice
+    MissingInputs,     // an input is neither a coin nor an output of a pooled transaction
+    InsufficientValue, // outputs exceed inputs
+    BadSignature,
+    Rejected,          // valid, but refused by the pool (conflict, fee, package limits)
+};
+
+const char* acceptStatusName(AcceptStatus status);
+
+struct AcceptResult {
+    AcceptStatus status = AcceptStatus::Invalid;
+    uint64_t fee = 0; // inputs minus outputs, once known
+};
+
+/** Checks transactions before they enter the mempool, cheapest first: structure, then the
+ *  coins they spend (from the UTXO set or pooled parents), then value, then one signature
+ *  verification per input. Transactions handed to submit() go through all of this on a
+ *  worker pool, so many arrivals are verified in parallel; with a check queue attached, the
+ *  inputs of one transaction are also spread over its workers, which is what speeds up
+ *  accept() from the RPC and the mempool.dat loader. The mempool lock is taken only to
+ *  insert the result. With an orphan pool attached, a transaction missing inputs is held
+ *  there, and when a transaction is accepted the orphans spending it are taken out and
+ *  submitted again as a batch. */
+class MempoolAcceptor {
+public:
+    /** Validate against utxo and insert into pool, using threads workers (0: one per core). */
+    MempoolAcceptor(Mempool& pool, const UTXOSet& utxo, unsigned threads = 0);
+
+    /** Hold transactions with missing inputs in orphans (may be null). Set before use. */
+    void setOrphanPool(OrphanPool* orphans) { orphans_ = orphans; }
+    /** Look up and record verified signatures in cache (may be null). Set before use. */
+    void setSignatureCache(SignatureCache* cache) { sigCache_ = cache; }
+    /** Verify the inputs of a transaction on queue (may be null: on the checking thread).
+     *  Set before use. */
+    void setCheckQueue(CheckQueue* queue) { checkQueue_ = queue; }
+
+    /** Validate and insert tx, received from peer (0 for local), on a worker. time is the
+     *  entry time for Mempool::add. */
+    std::future<AcceptResult> submit(Transaction tx, int64_t time = 0, int64_t peer = 0);
+    /** Validate and insert tx on the calling thread. */
+    AcceptResult accept(const Transaction& tx, int64_t time = 0, int64_t peer = 0);
+
+private:
+    AcceptResult check(const Transaction& tx, int64_t time, std::vector<uint256>& missing);
+    /** Hold tx as an orphan, unless its parents arrived meanwhile, then it is retried. */
+    void holdOrphan(const Transaction& tx, int64_t peer, const std::vector<uint256>& missing);
+
+    Mempool& pool_;
+    const UTXOSet& utxo_;
+    OrphanPool* orphans_ = nullptr;
+    SignatureCache* sigCache_ = nullptr;
+    CheckQueue* checkQueue_ = nullptr;
+    ThreadPool workers_;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_MEMPOOLACCEPT_HPP
@@ -0,0 +1,127 @@
+#include "core/orphanpool.hpp"
+#include "core/transaction.hpp"
+#include <ctime>
+
+namespace shawncoin {
+
+OrphanPool::OrphanPool(size_t maxBytes) : maxBytes_(maxBytes), rng_(std::random_device{}()) {}
+
+bool OrphanPool::add(const Transaction& tx, int64_t peer) {
+    std::vector<uint8_t> raw;
+    serializeTransaction(tx, raw);
+    if (raw.size() > MAX_TX_SIZE || raw.size() > maxBytes_) return false;
+    uint256 txid = tx.getTxid();
+    int64_t now = (int64_t)std::time(nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    expireLocked(now - EXPIRY_SECONDS);
+    if (entries_.count(txid)) return false;
+    auto pb = peerBytes_.find(peer);
+    if (pb != peerBytes_.end() && pb->second + raw.size() > MAX_PEER_BYTES) return false;
+    while (totalBytes_ + raw.size() > maxBytes_) {
+        std::uniform_int_distribution<size_t> pick(0, slots_.size() - 1);
+        eraseLocked(slots_[pick(rng_)]);
+    }
+
+    Entry e;
+    e.tx = tx;
+    e.peer = peer;
+    e.time = now;
+    e.size = raw.size();
+    e.slot = slots_.size();
+    slots_.push_back(txid);
+    for (const auto& in : tx.inputs) byPrevout_[OutPoint{ in.prev_tx_hash, in.output_index }].insert(txid);
+    byTime_.insert({ now, txid });
+    peerBytes_[peer] += e.size;
+    totalBytes_ += e.size;
+    entries_.emplace(txid, std::move(e));
+    return true;
+}
+
+void OrphanPool::eraseLocked(const uint256& txid) {
+    auto it = entries_.find(txid);
+    if (it == entries_.end()) return;
+    const Entry& e = it->second;
+    for (const auto& in : e.tx.inputs) {
+        auto p = byPrevout_.find(OutPoint{ in.prev_tx_hash, in.output_index });
+        if (p == byPrevout_.end()) continue;
+        p->second.erase(txid);
+        if (p->second.empty()) byPrevout_.erase(p);
+    }
+    byTime_.erase({ e.time, txid });
+    auto pb = peerBytes_.find(e.peer);
+    pb->second -= e.size;
+    if (pb->second == 0) peerBytes_.erase(pb);
+    totalBytes_ -= e.size;
+    // Fill the hole with the last slot
+    const uint256 moved = slots_.back();
+    slots_[e.slot] = moved;
+    entries_.at(moved).slot = e.slot;
+    slots_.pop_back();
+    entries_.erase(it);
+}
+
+std::vector<Orphan> OrphanPool::takeChildren(const Transaction& parent) {
+    uint256 txid = parent.getTxid();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::set<uint256> children;
+    for (uint32_t i = 0; i < parent.outputs.size(); ++i) {
+        auto p = byPrevout_.find(OutPoint{ txid, i });
+        if (p != byPrevout_.end()) children.insert(p->second.begin(), p->second.end());
+    }
+    std::vector<Orphan> out;
+    out.reserve(children.size());
+    for (const auto& c : children) {
+        const Entry& e = entries_.at(c);
+        out.push_back(Orphan{ e.tx, e.peer });
+        eraseLocked(c);
+    }
+    return out;
+}
+
+bool OrphanPool::erase(const uint256& txid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!entries_.count(txid)) return false;
+    eraseLocked(txid);
+    return true;
+}
+
+size_t OrphanPool::eraseForPeer(int64_t peer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint256> doomed;
+    for (const auto& kv : entries_) {
+        if (kv.second.peer == peer) doomed.push_back(kv.first);
+    }
+    for (const auto& id : doomed) eraseLocked(id);
+    return doomed.size();
+}
+
+size_t OrphanPool::expireLocked(int64_t cutoff) {
+    size_t removed = 0;
+    while (!byTime_.empty() && byTime_.begin()->first < cutoff) {
+        eraseLocked(byTime_.begin()->second);
+        ++removed;
+    }
+    return removed;
+}
+
+size_t OrphanPool::expire(int64_t cutoff) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expireLocked(cutoff);
+}
+
+bool OrphanPool::has(const uint256& txid) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(txid) != 0;
+}
+
+size_t OrphanPool::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t OrphanPool::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytes_;
+}
+
+} // namespace shawncoin
@@ -0,0 +1,76 @@
+#ifndef SHAWNCOIN_CORE_ORPHANPOOL_HPP
+#define SHAWNCOIN_CORE_ORPHANPOOL_HPP
+
+#include "core/types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace shawncoin {
+
+/** A transaction waiting for a parent, with the peer it came from. */
+struct Orphan {
+    Transaction tx;
+    int64_t peer = 0;
+};
+
+/** Transactions that spend outputs not known yet, held until their parents arrive instead of
+ *  being dropped and downloaded again. Indexed by the outpoints they spend, so the children
+ *  of an accepted transaction are found by its txid and output count. Bounded in serialized
+ *  bytes overall (random orphans are evicted to make room, so a peer cannot choose which
+ *  survive) and per peer (a peer over its share is refused); orphans expire after
+ *  EXPIRY_SECONDS. Thread-safe. */
+class OrphanPool {
+public:
+    static constexpr size_t DEFAULT_MAX_BYTES = 5000000;
+    static constexpr size_t MAX_PEER_BYTES = 1000000;
+    static constexpr size_t MAX_TX_SIZE = 100000;
+    static constexpr int64_t EXPIRY_SECONDS = 20 * 60;
+
+    explicit OrphanPool(size_t maxBytes = DEFAULT_MAX_BYTES);
+
+    /** Hold tx from peer; false if it is too large, already held, or the peer is over its share. */
+    bool add(const Transaction& tx, int64_t peer);
+    /** Remove and return the orphans spending any output of parent. */
+    std::vector<Orphan> takeChildren(const Transaction& parent);
+    bool erase(const uint256& txid);
+    /** Drop everything a peer sent (on disconnect); returns how many. */
+    size_t eraseForPeer(int64_t peer);
+    /** Drop orphans received before cutoff (unix time); returns how many. */
+    size_t expire(int64_t cutoff);
+
+    bool has(const uint256& txid) const;
+    size_t size() const;
+    size_t bytes() const;
+
+private:
+    struct Entry {
+        Transaction tx;
+        int64_t peer = 0;
+        int64_t time = 0;
+        size_t size = 0;
+        size_t slot = 0; // position in slots_
+    };
+
+    void eraseLocked(const uint256& txid);
+    size_t expireLocked(int64_t cutoff);
+
+    mutable std::mutex mutex_;
+    std::map<uint256, Entry> entries_;
+    std::map<OutPoint, std::set<uint256>> byPrevout_;
+    std::set<std::pair<int64_t, uint256>> byTime_;
+    std::map<int64_t, size_t> peerBytes_;
+    std::vector<uint256> slots_; // every orphan once, for picking one at random
+    size_t totalBytes_ = 0;
+    size_t maxBytes_;
+    std::mt19937_64 rng_;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_ORPHANPOOL_HPP
@@ -0,0 +1,62 @@
+#include "core/sigcache.hpp"
+#include "crypto/hash.h"
+#include <cstring>
+#include <mutex>
+#include <random>
+
+namespace shawncoin {
+
+namespace {
+
+size_t bucketOf(const uint256& key, size_t mask) {
+    uint64_t h = 0;
+    memcpy(&h, key.data(), 8);
+    return (size_t)h & mask;
+}
+
+} // namespace
+
+SignatureCache::SignatureCache(size_t maxBytes) {
+    std::random_device rd;
+    for (auto& b : salt_) b = (uint8_t)rd();
+    size_t buckets = 1;
+    while (buckets * 2 * BUCKET_SIZE * sizeof(uint256) <= maxBytes) buckets <<= 1;
+    slots_.assign(buckets * BUCKET_SIZE, uint256{});
+    bucketMask_ = buckets - 1;
+}
+
+uint256 SignatureCache::entryKey(const uint256& hash, const std::vector<uint8_t>& pubkey,
+                                 const std::vector<uint8_t>& signature) const {
+    std::vector<uint8_t> data;
+    data.reserve(salt_.size() + hash.size() + pubkey.size() + signature.size());
+    data.insert(data.end(), salt_.begin(), salt_.end());
+    data.insert(data.end(), hash.begin(), hash.end());
+    data.insert(data.end(), pubkey.begin(), pubkey.end());
+    data.insert(data.end(), signature.begin(), signature.end());
+    uint256 key;
+    shawncoin_sha256(data.data(), data.size(), key.data());
+    return key;
+}
+
+bool SignatureCache::contains(const uint256& key) const {
+    const uint256* bucket = &slots_[bucketOf(key, bucketMask_) * BUCKET_SIZE];
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < BUCKET_SIZE; ++i)
+        if (bucket[i] == key) return true;
+    return false;
+}
+
+void SignatureCache::insert(const uint256& key) {
+    uint256* bucket = &slots_[bucketOf(key, bucketMask_) * BUCKET_SIZE];
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+        if (bucket[i] == key) return;
+        if (bucket[i] == uint256{}) {
+            bucket[i] = key;
+            return;
+        }
+    }
+    bucket[key[8] & (BUCKET_SIZE - 1)] = key;
+}
+
+} // namespace shawncoin
@@ -0,0 +1,46 @@
+#ifndef SHAWNCOIN_CORE_SIGCACHE_HPP
+#define SHAWNCOIN_CORE_SIGCACHE_HPP
+
+#include "core/types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+namespace shawncoin {
+
+/** Signatures already verified, so a transaction checked on entry to the mempool is not
+ *  verified again when a block confirms it. Each entry is SHA-256 of a per-process random
+ *  salt with the (sighash, pubkey, signature) triple; the salt keeps peers from predicting
+ *  where entries land. Entries live in buckets of four; inserting into a full bucket
+ *  overwrites one picked by the entry's own hash bits, which the salt makes random. Lookups
+ *  share a reader lock. Only successful verifications are stored. */
+class SignatureCache {
+public:
+    static constexpr size_t DEFAULT_MAX_BYTES = 32 << 20;
+
+    /** Room for about maxBytes / 32 entries (rounded down to a power of two). */
+    explicit SignatureCache(size_t maxBytes = DEFAULT_MAX_BYTES);
+
+    /** Salted key for a signature over hash by pubkey. */
+    uint256 entryKey(const uint256& hash, const std::vector<uint8_t>& pubkey,
+                     const std::vector<uint8_t>& signature) const;
+    bool contains(const uint256& key) const;
+    void insert(const uint256& key);
+
+    /** Slots, filled or not. */
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    static constexpr size_t BUCKET_SIZE = 4;
+
+    std::array<uint8_t, 32> salt_;
+    std::vector<uint256> slots_; // all zero marks an empty slot
+    size_t bucketMask_ = 0;
+    mutable std::shared_mutex mutex_;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_SIGCACHE_HPP
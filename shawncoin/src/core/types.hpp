@@ -1,6 +1,7 @@
 #ifndef SHAWNCOIN_CORE_TYPES_HPP
 #define SHAWNCOIN_CORE_TYPES_HPP
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <vector>
@@ -51,6 +52,9 @@ struct Transaction {
     uint64_t getTotalInput() const; // requires UTXO lookup; 0 for coinbase
 };
 
+// Transactions of this version sign their inputs with BIP340 Schnorr instead of ECDSA
+constexpr uint32_t TX_VERSION_SCHNORR = 2;
+
 // Block header (80 bytes for hashing, minus variable tx list)
 struct BlockHeader {
     uint32_t version = 1;
@@ -88,11 +92,18 @@ inline uint64_t getBlockSubsidy(uint64_t height) {
     return subsidy;
 }
 
-/** Total SHWN issued from block 0 up to and including height (for display). */
+/** Scheduled SHWN subsidy from block 0 up to and including height; one step per halving era.
+ *  The chain's actual issuance is tracked by Blockchain::getTotalSupply(). */
 inline uint64_t getTotalSupplyUpTo(uint64_t height) {
     uint64_t total = 0;
-    for (uint64_t h = 0; h <= height; ++h)
-        total += getBlockSubsidy(h);
+    for (uint64_t era = 0; era < 64; ++era) {
+        uint64_t first = era * SUBSIDY_HALVING_INTERVAL;
+        if (first > height) break;
+        uint64_t subsidy = getBlockSubsidy(first);
+        if (subsidy == 0) break;
+        uint64_t last = std::min(height, first + SUBSIDY_HALVING_INTERVAL - 1);
+        total += subsidy * (last - first + 1);
+    }
     return total;
 }
 
@@ -0,0 +1,58 @@
+#include "core/undo.hpp"
+#include "util/serialize.hpp"
+#include <cstring>
+
+namespace shawncoin {
+
+void serializeBlockUndo(const BlockUndo& undo, std::vector<uint8_t>& out) {
+    serializeVarInt(out, undo.spent.size());
+    for (const auto& c : undo.spent) {
+        serializeUint256(out, c.outpoint.hash);
+        serializeU32(out, c.outpoint.index);
+        serializeU64(out, c.amount);
+        serializeVarInt(out, c.script_pubkey.size());
+        out.insert(out.end(), c.script_pubkey.begin(), c.script_pubkey.end());
+    }
+}
+
+bool deserializeBlockUndo(const uint8_t* data, size_t len, BlockUndo& undo) {
+    size_t pos = 0;
+    auto read = [&](void* dst, size_t n) {
+        if (pos + n > len) return false;
+        memcpy(dst, data + pos, n);
+        pos += n;
+        return true;
+    };
+    auto readVarInt = [&](size_t& out) -> bool {
+        if (pos >= len) return false;
+        if (data[pos] < 0xfd) { out = data[pos++]; return true; }
+        if (data[pos] == 0xfd && pos + 3 <= len) {
+            out = data[pos+1] | (data[pos+2] << 8);
+            pos += 3;
+            return true;
+        }
+        if (data[pos] == 0xfe && pos + 5 <= len) {
+            out = (size_t)data[pos+1] | (data[pos+2]<<8) | (data[pos+3]<<16) | ((size_t)data[pos+4]<<24);
+            pos += 5;
+            return true;
+        }
+        return false;
+    };
+    size_t n = 0;
+    if (!data || !readVarInt(n)) return false;
+    undo.spent.clear();
+    for (size_t i = 0; i < n; ++i) {
+        SpentCoin c;
+        if (!read(c.outpoint.hash.data(), 32)) return false;
+        if (!read(&c.outpoint.index, 4)) return false;
+        if (!read(&c.amount, 8)) return false;
+        size_t scriptLen = 0;
+        if (!readVarInt(scriptLen) || scriptLen > 10000) return false;
+        c.script_pubkey.resize(scriptLen);
+        if (scriptLen && !read(c.script_pubkey.data(), scriptLen)) return false;
+        undo.spent.push_back(std::move(c));
+    }
+    return pos == len;
+}
+
+} // namespace shawncoin
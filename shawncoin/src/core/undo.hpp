@@ -0,0 +1,30 @@
+#ifndef SHAWNCOIN_CORE_UNDO_HPP
+#define SHAWNCOIN_CORE_UNDO_HPP
+
+#include "core/types.hpp"
+#include <vector>
+#include <cstddef>
+
+namespace shawncoin {
+
+/** Output consumed by a block input, kept so the block can be disconnected. */
+struct SpentCoin {
+    OutPoint outpoint;
+    uint64_t amount = 0;
+    Script script_pubkey;
+};
+
+/** Undo record for one block: every coin its inputs spent, in input order. */
+struct BlockUndo {
+    std::vector<SpentCoin> spent;
+};
+
+/** Append serialized undo record to buffer */
+void serializeBlockUndo(const BlockUndo& undo, std::vector<uint8_t>& out);
+
+/** Deserialize undo record; returns false on error */
+bool deserializeBlockUndo(const uint8_t* data, size_t len, BlockUndo& undo);
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CORE_UNDO_HPP
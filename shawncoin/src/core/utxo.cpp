@@ -1,43 +1,461 @@
 #include "core/utxo.hpp"
 #include <algorithm>
+#include <cstring>
+#include <random>
 
 namespace shawncoin {
 
-void UTXOSet::put(const OutPoint& out, uint64_t amount, Script script_pubkey) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    map_[out] = { amount, std::move(script_pubkey) };
+std::vector<uint8_t> coinHashData(const OutPoint& out, const Coin& coin) {
+    std::vector<uint8_t> data(out.hash.begin(), out.hash.end());
+    data.reserve(32 + 4 + 8 + 4 + coin.script_pubkey.size());
+    for (int i = 0; i < 4; ++i) data.push_back((uint8_t)(out.index >> (8 * i)));
+    for (int i = 0; i < 8; ++i) data.push_back((uint8_t)(coin.amount >> (8 * i)));
+    uint32_t len = (uint32_t)coin.script_pubkey.size();
+    for (int i = 0; i < 4; ++i) data.push_back((uint8_t)(len >> (8 * i)));
+    data.insert(data.end(), coin.script_pubkey.begin(), coin.script_pubkey.end());
+    return data;
+}
+
+UTXOSet::UTXOSet() {
+    // Salted so that txids ground to share low bits cannot pile into one probe run
+    std::random_device rd;
+    for (auto& s : salt_) s = ((uint64_t)rd() << 32) ^ rd();
+}
+
+UTXOSet::AllShardsLock::AllShardsLock(const UTXOSet& set) : set_(set) {
+    for (auto& shard : set_.shards_) shard.mutex.lock();
+}
+
+UTXOSet::AllShardsLock::~AllShardsLock() {
+    for (auto it = set_.shards_.rbegin(); it != set_.shards_.rend(); ++it) it->mutex.unlock();
+}
+
+uint64_t UTXOSet::hashOutPoint(const OutPoint& out) const {
+    uint64_t a = 0, b = 0;
+    memcpy(&a, out.hash.data(), 8);
+    memcpy(&b, out.hash.data() + 8, 8);
+    uint64_t h = (a ^ salt_[0]) + ((b ^ salt_[1]) << 29 | (b ^ salt_[1]) >> 35) + out.index * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+CoinsMap& UTXOSet::writable(Shard& shard) const {
+    // Views take their references under the shard lock we hold and only ever drop them, so a
+    // count of one is exact
+    Layers& layers = shard.layers;
+    while (layers.size() > 1 && layers.back().use_count() == 1 && layers[layers.size() - 2].use_count() == 1)
+        mergeTop(shard);
+    if (layers.back().use_count() > 1) layers.push_back(std::make_shared<CoinsMap>());
+    return *layers.back();
+}
+
+void UTXOSet::mergeTop(Shard& shard) const {
+    Layers& layers = shard.layers;
+    size_t lowerIndex = layers.size() - 2;
+    CoinsMap& lower = *layers[lowerIndex];
+    layers.back()->forEach([&](const OutPoint& out, uint8_t flags, bool spent, const Coin& coin) {
+        uint64_t hash = hashOutPoint(out);
+        if (!spent) {
+            lower.put(out, hash, coin, flags);
+        } else if ((flags & FRESH) && !heldBelow(layers, lowerIndex, out, hash)) {
+            lower.erase(out, hash);
+        } else {
+            size_t slot = lower.find(out, hash);
+            if (slot == CoinsMap::npos) slot = lower.put(out, hash, Coin(), flags);
+            lower.markSpent(slot, flags);
+        }
+        return true;
+    });
+    layers.pop_back();
+}
+
+bool UTXOSet::heldBelow(const Layers& layers, size_t below, const OutPoint& out, uint64_t hash) {
+    for (size_t i = 0; i < below; ++i) {
+        if (layers[i]->find(out, hash) != CoinsMap::npos) return true;
+    }
+    return false;
+}
+
+template <typename Fn>
+bool UTXOSet::forEachEntry(const Layers& layers, Fn&& fn) const {
+    for (size_t i = layers.size(); i-- > 0;) {
+        bool more = layers[i]->forEach([&](const OutPoint& out, uint8_t flags, bool spent, const Coin& coin) {
+            if (i + 1 < layers.size()) {
+                // Shadowed by a newer entry, which was visited already
+                uint64_t hash = hashOutPoint(out);
+                for (size_t j = i + 1; j < layers.size(); ++j) {
+                    if (layers[j]->find(out, hash) != CoinsMap::npos) return true;
+                }
+            }
+            return fn(out, flags, spent, coin);
+        });
+        if (!more) return false;
+    }
+    return true;
+}
+
+size_t UTXOSet::memoryUsage(const Shard& shard) {
+    size_t n = 0;
+    for (const auto& layer : shard.layers) n += layer->memoryUsage();
+    return n;
+}
+
+void UTXOSet::accountUsage(const Shard& shard, size_t before) const {
+    size_t after = memoryUsage(shard);
+    if (after >= before) usage_ += after - before;
+    else usage_ -= before - after;
+}
+
+UTXOSet::CacheEntry UTXOSet::lookup(Shard& shard, const OutPoint& out, uint64_t hash, bool fromBackend) const {
+    CacheEntry e;
+    for (auto it = shard.layers.rbegin(); it != shard.layers.rend(); ++it) {
+        size_t slot = (*it)->find(out, hash);
+        if (slot == CoinsMap::npos) continue;
+        e.found = true;
+        e.spent = (*it)->spent(slot);
+        e.flags = (*it)->flags(slot);
+        if (!e.spent) e.coin = (*it)->coin(slot);
+        return e;
+    }
+    if (!fromBackend || !base_) return e;
+    if (shard.filterValid && !shard.filter.contains(hash)) return e;
+    std::optional<Coin> coin = base_->getCoin(out);
+    if (!coin) return e;
+    e.found = true;
+    e.coin = std::move(*coin);
+    // Under an open view a clean copy would need a layer of its own; read the backend again instead
+    if (shard.layers.back().use_count() == 1) {
+        size_t before = memoryUsage(shard);
+        writable(shard).put(out, hash, e.coin, 0);
+        accountUsage(shard, before);
+    }
+    return e;
+}
+
+void UTXOSet::setBackend(CoinsView* base, size_t maxCacheBytes, bool keepCache) {
+    AllShardsLock lock(*this);
+    base_ = base;
+    maxCacheBytes_ = maxCacheBytes;
+    if (!base_) {
+        for (auto& shard : shards_) {
+            shard.filter = CuckooFilter();
+            shard.filterValid = false;
+        }
+        return;
+    }
+    CoinsStats stats = base_->getStats();
+    flushedHash_ = std::move(stats.muhash);
+    if (!keepCache) {
+        for (auto& shard : shards_) {
+            shard.layers = Layers{ std::make_shared<CoinsMap>() };
+            shard.muhash = MuHash3072();
+        }
+        usage_ = 0;
+        count_ = stats.coinCount;
+        totalAmount_ = stats.totalAmount;
+        rebuildFilters();
+        return;
+    }
+    // Without a backend every unspent entry is a FRESH coin, so all of them are new to it;
+    // the shard hashes and totals already cover exactly those coins
+    size_t cached = 0;
+    for (auto& shard : shards_) {
+        forEachEntry(shard.layers, [&cached](const OutPoint&, uint8_t, bool spent, const Coin&) {
+            if (!spent) ++cached;
+            return true;
+        });
+    }
+    count_ = stats.coinCount + cached;
+    totalAmount_ += stats.totalAmount;
+    rebuildFilters();
+}
+
+void UTXOSet::rebuildFilters() {
+    size_t perShard = std::max<size_t>(MIN_FILTER_CAPACITY, count_ * 2 / NUM_SHARDS);
+    for (auto& shard : shards_) {
+        shard.filter = CuckooFilter(perShard);
+        shard.filterValid = true;
+    }
+    bool full = false;
+    auto add = [&](uint64_t hash) {
+        Shard& shard = shardFor(hash);
+        if (!shard.filter.insert(hash)) {
+            shard.filterValid = false;
+            full = true;
+        }
+    };
+    for (const auto& shard : shards_) {
+        forEachEntry(shard.layers, [&](const OutPoint& out, uint8_t, bool spent, const Coin&) {
+            if (!spent) add(hashOutPoint(out));
+            return true;
+        });
+    }
+    // Backend coins the cache holds (changed or spent) were decided above
+    base_->forEach([&](const OutPoint& out, const Coin&) {
+        uint64_t hash = hashOutPoint(out);
+        const Layers& layers = shardFor(hash).layers;
+        if (!heldBelow(layers, layers.size(), out, hash)) add(hash);
+        return true;
+    });
+    filtersFull_ = full;
+}
+
+void UTXOSet::putLocked(Shard& shard, const OutPoint& out, uint64_t hash, Coin coin, bool possibleOverwrite) {
+    CacheEntry e = lookup(shard, out, hash, possibleOverwrite);
+    bool existed = e.found && !e.spent;
+    if (existed) {
+        std::vector<uint8_t> data = coinHashData(out, e.coin);
+        shard.muhash.remove(data.data(), data.size());
+        totalAmount_ -= e.coin.amount;
+    }
+    // FRESH only if the backend cannot hold this outpoint: no backend, a plain cache miss,
+    // or an entry that was itself still FRESH. Spent tombstones must stay non-FRESH so the
+    // pending delete is not lost.
+    uint8_t flags = DIRTY;
+    if (!base_ || !e.found || (e.flags & FRESH)) flags |= FRESH;
+    std::vector<uint8_t> data = coinHashData(out, coin);
+    shard.muhash.insert(data.data(), data.size());
+    totalAmount_ += coin.amount;
+    if (!existed && shard.filterValid && !shard.filter.insert(hash)) {
+        shard.filterValid = false;
+        filtersFull_ = true;
+    }
+    size_t before = memoryUsage(shard);
+    writable(shard).put(out, hash, coin, flags);
+    accountUsage(shard, before);
+    if (!existed) ++count_;
+}
+
+bool UTXOSet::spendLocked(Shard& shard, const OutPoint& out, uint64_t hash) {
+    CacheEntry e = lookup(shard, out, hash, true);
+    if (!e.found || e.spent) return false;
+    --count_;
+    std::vector<uint8_t> data = coinHashData(out, e.coin);
+    shard.muhash.remove(data.data(), data.size());
+    totalAmount_ -= e.coin.amount;
+    if (shard.filterValid) shard.filter.erase(hash);
+    size_t before = memoryUsage(shard);
+    CoinsMap& top = writable(shard);
+    // A coin the backend never saw is simply dropped, unless an older layer still holds it
+    if ((e.flags & FRESH) && !heldBelow(shard.layers, shard.layers.size() - 1, out, hash)) {
+        top.erase(out, hash);
+    } else {
+        size_t slot = top.find(out, hash);
+        if (slot == CoinsMap::npos) slot = top.put(out, hash, Coin(), e.flags);
+        top.markSpent(slot, e.flags | DIRTY);
+    }
+    accountUsage(shard, before);
+    return true;
+}
+
+void UTXOSet::put(const OutPoint& out, uint64_t amount, Script script_pubkey, bool possibleOverwrite) {
+    uint64_t hash = hashOutPoint(out);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    putLocked(shard, out, hash, Coin{ amount, std::move(script_pubkey) }, possibleOverwrite);
 }
 
 std::optional<UTXOSet::Entry> UTXOSet::get(const OutPoint& out) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = map_.find(out);
-    if (it == map_.end()) return std::nullopt;
-    return it->second;
+    uint64_t hash = hashOutPoint(out);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    CacheEntry e = lookup(shard, out, hash, true);
+    if (!e.found || e.spent) return std::nullopt;
+    return std::move(e.coin);
 }
 
 bool UTXOSet::spend(const OutPoint& out) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return map_.erase(out) > 0;
+    uint64_t hash = hashOutPoint(out);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return spendLocked(shard, out, hash);
 }
 
 bool UTXOSet::has(const OutPoint& out) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return map_.find(out) != map_.end();
+    return get(out).has_value();
 }
 
-UTXOSet::Map UTXOSet::snapshot() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return map_;
+void UTXOSet::forEach(const CoinsView::Visitor& fn) const {
+    std::array<Layers, NUM_SHARDS> views;
+    CoinsView* base = nullptr;
+    {
+        AllShardsLock lock(*this);
+        for (size_t i = 0; i < NUM_SHARDS; ++i) views[i] = shards_[i].layers;
+        base = base_;
+        ++openViews_;
+    }
+    struct ViewGuard {
+        const UTXOSet& set;
+        ~ViewGuard() {
+            std::lock_guard<std::mutex> lock(set.viewMutex_);
+            if (--set.openViews_ == 0) set.viewsClosed_.notify_all();
+        }
+    } guard{ *this };
+
+    for (const auto& layers : views) {
+        bool more = forEachEntry(layers, [&fn](const OutPoint& out, uint8_t, bool spent, const Coin& coin) {
+            return spent || fn(out, coin);
+        });
+        if (!more) return;
+    }
+    if (!base) return;
+    // Backend coins the cache also holds (changed or spent) were already decided above
+    base->forEach([&](const OutPoint& out, const Coin& coin) {
+        uint64_t hash = hashOutPoint(out);
+        const Layers& layers = views[hash >> (64 - SHARD_BITS)];
+        if (heldBelow(layers, layers.size(), out, hash)) return true;
+        return fn(out, coin);
+    });
 }
 
 size_t UTXOSet::size() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return map_.size();
+    return count_;
+}
+
+CoinsStats UTXOSet::statsLocked() const {
+    CoinsStats stats;
+    stats.coinCount = count_;
+    stats.totalAmount = totalAmount_;
+    stats.muhash = flushedHash_;
+    for (const auto& shard : shards_) stats.muhash *= shard.muhash;
+    return stats;
+}
+
+CoinsStats UTXOSet::stats() const {
+    AllShardsLock lock(*this);
+    return statsLocked();
 }
 
 void UTXOSet::clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    map_.clear();
+    AllShardsLock lock(*this);
+    for (auto& shard : shards_) {
+        shard.layers = Layers{ std::make_shared<CoinsMap>() };
+        shard.muhash = MuHash3072();
+        shard.filter = CuckooFilter(base_ ? MIN_FILTER_CAPACITY : 0);
+        shard.filterValid = base_ != nullptr;
+    }
+    flushedHash_ = MuHash3072();
+    usage_ = 0;
+    count_ = 0;
+    totalAmount_ = 0;
+    filtersFull_ = false;
+    if (base_) base_->clear();
+}
+
+bool UTXOSet::needsFlush() const {
+    return base_ && usage_ > maxCacheBytes_ && openViews_ == 0;
+}
+
+bool UTXOSet::flush(const uint256& bestBlock) {
+    for (;;) {
+        {
+            // Views open under all shard locks, so none can start while these are held
+            AllShardsLock lock(*this);
+            if (!base_) return true;
+            if (openViews_ == 0) return flushLocked(bestBlock);
+        }
+        std::unique_lock<std::mutex> lock(viewMutex_);
+        viewsClosed_.wait(lock, [this] { return openViews_ == 0; });
+    }
+}
+
+bool UTXOSet::flushLocked(const uint256& bestBlock) {
+    std::vector<CoinsView::Change> changes;
+    for (const auto& shard : shards_) {
+        forEachEntry(shard.layers, [&changes](const OutPoint& out, uint8_t flags, bool spent, const Coin& coin) {
+            if (!(flags & DIRTY)) return true;
+            // A spent FRESH marker only shadows an older layer; the backend never had the coin
+            if (spent && (flags & FRESH)) return true;
+            if (spent) changes.push_back({ out, std::nullopt });
+            else changes.push_back({ out, coin });
+            return true;
+        });
+    }
+    CoinsStats stats = statsLocked();
+    if (!base_->batchWrite(changes, bestBlock, stats)) return false;
+    flushedHash_ = std::move(stats.muhash);
+    for (auto& shard : shards_) {
+        shard.layers = Layers{ std::make_shared<CoinsMap>() };
+        shard.muhash = MuHash3072();
+    }
+    usage_ = 0;
+    if (filtersFull_) rebuildFilters();
+    return true;
+}
+
+std::optional<Coin> UTXOBatch::get(const OutPoint& out) const {
+    auto it = changes_.find(out);
+    if (it != changes_.end()) return it->second.coin;
+    return base_.get(out);
+}
+
+bool UTXOBatch::spend(const OutPoint& out, Coin* spent) {
+    auto it = changes_.find(out);
+    if (it != changes_.end()) {
+        if (!it->second.coin) return false;
+        if (spent) *spent = std::move(*it->second.coin);
+        // Created and spent within the batch: nothing to apply unless it shadows a set coin
+        if (it->second.inBase) it->second.coin.reset();
+        else changes_.erase(it);
+        return true;
+    }
+    std::optional<Coin> coin = base_.get(out);
+    if (!coin) return false;
+    if (spent) *spent = std::move(*coin);
+    changes_[out] = Staged{ std::nullopt, true };
+    return true;
+}
+
+void UTXOBatch::put(const OutPoint& out, uint64_t amount, Script script_pubkey, bool possibleOverwrite) {
+    auto it = changes_.find(out);
+    if (it != changes_.end()) {
+        it->second.coin = Coin{ amount, std::move(script_pubkey) };
+        return;
+    }
+    bool inBase = possibleOverwrite && base_.has(out);
+    changes_[out] = Staged{ Coin{ amount, std::move(script_pubkey) }, inBase };
+}
+
+bool UTXOBatch::commit() {
+    bool ok = true;
+    {
+        UTXOSet::AllShardsLock lock(base_);
+        for (auto& kv : changes_) {
+            uint64_t hash = base_.hashOutPoint(kv.first);
+            UTXOSet::Shard& shard = base_.shardFor(hash);
+            if (kv.second.coin) base_.putLocked(shard, kv.first, hash, std::move(*kv.second.coin), kv.second.inBase);
+            else if (!base_.spendLocked(shard, kv.first, hash)) ok = false;
+        }
+    }
+    changes_.clear();
+    return ok;
+}
+
+size_t UTXOSet::cacheUsage() const {
+    return usage_;
+}
+
+size_t UTXOSet::filterUsage() const {
+    AllShardsLock lock(*this);
+    size_t n = 0;
+    for (const auto& shard : shards_) n += shard.filter.memoryUsage();
+    return n;
+}
+
+size_t UTXOSet::cacheEntries() const {
+    AllShardsLock lock(*this);
+    size_t n = 0;
+    for (const auto& shard : shards_) {
+        forEachEntry(shard.layers, [&n](const OutPoint&, uint8_t, bool, const Coin&) {
+            ++n;
+            return true;
+        });
+    }
+    return n;
 }
 
 } // namespace shawncoin
@@ -2,32 +2,209 @@
 #define SHAWNCOIN_CORE_UTXO_HPP
 
 #include "core/types.hpp"
+#include "core/coinsmap.hpp"
+#include "core/cuckoofilter.hpp"
+#include "crypto/muhash.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <vector>
 
 namespace shawncoin {
 
-/** UTXO set: outpoint -> (amount, script_pubkey). Thread-safe. */
-class UTXOSet {
+/** Totals over a coin set. muhash commits to every (outpoint, coin) pair, so two sets are
+ *  identical exactly when their digests match. */
+struct CoinsStats {
+    uint64_t coinCount = 0;
+    uint64_t totalAmount = 0;
+    MuHash3072 muhash;
+};
+
+/** MuHash element for one coin: txid || index || amount || script length || script. */
+std::vector<uint8_t> coinHashData(const OutPoint& out, const Coin& coin);
+
+/** Backing store for the UTXO cache (e.g. CoinsDB on top of Database). */
+class CoinsView {
 public:
-    struct Entry {
-        uint64_t amount = 0;
-        Script script_pubkey;
+    /** One flushed cache entry; coin is empty when the outpoint was spent. */
+    struct Change {
+        OutPoint outpoint;
+        std::optional<Coin> coin;
     };
-    using Map = std::map<OutPoint, Entry>;
+    using Visitor = std::function<bool(const OutPoint&, const Coin&)>;
+
+    virtual ~CoinsView() = default;
+    virtual std::optional<Coin> getCoin(const OutPoint& out) const = 0;
+    /** Apply changes and record the block and totals they bring the set up to, as one atomic write. */
+    virtual bool batchWrite(const std::vector<Change>& changes, const uint256& bestBlock, const CoinsStats& stats) = 0;
+    virtual uint256 getBestBlock() const = 0;
+    virtual CoinsStats getStats() const = 0;
+    /** Visit coins in outpoint order; stops early when fn returns false. */
+    virtual void forEach(const Visitor& fn) const = 0;
+    /** Remove every coin and the best block marker. */
+    virtual bool clear() = 0;
+};
+
+/** UTXO set: outpoint -> (amount, script_pubkey). Thread-safe.
+ *  Without a backend this is the whole set in memory. With one it is a write-back cache:
+ *  entries are DIRTY when they differ from the backend and FRESH when the backend has never
+ *  seen them, so a coin created and spent between flushes is never written at all.
+ *  The cache is split into shards by salted outpoint hash, each with its own lock, so
+ *  lookups from different threads rarely contend; whole-set operations lock every shard.
+ *  With a backend, each shard also keeps a cuckoo filter of every live outpoint (cached or
+ *  not), so lookups of outpoints that are not coins are answered without a backend read.
+ *  A shard's cache is a stack of layers; while a view shares the top one, writers push a
+ *  new layer holding just the entries they change, and layers fold back down once no view
+ *  holds them. */
+class UTXOSet {
+    friend class UTXOBatch;
 
-    void put(const OutPoint& out, uint64_t amount, Script script_pubkey);
+public:
+    using Entry = Coin;
+
+    UTXOSet();
+
+    /** Attach a backend with a cache budget in bytes. When keepCache is set the cached coins
+     *  are treated as new to the backend and written on the next flush; otherwise the cache
+     *  is dropped and the backend is taken as the current state. */
+    void setBackend(CoinsView* base, size_t maxCacheBytes, bool keepCache);
+
+    /** Add a coin. possibleOverwrite marks outputs whose outpoint may already exist
+     *  (coinbases, whose txid is not guaranteed unique by consensus). */
+    void put(const OutPoint& out, uint64_t amount, Script script_pubkey, bool possibleOverwrite = false);
     std::optional<Entry> get(const OutPoint& out) const;
     bool spend(const OutPoint& out);
     bool has(const OutPoint& out) const;
-    Map snapshot() const;
+    /** Visit every unspent coin as of the call, in no particular order; stops early when fn
+     *  returns false. The view is taken by sharing each shard's layers (writers then put their
+     *  changes in a new layer on top) and flushes are deferred while it is open, so the scan
+     *  copies nothing and never holds a lock that block connection needs. */
+    void forEach(const CoinsView::Visitor& fn) const;
+    /** Number of unspent coins (backend and cache combined). */
     size_t size() const;
+    /** Count, total amount and MuHash of the whole set. The hash is maintained per shard as
+     *  coins are added and spent, so this costs a few multiplications, not a scan. */
+    CoinsStats stats() const;
     void clear();
 
+    /** True when the cache has outgrown its memory budget and no view is open. */
+    bool needsFlush() const;
+    /** Write all dirty entries to the backend in one batch and empty the cache. Open views
+     *  still read the backend, so this waits for them to close first. */
+    bool flush(const uint256& bestBlock);
+    /** Approximate heap bytes held by the cache (not counting the lookup filters). */
+    size_t cacheUsage() const;
+    /** Heap bytes held by the negative-lookup filters. */
+    size_t filterUsage() const;
+    size_t cacheEntries() const;
+
 private:
-    mutable std::mutex mutex_;
-    Map map_;
+    enum : uint8_t { DIRTY = 1, FRESH = 2 };
+    static constexpr size_t SHARD_BITS = 5;
+    static constexpr size_t NUM_SHARDS = size_t(1) << SHARD_BITS;
+    static constexpr size_t MIN_FILTER_CAPACITY = 1024; // per shard
+
+    /** Cache layers of one shard, oldest first; an entry in a higher layer shadows the same
+     *  outpoint below it. Only the top layer is ever written, and only while no view shares it. */
+    using Layers = std::vector<std::shared_ptr<CoinsMap>>;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        Layers layers{ std::make_shared<CoinsMap>() }; // shared with open views
+        MuHash3072 muhash; // coins added and spent in this shard since the last flush
+        CuckooFilter filter;
+        bool filterValid = false; // filter holds every live outpoint of the shard
+    };
+    /** Locks every shard in index order (the only multi-shard lock order used). */
+    class AllShardsLock {
+    public:
+        explicit AllShardsLock(const UTXOSet& set);
+        ~AllShardsLock();
+    private:
+        const UTXOSet& set_;
+    };
+
+    uint64_t hashOutPoint(const OutPoint& out) const;
+    Shard& shardFor(uint64_t hash) const { return shards_[hash >> (64 - SHARD_BITS)]; }
+    /** Newest cache entry for an outpoint; coin is empty when spent or not found. */
+    struct CacheEntry {
+        bool found = false;
+        bool spent = false;
+        uint8_t flags = 0;
+        Coin coin;
+    };
+
+    /** Cache entry for out (requires shard lock). With fromBackend a miss is read from the
+     *  backend, and the clean copy is cached unless an open view shares the top layer. */
+    CacheEntry lookup(Shard& shard, const OutPoint& out, uint64_t hash, bool fromBackend) const;
+    /** put/spend with the shard lock already held. */
+    void putLocked(Shard& shard, const OutPoint& out, uint64_t hash, Coin coin, bool possibleOverwrite);
+    bool spendLocked(Shard& shard, const OutPoint& out, uint64_t hash);
+    /** The shard's top layer for writing. Layers no view holds any more are folded down
+     *  first; if a view still shares the top, an empty layer is pushed above it. */
+    CoinsMap& writable(Shard& shard) const;
+    /** Move every entry of the top layer into the one below it and drop it. */
+    void mergeTop(Shard& shard) const;
+    /** True when a layer below index `below` holds out. */
+    static bool heldBelow(const Layers& layers, size_t below, const OutPoint& out, uint64_t hash);
+    /** Visit the newest entry of every cached outpoint as fn(out, flags, spent, coin);
+     *  stops early and returns false when fn returns false. */
+    template <typename Fn>
+    bool forEachEntry(const Layers& layers, Fn&& fn) const;
+    static size_t memoryUsage(const Shard& shard);
+    /** Apply the change in shard memory since before to the global total. */
+    void accountUsage(const Shard& shard, size_t before) const;
+    /** flush() with every shard lock held and no view open. */
+    bool flushLocked(const uint256& bestBlock);
+    /** Totals with every shard lock held. */
+    CoinsStats statsLocked() const;
+    /** Refill every shard's filter from the cache and the backend, sized for twice the current
+     *  coin count (requires all shard locks and a backend). */
+    void rebuildFilters();
+
+    mutable std::array<Shard, NUM_SHARDS> shards_;
+    std::array<uint64_t, 2> salt_;
+    mutable std::atomic<size_t> usage_{0};
+    std::atomic<size_t> count_{0};
+    std::atomic<uint64_t> totalAmount_{0};
+    MuHash3072 flushedHash_; // hash of the backend's coins; changed with all shards locked
+    std::atomic<bool> filtersFull_{false}; // a shard filter overflowed; rebuilt on the next flush
+    mutable std::atomic<int> openViews_{0};
+    mutable std::mutex viewMutex_;                  // guards the last view closing
+    mutable std::condition_variable viewsClosed_;   // signalled when openViews_ drops to 0
+    CoinsView* base_ = nullptr; // changed only with all shards locked
+    size_t maxCacheBytes_ = 0;
+};
+
+/** Block-scoped overlay over a UTXOSet. Spends and creates are staged (a coin created and
+ *  spent inside the batch never reaches the set), reads see the staged state first, and
+ *  commit applies everything in one pass with every shard locked, so readers observe the
+ *  block all or nothing. Dropping the batch without commit has no effect. */
+class UTXOBatch {
+public:
+    explicit UTXOBatch(UTXOSet& base) : base_(base) {}
+
+    std::optional<Coin> get(const OutPoint& out) const;
+    /** Stage a spend; the coin is moved into spent when given. False if it does not exist. */
+    bool spend(const OutPoint& out, Coin* spent = nullptr);
+    void put(const OutPoint& out, uint64_t amount, Script script_pubkey, bool possibleOverwrite = false);
+    /** Apply staged changes to the set. False only if a staged spend no longer found its coin. */
+    bool commit();
+
+private:
+    struct Staged {
+        std::optional<Coin> coin; // empty: spend the set's coin
+        bool inBase = false;      // the set holds this outpoint unspent
+    };
+
+    UTXOSet& base_;
+    std::map<OutPoint, Staged> changes_;
 };
 
 } // namespace shawncoin
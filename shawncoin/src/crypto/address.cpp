@@ -48,6 +48,8 @@ std::vector<uint8_t> decodeBase58(const std::string& s) {
             carry >>= 8;
         }
     }
+    // result holds the number least significant byte first
+    std::reverse(result.begin(), result.end());
     for (size_t i = 0; i < s.size() && s[i] == '1'; ++i)
         result.insert(result.begin(), 0);
     return result;
@@ -0,0 +1,95 @@
+#include "crypto/context.h"
+#include "crypto/secure_random.h"
+#include <openssl/crypto.h>
+#include <openssl/obj_mac.h>
+#include <stdlib.h>
+
+#if defined(HAVE_SECP256K1)
+static CRYPTO_ONCE secp_once = CRYPTO_ONCE_STATIC_INIT;
+static secp256k1_context *secp_ctx = NULL;
+
+static void secp_init(void) {
+    unsigned char seed[32];
+    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (!ctx) return;
+    /* Blinds signing and key generation; without a seed the context still works, unblinded */
+    if (shawncoin_secure_rand(seed, sizeof(seed)) == 1)
+        (void)secp256k1_context_randomize(ctx, seed);
+    shawncoin_memwipe(seed, sizeof(seed));
+    secp_ctx = ctx;
+}
+
+const secp256k1_context *shawncoin_secp256k1_context(void) {
+    if (!CRYPTO_THREAD_run_once(&secp_once, secp_init)) return NULL;
+    return secp_ctx;
+}
+#endif
+
+static CRYPTO_ONCE group_once = CRYPTO_ONCE_STATIC_INIT;
+
+typedef struct {
+    EC_KEY *key;
+    EC_POINT *point;
+} verify_scratch;
+
+static EC_GROUP *ec_group = NULL;
+static CRYPTO_THREAD_LOCAL scratch_local;
+static int scratch_local_ok = 0;
+
+static void scratch_free(void *p) {
+    verify_scratch *s = (verify_scratch *)p;
+    if (!s) return;
+    EC_POINT_free(s->point);
+    EC_KEY_free(s->key);
+    free(s);
+}
+
+static void group_init(void) {
+    EC_GROUP *grp = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    if (!grp) return;
+    /* Without the table verification is correct, only slower */
+    (void)EC_GROUP_precompute_mult(grp, NULL);
+    ec_group = grp;
+    scratch_local_ok = CRYPTO_THREAD_init_local(&scratch_local, scratch_free);
+}
+
+const EC_GROUP *shawncoin_ec_group(void) {
+    if (!CRYPTO_THREAD_run_once(&group_once, group_init)) return NULL;
+    return ec_group;
+}
+
+EC_KEY *shawncoin_ec_key_new(void) {
+    const EC_GROUP *grp = shawncoin_ec_group();
+    if (!grp) return NULL;
+    EC_KEY *key = EC_KEY_new();
+    if (!key || EC_KEY_set_group(key, grp) != 1) {
+        EC_KEY_free(key);
+        return NULL;
+    }
+    return key;
+}
+
+static verify_scratch *scratch_get(void) {
+    if (!shawncoin_ec_group() || !scratch_local_ok) return NULL;
+    verify_scratch *s = (verify_scratch *)CRYPTO_THREAD_get_local(&scratch_local);
+    if (s) return s;
+    s = (verify_scratch *)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->key = shawncoin_ec_key_new();
+    s->point = s->key ? EC_POINT_new(EC_KEY_get0_group(s->key)) : NULL;
+    if (!s->point || !CRYPTO_THREAD_set_local(&scratch_local, s)) {
+        scratch_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+EC_KEY *shawncoin_ec_verify_key(void) {
+    verify_scratch *s = scratch_get();
+    return s ? s->key : NULL;
+}
+
+EC_POINT *shawncoin_ec_verify_point(void) {
+    verify_scratch *s = scratch_get();
+    return s ? s->point : NULL;
+}
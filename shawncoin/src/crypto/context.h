@@ -0,0 +1,37 @@
+#ifndef SHAWNCOIN_CRYPTO_CONTEXT_H
+#define SHAWNCOIN_CRYPTO_CONTEXT_H
+
+/* Curve state shared by keys.c and signatures.c (internal to the crypto library). Building it
+ * is far more expensive than one signature check, so it is built once, on first use. */
+
+#if defined(HAVE_SECP256K1)
+#include <secp256k1.h>
+#endif
+#include <openssl/ec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(HAVE_SECP256K1)
+/* Process-wide signing and verification context with its precomputed tables, randomized once
+ * against side channels. Read-only afterwards, so any thread may use it. NULL on failure. */
+const secp256k1_context *shawncoin_secp256k1_context(void);
+#endif
+
+/* OpenSSL secp256k1 group with precomputed multiples of the generator; shared, read-only.
+ * Used for ECDSA without libsecp256k1, and for Schnorr signatures in either build. */
+const EC_GROUP *shawncoin_ec_group(void);
+
+/* New key on the shared group (its tables are shared, not copied). NULL on failure. */
+EC_KEY *shawncoin_ec_key_new(void);
+
+/* Scratch key and point for verifying on the calling thread, kept until the thread exits. */
+EC_KEY *shawncoin_ec_verify_key(void);
+EC_POINT *shawncoin_ec_verify_point(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHAWNCOIN_CRYPTO_CONTEXT_H */
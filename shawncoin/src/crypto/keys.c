@@ -1,4 +1,5 @@
 #include "crypto/keys.h"
+#include "crypto/context.h"
 #include "crypto/secure_random.h"
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,6 @@
 
 struct shawncoin_keypair {
 #if defined(HAVE_SECP256K1)
-    secp256k1_context *ctx;
     unsigned char seckey[32];
 #else
     void *ec_key; /* EC_KEY* */
@@ -22,11 +22,10 @@ struct shawncoin_keypair {
 
 #if defined(HAVE_SECP256K1)
 shawncoin_keypair_t *shawncoin_keypair_create(void) {
-    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    const secp256k1_context *ctx = shawncoin_secp256k1_context();
     if (!ctx) return NULL;
     shawncoin_keypair_t *kp = (shawncoin_keypair_t *)malloc(sizeof(shawncoin_keypair_t));
-    if (!kp) { secp256k1_context_destroy(ctx); return NULL; }
-    kp->ctx = ctx;
+    if (!kp) return NULL;
     for (;;) {
         if (shawncoin_secure_rand(kp->seckey, 32) != 1) { shawncoin_keypair_destroy(kp); return NULL; }
         if (secp256k1_ec_seckey_verify(ctx, kp->seckey) == 1)
@@ -36,7 +35,7 @@ shawncoin_keypair_t *shawncoin_keypair_create(void) {
 }
 #else
 static EC_KEY *ec_key_new(void) {
-    EC_KEY *key = EC_KEY_new_by_curve_name(NID_secp256k1);
+    EC_KEY *key = shawncoin_ec_key_new();
     if (!key) return NULL;
     if (EC_KEY_generate_key(key) != 1) { EC_KEY_free(key); return NULL; }
     return key;
@@ -55,19 +54,17 @@ shawncoin_keypair_t *shawncoin_keypair_create(void) {
 #if defined(HAVE_SECP256K1)
 shawncoin_keypair_t *shawncoin_keypair_from_priv(const unsigned char *priv32) {
     if (!priv32) return NULL;
-    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
-    if (!ctx) return NULL;
-    if (secp256k1_ec_seckey_verify(ctx, priv32) != 1) { secp256k1_context_destroy(ctx); return NULL; }
+    const secp256k1_context *ctx = shawncoin_secp256k1_context();
+    if (!ctx || secp256k1_ec_seckey_verify(ctx, priv32) != 1) return NULL;
     shawncoin_keypair_t *kp = (shawncoin_keypair_t *)malloc(sizeof(shawncoin_keypair_t));
-    if (!kp) { secp256k1_context_destroy(ctx); return NULL; }
-    kp->ctx = ctx;
+    if (!kp) return NULL;
     memcpy(kp->seckey, priv32, 32);
     return kp;
 }
 #else
 shawncoin_keypair_t *shawncoin_keypair_from_priv(const unsigned char *priv32) {
     if (!priv32) return NULL;
-    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+    EC_KEY *ec = shawncoin_ec_key_new();
     if (!ec) return NULL;
     BIGNUM *bn = BN_bin2bn(priv32, 32, NULL);
     if (!bn) { EC_KEY_free(ec); return NULL; }
@@ -92,11 +89,12 @@ shawncoin_keypair_t *shawncoin_keypair_from_priv(const unsigned char *priv32) {
 
 #if defined(HAVE_SECP256K1)
 int shawncoin_pubkey_get(const shawncoin_keypair_t *key, unsigned char *out33) {
-    if (!key || !out33) return 0;
+    const secp256k1_context *ctx = shawncoin_secp256k1_context();
+    if (!key || !out33 || !ctx) return 0;
     secp256k1_pubkey pubkey;
-    if (secp256k1_ec_pubkey_create(key->ctx, &pubkey, key->seckey) != 1) return 0;
+    if (secp256k1_ec_pubkey_create(ctx, &pubkey, key->seckey) != 1) return 0;
     size_t len = 33;
-    return secp256k1_ec_pubkey_serialize(key->ctx, out33, &len, &pubkey, SECP256K1_EC_COMPRESSED) == 1 ? 1 : 0;
+    return secp256k1_ec_pubkey_serialize(ctx, out33, &len, &pubkey, SECP256K1_EC_COMPRESSED) == 1 ? 1 : 0;
 }
 #else
 int shawncoin_pubkey_get(const shawncoin_keypair_t *key, unsigned char *out33) {
@@ -139,7 +137,6 @@ void *shawncoin_keypair_get_ec_key(const shawncoin_keypair_t *key) {
 #if defined(HAVE_SECP256K1)
 void shawncoin_keypair_destroy(shawncoin_keypair_t *key) {
     if (key) {
-        if (key->ctx) secp256k1_context_destroy(key->ctx);
         shawncoin_memwipe(key->seckey, 32);
         memset(key, 0, sizeof(*key));
         free(key);
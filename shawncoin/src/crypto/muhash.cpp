@@ -0,0 +1,172 @@
+#include "crypto/muhash.hpp"
+#include "crypto/hash.h"
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <cstring>
+
+namespace shawncoin {
+
+namespace {
+
+const BIGNUM* modulus() {
+    static const BIGNUM* p = [] {
+        BIGNUM* n = BN_new();
+        BN_lshift(n, BN_value_one(), 3072);
+        BN_sub_word(n, 1103717);
+        return n;
+    }();
+    return p;
+}
+
+/** Scratch space for BN arithmetic; one per thread since BN_CTX is not thread-safe. */
+BN_CTX* scratch() {
+    struct Holder {
+        BN_CTX* ctx = BN_CTX_new();
+        ~Holder() { BN_CTX_free(ctx); }
+    };
+    thread_local Holder holder;
+    return holder.ctx;
+}
+
+/** Montgomery multiplication is about three times faster than BN_mod_mul at this size. Each
+ *  product carries an extra factor R^-1 (R = 2^3072, which is 1103717 mod p); rather than
+ *  converting operands, accumulators count those factors and cancel them once, on output. */
+const BN_MONT_CTX* montgomery() {
+    static const BN_MONT_CTX* mont = [] {
+        BN_MONT_CTX* m = BN_MONT_CTX_new();
+        BN_CTX* ctx = BN_CTX_new();
+        BN_MONT_CTX_set(m, modulus(), ctx);
+        BN_CTX_free(ctx);
+        return m;
+    }();
+    return mont;
+}
+
+void montMul(BIGNUM* r, const BIGNUM* a, const BIGNUM* b) {
+    BN_mod_mul_montgomery(r, a, b, const_cast<BN_MONT_CTX*>(montgomery()), scratch());
+}
+
+/** Map data to a member of the group: ChaCha20 keystream keyed by SHA-256(data), zero nonce. */
+BIGNUM* toElement(const uint8_t* data, size_t len) {
+    unsigned char key[32];
+    shawncoin_sha256(data, len, key);
+    unsigned char iv[16] = {};
+    unsigned char zero[MuHash3072::BYTE_SIZE] = {};
+    unsigned char stream[MuHash3072::BYTE_SIZE];
+    int outLen = 0;
+    struct Cipher {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        ~Cipher() { EVP_CIPHER_CTX_free(ctx); }
+    };
+    thread_local Cipher cipher;
+    EVP_EncryptInit_ex(cipher.ctx, EVP_chacha20(), nullptr, key, iv);
+    EVP_EncryptUpdate(cipher.ctx, stream, &outLen, zero, sizeof(zero));
+    BIGNUM* x = BN_lebin2bn(stream, sizeof(stream), nullptr);
+    if (BN_cmp(x, modulus()) >= 0) BN_sub(x, x, modulus());
+    return x;
+}
+
+} // namespace
+
+struct MuHash3072::Num {
+    BIGNUM* numerator = BN_new();
+    BIGNUM* denominator = BN_new();
+    int64_t rPower = 0; // the set is numerator / denominator * R^rPower
+
+    Num() {
+        BN_one(numerator);
+        BN_one(denominator);
+    }
+    Num(const Num& other)
+        : numerator(BN_dup(other.numerator)), denominator(BN_dup(other.denominator)), rPower(other.rPower) {}
+    ~Num() {
+        BN_free(numerator);
+        BN_free(denominator);
+    }
+    /** The set as one residue. */
+    BIGNUM* normalized() const {
+        BN_CTX* ctx = scratch();
+        BIGNUM* r = BN_new();
+        BIGNUM* inv = BN_mod_inverse(nullptr, denominator, modulus(), ctx);
+        BN_mod_mul(r, numerator, inv, modulus(), ctx);
+        BN_free(inv);
+        if (rPower != 0) {
+            BIGNUM* base = BN_new();
+            BIGNUM* exp = BN_new();
+            BN_set_word(base, 1103717);
+            if (rPower < 0) BN_mod_inverse(base, base, modulus(), ctx);
+            BN_set_word(exp, (BN_ULONG)(rPower < 0 ? -rPower : rPower));
+            BN_mod_exp(base, base, exp, modulus(), ctx);
+            BN_mod_mul(r, r, base, modulus(), ctx);
+            BN_free(base);
+            BN_free(exp);
+        }
+        return r;
+    }
+};
+
+MuHash3072::MuHash3072() : num_(std::make_unique<Num>()) {}
+
+MuHash3072::MuHash3072(const MuHash3072& other) : num_(std::make_unique<Num>(*other.num_)) {}
+
+MuHash3072& MuHash3072::operator=(const MuHash3072& other) {
+    if (this != &other) num_ = std::make_unique<Num>(*other.num_);
+    return *this;
+}
+
+MuHash3072::MuHash3072(MuHash3072&&) noexcept = default;
+MuHash3072& MuHash3072::operator=(MuHash3072&&) noexcept = default;
+MuHash3072::~MuHash3072() = default;
+
+void MuHash3072::insert(const uint8_t* data, size_t len) {
+    BIGNUM* x = toElement(data, len);
+    montMul(num_->numerator, num_->numerator, x);
+    ++num_->rPower;
+    BN_free(x);
+}
+
+void MuHash3072::remove(const uint8_t* data, size_t len) {
+    BIGNUM* x = toElement(data, len);
+    montMul(num_->denominator, num_->denominator, x);
+    --num_->rPower;
+    BN_free(x);
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other) {
+    // One R^-1 lands in each of numerator and denominator, so they cancel
+    montMul(num_->numerator, num_->numerator, other.num_->numerator);
+    montMul(num_->denominator, num_->denominator, other.num_->denominator);
+    num_->rPower += other.num_->rPower;
+    return *this;
+}
+
+uint256 MuHash3072::digest() const {
+    std::vector<uint8_t> bytes = serialize();
+    uint256 out;
+    shawncoin_sha256(bytes.data(), bytes.size(), out.data());
+    return out;
+}
+
+std::vector<uint8_t> MuHash3072::serialize() const {
+    BIGNUM* r = num_->normalized();
+    std::vector<uint8_t> out(BYTE_SIZE);
+    BN_bn2lebinpad(r, out.data(), (int)out.size());
+    BN_free(r);
+    return out;
+}
+
+bool MuHash3072::deserialize(const uint8_t* data, size_t len) {
+    if (len != BYTE_SIZE) return false;
+    BIGNUM* r = BN_lebin2bn(data, (int)len, nullptr);
+    if (!r || BN_cmp(r, modulus()) >= 0 || BN_is_zero(r)) {
+        BN_free(r);
+        return false;
+    }
+    BN_free(num_->numerator);
+    num_->numerator = r;
+    BN_one(num_->denominator);
+    num_->rPower = 0;
+    return true;
+}
+
+} // namespace shawncoin
@@ -0,0 +1,47 @@
+#ifndef SHAWNCOIN_CRYPTO_MUHASH_HPP
+#define SHAWNCOIN_CRYPTO_MUHASH_HPP
+
+#include "../core/types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace shawncoin {
+
+/** Rolling multiset hash over the group of integers modulo 2^3072 - 1103717 (MuHash3072).
+ *  Each element maps to a group member (SHA-256 of the data keys a ChaCha20 keystream of
+ *  384 bytes); the set is the product of its members. Insert and remove are one modular
+ *  multiplication each (removals accumulate in a separate denominator), order does not
+ *  matter, and two accumulators combine with operator*=, so partial sets can be hashed
+ *  independently and merged. */
+class MuHash3072 {
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+    MuHash3072();
+    MuHash3072(const MuHash3072& other);
+    MuHash3072& operator=(const MuHash3072& other);
+    MuHash3072(MuHash3072&&) noexcept;
+    MuHash3072& operator=(MuHash3072&&) noexcept;
+    ~MuHash3072();
+
+    void insert(const uint8_t* data, size_t len);
+    void remove(const uint8_t* data, size_t len);
+    /** Multiset union (and difference, for removals recorded in other). */
+    MuHash3072& operator*=(const MuHash3072& other);
+
+    /** 32-byte digest of the set; equal sets give equal digests however they were built. */
+    uint256 digest() const;
+    /** The set as a single 384-byte little-endian residue, for persisting. */
+    std::vector<uint8_t> serialize() const;
+    bool deserialize(const uint8_t* data, size_t len);
+
+private:
+    struct Num;
+    std::unique_ptr<Num> num_;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_CRYPTO_MUHASH_HPP
@@ -0,0 +1,207 @@
+#include "crypto/schnorr.h"
+#include "crypto/context.h"
+#include "crypto/hash.h"
+#include "crypto/secure_random.h"
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Field prime of secp256k1; x coordinates at or above it are invalid, not reduced. */
+static const unsigned char FIELD_P[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xfc, 0x2f
+};
+
+/* SHA256(SHA256(tag) || SHA256(tag) || msg), msg at most 96 bytes */
+static void tagged_hash(const char *tag, const unsigned char *msg, size_t len, unsigned char *out32) {
+    unsigned char buf[64 + 96];
+    shawncoin_sha256((const unsigned char *)tag, strlen(tag), buf);
+    memcpy(buf + 32, buf, 32);
+    memcpy(buf + 64, msg, len);
+    shawncoin_sha256(buf, 64 + len, out32);
+}
+
+/* Point with x coordinate x32 and even y; 0 if x32 is not the x of a curve point. */
+static int lift_x(const EC_GROUP *grp, const unsigned char *x32, EC_POINT *out, BN_CTX *ctx) {
+    if (memcmp(x32, FIELD_P, 32) >= 0) return 0;
+    BIGNUM *x = BN_bin2bn(x32, 32, NULL);
+    int ok = x && EC_POINT_set_compressed_coordinates(grp, out, x, 0, ctx) == 1;
+    BN_free(x);
+    return ok;
+}
+
+/* Writes the x coordinate of p to x32 (if not NULL); returns 1 if its y is even, 0 if odd, -1 on error. */
+static int even_y(const EC_GROUP *grp, const EC_POINT *p, unsigned char *x32, BN_CTX *ctx) {
+    BIGNUM *x = BN_new(), *y = BN_new();
+    int ret = -1;
+    if (x && y && EC_POINT_get_affine_coordinates(grp, p, x, y, ctx) == 1 &&
+        (!x32 || BN_bn2binpad(x, x32, 32) == 32))
+        ret = BN_is_odd(y) ? 0 : 1;
+    BN_free(x);
+    BN_free(y);
+    return ret;
+}
+
+/* e = H_challenge(r || px || m) mod n */
+static BIGNUM *challenge(const unsigned char *r32, const unsigned char *px32, const unsigned char *hash32,
+                         const BIGNUM *order, BN_CTX *ctx) {
+    unsigned char buf[96], e32[32];
+    memcpy(buf, r32, 32);
+    memcpy(buf + 32, px32, 32);
+    memcpy(buf + 64, hash32, 32);
+    tagged_hash("BIP0340/challenge", buf, sizeof(buf), e32);
+    BIGNUM *e = BN_bin2bn(e32, 32, NULL);
+    if (e && BN_nnmod(e, e, order, ctx) != 1) {
+        BN_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+int shawncoin_schnorr_sign(const shawncoin_keypair_t *key, const unsigned char *hash32, unsigned char *sig64) {
+    const EC_GROUP *grp = shawncoin_ec_group();
+    if (!grp || !key || !hash32 || !sig64) return 0;
+    const BIGNUM *order = EC_GROUP_get0_order(grp);
+    unsigned char seckey[32], px[32], rx[32], aux[32], t[32], buf[96], nonce[32];
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *d = NULL, *k = NULL, *e = NULL, *s = BN_new();
+    EC_POINT *P = EC_POINT_new(grp), *R = EC_POINT_new(grp);
+    int ok = 0, even;
+    size_t i;
+
+    if (!ctx || !s || !P || !R || shawncoin_privkey_get(key, seckey) != 1) goto done;
+    d = BN_bin2bn(seckey, 32, NULL);
+    if (!d || BN_is_zero(d) || BN_cmp(d, order) >= 0) goto done;
+    if (EC_POINT_mul(grp, P, d, NULL, NULL, ctx) != 1) goto done;
+    /* Keys are x-only: sign with whichever of d and n - d gives a point with even y */
+    if ((even = even_y(grp, P, px, ctx)) < 0) goto done;
+    if (!even && BN_sub(d, order, d) != 1) goto done;
+    if (BN_bn2binpad(d, seckey, 32) != 32) goto done;
+
+    if (shawncoin_secure_rand(aux, sizeof(aux)) != 1) goto done;
+    tagged_hash("BIP0340/aux", aux, sizeof(aux), t);
+    for (i = 0; i < 32; ++i) t[i] ^= seckey[i];
+    memcpy(buf, t, 32);
+    memcpy(buf + 32, px, 32);
+    memcpy(buf + 64, hash32, 32);
+    tagged_hash("BIP0340/nonce", buf, sizeof(buf), nonce);
+    k = BN_bin2bn(nonce, 32, NULL);
+    if (!k || BN_nnmod(k, k, order, ctx) != 1 || BN_is_zero(k)) goto done;
+    if (EC_POINT_mul(grp, R, k, NULL, NULL, ctx) != 1) goto done;
+    if ((even = even_y(grp, R, rx, ctx)) < 0) goto done;
+    if (!even && BN_sub(k, order, k) != 1) goto done;
+
+    /* s = k + e * d mod n */
+    if (!(e = challenge(rx, px, hash32, order, ctx))) goto done;
+    if (BN_mod_mul(s, e, d, order, ctx) != 1 || BN_mod_add(s, s, k, order, ctx) != 1) goto done;
+    memcpy(sig64, rx, 32);
+    ok = BN_bn2binpad(s, sig64 + 32, 32) == 32;
+
+done:
+    shawncoin_memwipe(seckey, sizeof(seckey));
+    shawncoin_memwipe(t, sizeof(t));
+    shawncoin_memwipe(buf, sizeof(buf));
+    shawncoin_memwipe(nonce, sizeof(nonce));
+    BN_clear_free(d);
+    BN_clear_free(k);
+    BN_free(e);
+    BN_free(s);
+    EC_POINT_free(P);
+    EC_POINT_free(R);
+    BN_CTX_free(ctx);
+    return ok;
+}
+
+int shawncoin_schnorr_verify(const unsigned char *pubkey33, const unsigned char *hash32, const unsigned char *sig64) {
+    const EC_GROUP *grp = shawncoin_ec_group();
+    if (!grp || !pubkey33 || !hash32 || !sig64) return 0;
+    const BIGNUM *order = EC_GROUP_get0_order(grp);
+    unsigned char rx[32];
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *s = BN_bin2bn(sig64 + 32, 32, NULL), *e = NULL;
+    EC_POINT *P = EC_POINT_new(grp), *R = EC_POINT_new(grp);
+    int ok = 0;
+
+    if (!ctx || !s || !P || !R) goto done;
+    if (memcmp(sig64, FIELD_P, 32) >= 0 || BN_cmp(s, order) >= 0) goto done;
+    if (!lift_x(grp, pubkey33 + 1, P, ctx)) goto done;
+    if (!(e = challenge(sig64, pubkey33 + 1, hash32, order, ctx))) goto done;
+    /* R = s*G - e*P must have even y and x equal to the signature's r */
+    if (!BN_is_zero(e) && BN_sub(e, order, e) != 1) goto done;
+    if (EC_POINT_mul(grp, R, s, P, e, ctx) != 1 || EC_POINT_is_at_infinity(grp, R)) goto done;
+    ok = even_y(grp, R, rx, ctx) == 1 && memcmp(rx, sig64, 32) == 0;
+
+done:
+    BN_free(s);
+    BN_free(e);
+    EC_POINT_free(P);
+    EC_POINT_free(R);
+    BN_CTX_free(ctx);
+    return ok;
+}
+
+int shawncoin_schnorr_verify_batch(const unsigned char *const *pubkeys33, const unsigned char *const *hashes32,
+                                   const unsigned char *const *sigs64, size_t count) {
+    if (count == 0) return 1;
+    if (!pubkeys33 || !hashes32 || !sigs64) return 0;
+    if (count == 1) return shawncoin_schnorr_verify(pubkeys33[0], hashes32[0], sigs64[0]);
+    const EC_GROUP *grp = shawncoin_ec_group();
+    if (!grp) return 0;
+    const BIGNUM *order = EC_GROUP_get0_order(grp);
+    /* Check (sum a_i s_i) G - sum a_i R_i - sum a_i e_i P_i = 0, with a_0 = 1 and the other
+     * a_i random, so that no combination of invalid signatures can be made to cancel */
+    size_t n = 2 * count, i;
+    EC_POINT **points = (EC_POINT **)calloc(n, sizeof(EC_POINT *));
+    BIGNUM **scalars = (BIGNUM **)calloc(n, sizeof(BIGNUM *));
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *sum = BN_new(), *a = BN_new(), *s = BN_new(), *e = NULL;
+    EC_POINT *acc = EC_POINT_new(grp);
+    unsigned char seed[40], a32[32];
+    int ok = 0;
+
+    if (!points || !scalars || !ctx || !sum || !a || !s || !acc) goto done;
+    memset(seed, 0, sizeof(seed));
+    if (shawncoin_secure_rand(seed, 32) != 1) goto done;
+    BN_zero(sum);
+    for (i = 0; i < count; ++i) {
+        const unsigned char *sig = sigs64[i];
+        EC_POINT *P = points[2 * i] = EC_POINT_new(grp);
+        EC_POINT *R = points[2 * i + 1] = EC_POINT_new(grp);
+        BIGNUM *ae = scalars[2 * i] = BN_new();
+        BIGNUM *negA = scalars[2 * i + 1] = BN_new();
+        if (!P || !R || !ae || !negA) goto done;
+        if (!lift_x(grp, pubkeys33[i] + 1, P, ctx) || !lift_x(grp, sig, R, ctx)) goto done;
+        if (!BN_bin2bn(sig + 32, 32, s) || BN_cmp(s, order) >= 0) goto done;
+        if (i == 0) {
+            BN_one(a);
+        } else {
+            memcpy(seed + 32, &i, sizeof(i) < 8 ? sizeof(i) : 8);
+            shawncoin_sha256(seed, sizeof(seed), a32);
+            if (!BN_bin2bn(a32, 32, a) || BN_nnmod(a, a, order, ctx) != 1) goto done;
+            if (BN_is_zero(a)) BN_one(a);
+        }
+        BN_free(e);
+        if (!(e = challenge(sig, pubkeys33[i] + 1, hashes32[i], order, ctx))) goto done;
+        if (BN_mod_mul(s, s, a, order, ctx) != 1 || BN_mod_add(sum, sum, s, order, ctx) != 1) goto done;
+        if (BN_mod_mul(ae, a, e, order, ctx) != 1 || BN_mod_sub(ae, order, ae, order, ctx) != 1) goto done;
+        if (BN_mod_sub(negA, order, a, order, ctx) != 1) goto done;
+    }
+    if (EC_POINTs_mul(grp, acc, sum, n, (const EC_POINT **)points, (const BIGNUM **)scalars, ctx) != 1) goto done;
+    ok = EC_POINT_is_at_infinity(grp, acc);
+
+done:
+    if (points)
+        for (i = 0; i < n; ++i) EC_POINT_free(points[i]);
+    if (scalars)
+        for (i = 0; i < n; ++i) BN_free(scalars[i]);
+    free(points);
+    free(scalars);
+    BN_free(sum);
+    BN_free(a);
+    BN_free(s);
+    BN_free(e);
+    EC_POINT_free(acc);
+    BN_CTX_free(ctx);
+    return ok;
+}
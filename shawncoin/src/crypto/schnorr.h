@@ -0,0 +1,34 @@
+#ifndef SHAWNCOIN_CRYPTO_SCHNORR_H
+#define SHAWNCOIN_CRYPTO_SCHNORR_H
+
+#include "crypto/keys.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHAWNCOIN_SCHNORR_SIG_LEN 64
+
+/* BIP340 Schnorr signatures over the same secp256k1 keys as ECDSA. The public key is the x
+ * coordinate of the key's point (bytes 1..32 of its compressed form); the signature is the
+ * x coordinate of the nonce point R followed by s. */
+
+/* Sign hash (32 bytes) with key into sig64, using fresh auxiliary randomness. Returns 1 on success. */
+int shawncoin_schnorr_sign(const shawncoin_keypair_t *key, const unsigned char *hash32, unsigned char *sig64);
+
+/* Verify sig64 over hash32 by the x-only key of compressed pubkey33. Returns 1 if valid. */
+int shawncoin_schnorr_verify(const unsigned char *pubkey33, const unsigned char *hash32, const unsigned char *sig64);
+
+/* Verify count signatures at once: one multi-scalar multiplication over all their points,
+ * weighted by random factors so invalid signatures cannot cancel out. Returns 1 only if all
+ * are valid; on 0, verify them one by one to find which. */
+int shawncoin_schnorr_verify_batch(const unsigned char *const *pubkeys33, const unsigned char *const *hashes32,
+                                   const unsigned char *const *sigs64, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHAWNCOIN_CRYPTO_SCHNORR_H */
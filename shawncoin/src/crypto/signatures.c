@@ -1,4 +1,6 @@
 #include "crypto/signatures.h"
+#include "crypto/context.h"
+#include "crypto/secure_random.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -11,15 +13,31 @@
 #include <openssl/sha.h>
 #include <openssl/obj_mac.h>
 #include <openssl/evp.h>
+
+/* Signatures are only valid with s in the lower half of the order, as libsecp256k1 requires;
+ * otherwise (r, n - s) would be a second valid encoding and the two builds would disagree. */
+static int is_high_s(const BIGNUM *s) {
+    const EC_GROUP *grp = shawncoin_ec_group();
+    BIGNUM *half = grp ? BN_dup(EC_GROUP_get0_order(grp)) : NULL;
+    int high = 1;
+    if (half && BN_rshift1(half, half) == 1) high = BN_cmp(s, half) > 0;
+    BN_free(half);
+    return high;
+}
 #endif
 
 int shawncoin_sign(const shawncoin_keypair_t *key, const unsigned char *hash32, unsigned char *sig, size_t *sig_len) {
     if (!key || !hash32 || !sig || !sig_len || *sig_len < 64) return 0;
 #if defined(HAVE_SECP256K1)
+    const secp256k1_context *ctx = shawncoin_secp256k1_context();
+    unsigned char seckey[32];
     secp256k1_ecdsa_signature secp_sig;
-    if (secp256k1_ecdsa_sign(key->ctx, &secp_sig, hash32, key->seckey, NULL, NULL) != 1)
+    if (!ctx || shawncoin_privkey_get(key, seckey) != 1) return 0;
+    int signed_ok = secp256k1_ecdsa_sign(ctx, &secp_sig, hash32, seckey, NULL, NULL);
+    shawncoin_memwipe(seckey, sizeof(seckey));
+    if (signed_ok != 1)
         return 0;
-    if (secp256k1_ecdsa_signature_serialize_compact(key->ctx, sig, &secp_sig) != 1)
+    if (secp256k1_ecdsa_signature_serialize_compact(ctx, sig, &secp_sig) != 1)
         return 0;
     *sig_len = 64;
     return 1;
@@ -30,6 +48,14 @@ int shawncoin_sign(const shawncoin_keypair_t *key, const unsigned char *hash32,
     if (!s) return 0;
     const BIGNUM *r, *rs;
     ECDSA_SIG_get0(s, &r, &rs);
+    if (is_high_s(rs)) {
+        BIGNUM *low = BN_new(), *rc = BN_dup(r);
+        if (!low || !rc || BN_sub(low, EC_GROUP_get0_order(shawncoin_ec_group()), rs) != 1 ||
+            ECDSA_SIG_set0(s, rc, low) != 1) {
+            BN_free(low); BN_free(rc); ECDSA_SIG_free(s); return 0;
+        }
+        ECDSA_SIG_get0(s, &r, &rs);
+    }
     int r_len = BN_num_bytes(r), s_len = BN_num_bytes(rs);
     if (r_len > 32 || s_len > 32) { ECDSA_SIG_free(s); return 0; }
     memset(sig, 0, 64);
@@ -42,44 +68,29 @@ int shawncoin_sign(const shawncoin_keypair_t *key, const unsigned char *hash32,
 }
 
 int shawncoin_verify(const unsigned char *pubkey33, const unsigned char *hash32, const unsigned char *sig, size_t sig_len) {
-    if (!pubkey33 || !hash32 || !sig) return 0;
+    if (!pubkey33 || !hash32 || !sig || sig_len != 64) return 0;
 #if defined(HAVE_SECP256K1)
-    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+    const secp256k1_context *ctx = shawncoin_secp256k1_context();
     if (!ctx) return 0;
     secp256k1_pubkey pub;
-    if (secp256k1_ec_pubkey_parse(ctx, &pub, pubkey33, 33) != 1) {
-        secp256k1_context_destroy(ctx);
-        return 0;
-    }
+    if (secp256k1_ec_pubkey_parse(ctx, &pub, pubkey33, 33) != 1) return 0;
     secp256k1_ecdsa_signature secp_sig;
-    if (sig_len != 64 || secp256k1_ecdsa_signature_parse_compact(ctx, &secp_sig, sig) != 1) {
-        secp256k1_context_destroy(ctx);
-        return 0;
-    }
-    int ret = secp256k1_ecdsa_verify(ctx, &secp_sig, hash32, &pub);
-    secp256k1_context_destroy(ctx);
-    return ret;
+    if (secp256k1_ecdsa_signature_parse_compact(ctx, &secp_sig, sig) != 1) return 0;
+    return secp256k1_ecdsa_verify(ctx, &secp_sig, hash32, &pub);
 #else
-    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_secp256k1);
-    if (!ec) return 0;
-    const EC_GROUP *grp = EC_KEY_get0_group(ec);
-    EC_POINT *pub = EC_POINT_new(grp);
-    if (!pub || EC_POINT_oct2point(grp, pub, pubkey33, 33, NULL) != 1) {
-        if (pub) EC_POINT_free(pub);
-        EC_KEY_free(ec);
-        return 0;
-    }
-    EC_KEY_set_public_key(ec, pub);
-    EC_POINT_free(pub);
-    if (sig_len != 64) { EC_KEY_free(ec); return 0; }
+    /* Reused per thread: only the public key changes between calls */
+    EC_KEY *ec = shawncoin_ec_verify_key();
+    EC_POINT *pub = shawncoin_ec_verify_point();
+    if (!ec || !pub) return 0;
+    if (EC_POINT_oct2point(EC_KEY_get0_group(ec), pub, pubkey33, 33, NULL) != 1) return 0;
+    if (EC_KEY_set_public_key(ec, pub) != 1) return 0;
     BIGNUM *r = BN_bin2bn(sig, 32, NULL), *s = BN_bin2bn(sig + 32, 32, NULL);
-    if (!r || !s) { BN_free(r); BN_free(s); EC_KEY_free(ec); return 0; }
+    if (!r || !s || is_high_s(s)) { BN_free(r); BN_free(s); return 0; }
     ECDSA_SIG *ec_sig = ECDSA_SIG_new();
-    if (!ec_sig) { BN_free(r); BN_free(s); EC_KEY_free(ec); return 0; }
+    if (!ec_sig) { BN_free(r); BN_free(s); return 0; }
     ECDSA_SIG_set0(ec_sig, r, s);
     int ok = ECDSA_do_verify(hash32, 32, ec_sig, ec) == 1;
     ECDSA_SIG_free(ec_sig);
-    EC_KEY_free(ec);
     return ok;
 #endif
 }
@@ -12,7 +12,8 @@ extern "C" {
 /* ECDSA sign hash (32 bytes) with key. Output: *sig_len bytes (max 72). Returns 1 on success. */
 int shawncoin_sign(const shawncoin_keypair_t *key, const unsigned char *hash32, unsigned char *sig, size_t *sig_len);
 
-/* ECDSA verify: pubkey 33 bytes, hash 32 bytes, sig of sig_len. Returns 1 if valid. */
+/* ECDSA verify: pubkey 33 bytes, hash 32 bytes, sig of sig_len. Returns 1 if valid; signatures
+ * with s above half the curve order are rejected, and shawncoin_sign never produces them. */
 int shawncoin_verify(const unsigned char *pubkey33, const unsigned char *hash32, const unsigned char *sig, size_t sig_len);
 
 #ifdef __cplusplus
@@ -1,7 +1,15 @@
 #include "core/blockchain.hpp"
 #include "core/block.hpp"
 #include "core/mempool.hpp"
+#include "core/mempoolaccept.hpp"
+#include "core/orphanpool.hpp"
+#include "core/feeestimator.hpp"
+#include "core/sigcache.hpp"
 #include "storage/chainstate.hpp"
+#include "storage/coinsdb.hpp"
+#include "storage/utxosnapshot.hpp"
+#include "storage/mempoolfile.hpp"
+#include "storage/database.hpp"
 #include "network/node.hpp"
 // #include "rpc/server.hpp"
 // #include "rpc/api.hpp"
@@ -10,8 +18,11 @@
 #include "util/config.hpp"
 #include "util/logger.hpp"
 #include "util/util.hpp"
+#include "util/checkqueue.hpp"
+#include "util/realtime.hpp"
 #include "core/types.hpp"
 #include "crypto/address.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <csignal>
@@ -19,6 +30,7 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <cstdlib>
 
 // Global shutdown flag for signal handling
 static std::atomic<bool> g_shutdown{false};
@@ -47,6 +59,7 @@ int main(int argc, char* argv[]) {
 
         shawncoin::Logger::instance().setFile(config.get("debug.logfile", ""));
         SHAWNCOIN_LOG(Info, "main", "Shawn Coin (SHWN) starting - %s", dataDir.c_str());
+        shawncoin::realtimeBus().start(dataDir);
 
         // Set up signal handlers for graceful shutdown
         std::signal(SIGINT, signalHandler);
@@ -72,8 +85,71 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // UTXO set: on-disk coins database behind an in-memory cache of dbcache MB
+    std::unique_ptr<shawncoin::Database> coinsDatabase = shawncoin::createDatabase();
+    if (!coinsDatabase->open(dataDir + "/chainstate")) {
+        SHAWNCOIN_LOG(Error, "main", "Failed to open coins database at %s/chainstate", dataDir.c_str());
+        return 1;
+    }
+    shawncoin::CoinsDB coinsDB(*coinsDatabase);
+    int dbcacheMb = config.getInt("optimization.dbcache", config.getInt("dbcache", 256));
+    if (dbcacheMb < 4) dbcacheMb = 4;
+    chain.setCoinsBackend(&coinsDB, (size_t)dbcacheMb << 20);
+    // Snapshots of blocks this node has not seen: <blockhash>:<height>:<muhash>
+    std::string assumeUtxo = config.get("advanced.assumeutxo", config.get("assumeutxo", ""));
+    if (!assumeUtxo.empty()) {
+        size_t a = assumeUtxo.find(':'), b = assumeUtxo.rfind(':');
+        shawncoin::TrustedSnapshot trusted;
+        if (a != std::string::npos && b > a) {
+            trusted.blockHash = shawncoin::hexToUint256(assumeUtxo.substr(0, a));
+            trusted.height = std::strtoull(assumeUtxo.substr(a + 1, b - a - 1).c_str(), nullptr, 10);
+            trusted.setHash = shawncoin::hexToUint256(assumeUtxo.substr(b + 1));
+        }
+        if (trusted.blockHash == shawncoin::uint256{} || trusted.setHash == shawncoin::uint256{})
+            SHAWNCOIN_LOG(Error, "main", "Ignoring malformed assumeutxo (expected blockhash:height:muhash)");
+        else
+            chain.addTrustedSnapshot(trusted);
+    }
+    std::string snapshotPath = config.get("advanced.loadutxoset", config.get("loadutxoset", ""));
+    if (!snapshotPath.empty()) {
+        shawncoin::UTXOSnapshotMeta meta;
+        if (!chain.loadUTXOSet(snapshotPath, meta))
+            SHAWNCOIN_LOG(Error, "main", "Could not load UTXO snapshot %s", snapshotPath.c_str());
+    }
+    if (config.getInt("advanced.addressindex", config.getInt("addressindex", 0)) != 0)
+        chain.enableAddressIndex();
+
     // Initialize mempool and P2P node
     shawncoin::Mempool mempool;
+    int maxMempoolMb = config.getInt("optimization.maxmempool", config.getInt("maxmempool", 300));
+    if (maxMempoolMb < 5) maxMempoolMb = 5;
+    mempool.setMaxBytes((size_t)maxMempoolMb * 1000000);
+    mempool.setReplaceByFee(config.getInt("optimization.replacebyfee", config.getInt("replacebyfee", 0)) != 0);
+    shawncoin::FeeEstimator feeEstimator;
+    feeEstimator.setHeight(chain.getHeight());
+    mempool.setFeeEstimator(&feeEstimator);
+    chain.setMempool(&mempool);
+    mempool.setCoinsView(&chain.utxo());
+    unsigned verifyThreads = (unsigned)std::max(0, config.getInt("optimization.verifythreads", config.getInt("verifythreads", 0)));
+    shawncoin::CheckQueue checkQueue(verifyThreads);
+    chain.setCheckQueue(&checkQueue);
+    int sigCacheMb = std::max(1, config.getInt("optimization.sigcachesize", config.getInt("sigcachesize", 32)));
+    shawncoin::SignatureCache sigCache((size_t)sigCacheMb << 20);
+    chain.setSignatureCache(&sigCache);
+    shawncoin::OrphanPool orphans;
+    shawncoin::MempoolAcceptor acceptor(mempool, chain.utxo(), verifyThreads);
+    acceptor.setOrphanPool(&orphans);
+    acceptor.setSignatureCache(&sigCache);
+    acceptor.setCheckQueue(&checkQueue);
+    // Reload the previous session's pool without holding up startup
+    std::string mempoolPath = dataDir + "/mempool.dat";
+    bool persistMempool = config.getInt("optimization.persistmempool", config.getInt("persistmempool", 1)) != 0;
+    std::thread mempoolLoader;
+    if (persistMempool && std::ifstream(mempoolPath)) {
+        mempoolLoader = std::thread([&]() {
+            shawncoin::loadMempoolFile(mempoolPath, acceptor, &g_shutdown);
+        });
+    }
     shawncoin::Node node(chain, mempool);
     uint16_t p2pPort = config.getPort("port", shawncoin::P2P_PORT);
     
@@ -144,8 +220,10 @@ int main(int argc, char* argv[]) {
 
     SHAWNCOIN_LOG(Info, "main", "Shutting down...");
     if (miner) miner->stop();
+    if (mempoolLoader.joinable()) mempoolLoader.join();
+    if (persistMempool) shawncoin::writeMempoolFile(mempoolPath, mempool);
     uint64_t finalHeight = chain.getHeight();
-    uint64_t totalIssued = shawncoin::getTotalSupplyUpTo(finalHeight);
+    uint64_t totalIssued = chain.getTotalSupply();
     {
         std::ofstream f(dataDir + "/mined_summary.txt");
         if (f) {
@@ -155,6 +233,10 @@ int main(int argc, char* argv[]) {
     }
     // rpcServer.stop();
     node.stop();
+    shawncoin::realtimeBus().stop();
+    if (!chain.flushCoins())
+        SHAWNCOIN_LOG(Error, "main", "Failed to flush UTXO cache");
+    coinsDatabase->close();
     chainState.shutdown();
     SHAWNCOIN_LOG(Info, "main", "Shawn Coin stopped. Mined %llu blocks, %llu SHWN total.", (unsigned long long)finalHeight, (unsigned long long)(totalIssued / shawncoin::COIN));
     return 0;
@@ -3,9 +3,72 @@
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <array>
 
 namespace shawncoin {
 
+namespace {
+
+// 256-bit unsigned arithmetic on four 64-bit limbs (limb 0 least significant).
+using Limbs = std::array<uint64_t, 4>;
+
+Limbs toLimbs(const uint256& v) {
+    Limbs l{};
+    for (size_t i = 0; i < 32; ++i) l[i / 8] |= (uint64_t)v[i] << (8 * (i % 8));
+    return l;
+}
+
+uint256 fromLimbs(const Limbs& l) {
+    uint256 v{};
+    for (size_t i = 0; i < 32; ++i) v[i] = (uint8_t)(l[i / 8] >> (8 * (i % 8)));
+    return v;
+}
+
+int compareLimbs(const Limbs& a, const Limbs& b) {
+    for (int i = 3; i >= 0; --i) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// a += b; returns carry out
+bool addLimbs(Limbs& a, const Limbs& b) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        uint64_t s = a[i] + b[i];
+        uint64_t c1 = s < a[i];
+        a[i] = s + carry;
+        carry = c1 | (a[i] < s);
+    }
+    return carry != 0;
+}
+
+// a -= b (caller guarantees a >= b)
+void subLimbs(Limbs& a, const Limbs& b) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        uint64_t d = a[i] - b[i];
+        uint64_t b1 = a[i] < b[i];
+        a[i] = d - borrow;
+        borrow = b1 | (d < borrow);
+    }
+}
+
+Limbs divLimbs(const Limbs& n, const Limbs& d) {
+    Limbs q{}, r{};
+    for (int bit = 255; bit >= 0; --bit) {
+        for (int i = 3; i > 0; --i) r[i] = (r[i] << 1) | (r[i - 1] >> 63);
+        r[0] = (r[0] << 1) | ((n[bit / 64] >> (bit % 64)) & 1);
+        if (compareLimbs(r, d) >= 0) {
+            subLimbs(r, d);
+            q[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+    return q;
+}
+
+} // namespace
+
 uint32_t getNextDifficulty(uint32_t currentTarget, uint64_t lastBlockTime, uint64_t firstBlockTime, uint32_t numBlocks) {
     if (numBlocks == 0 || firstBlockTime >= lastBlockTime) return currentTarget;
     uint64_t elapsed = lastBlockTime - firstBlockTime;
@@ -123,4 +186,48 @@ std::string difficultyToString(uint32_t difficulty) {
     return oss.str();
 }
 
+uint256 compactToTarget(uint32_t compact) {
+    // Compact format: byte 0 = size (exponent), bytes 1-3 = mantissa.
+    int nSize = (int)(compact >> 24);
+    uint32_t nWord = compact & 0x007fffff;
+    uint256 target{};
+    if (nSize <= 3) {
+        nWord >>= 8 * (3 - nSize);
+        target[31] = (nWord >> 0) & 0xff;
+        target[30] = (nWord >> 8) & 0xff;
+        target[29] = (nWord >> 16) & 0xff;
+    } else {
+        int shift = 8 * (nSize - 3);
+        int bytePos = 32 - (shift / 8) - 1;
+        if (bytePos >= 0) {
+            target[bytePos] = (nWord >> 0) & 0xff;
+            if (bytePos > 0) target[bytePos - 1] = (nWord >> 8) & 0xff;
+            if (bytePos > 1) target[bytePos - 2] = (nWord >> 16) & 0xff;
+        }
+    }
+    return target;
+}
+
+uint256 getBlockWork(uint32_t compact) {
+    Limbs target = toLimbs(compactToTarget(compact));
+    if (compareLimbs(target, Limbs{}) == 0) return uint256{};
+    // 2^256 / (target + 1) == ~target / (target + 1) + 1
+    Limbs inv{ ~target[0], ~target[1], ~target[2], ~target[3] };
+    Limbs denom = target;
+    if (addLimbs(denom, Limbs{ 1, 0, 0, 0 })) return fromLimbs(Limbs{ 1, 0, 0, 0 }); // target == 2^256 - 1
+    Limbs work = divLimbs(inv, denom);
+    addLimbs(work, Limbs{ 1, 0, 0, 0 });
+    return fromLimbs(work);
+}
+
+uint256 addWork(const uint256& a, const uint256& b) {
+    Limbs sum = toLimbs(a);
+    if (addLimbs(sum, toLimbs(b))) sum = Limbs{ ~0ull, ~0ull, ~0ull, ~0ull };
+    return fromLimbs(sum);
+}
+
+int compareWork(const uint256& a, const uint256& b) {
+    return compareLimbs(toLimbs(a), toLimbs(b));
+}
+
 } // namespace shawncoin
@@ -24,6 +24,18 @@ bool isValidDifficulty(uint32_t difficulty);
 /** Convert difficulty to human-readable format. */
 std::string difficultyToString(uint32_t difficulty);
 
+/** Expand a compact target to 256 bits (byte 31 most significant, as compared by checkProofOfWork). */
+uint256 compactToTarget(uint32_t compact);
+
+/** Work contributed by one block at this target: 2^256 / (target + 1). Same byte order as compactToTarget. */
+uint256 getBlockWork(uint32_t compact);
+
+/** Sum of two 256-bit work values (saturates at 2^256 - 1). */
+uint256 addWork(const uint256& a, const uint256& b);
+
+/** Compare two 256-bit work values; returns <0, 0 or >0. */
+int compareWork(const uint256& a, const uint256& b);
+
 /** Initial difficulty (genesis). */
 constexpr uint32_t INITIAL_DIFFICULTY = 0x1d00ffff;
 
@@ -52,24 +52,7 @@ void Miner::start(uint32_t threadCount) {
 bool Miner::mineBlock(Block& block, uint32_t difficultyTarget) {
     block.header.difficulty_target = difficultyTarget;
     block.header.merkle_root = computeMerkleRoot(block.transactions);
-    uint256 target{};
-    uint32_t compact = difficultyTarget;
-    int nSize = (int)(compact >> 24);
-    uint32_t nWord = compact & 0x007fffff;
-    if (nSize <= 3) {
-        nWord >>= 8 * (3 - nSize);
-        target[31] = (nWord >> 0) & 0xff;
-        target[30] = (nWord >> 8) & 0xff;
-        target[29] = (nWord >> 16) & 0xff;
-    } else {
-        int shift = 8 * (nSize - 3);
-        int bytePos = 32 - (shift / 8) - 1;
-        if (bytePos >= 0) {
-            target[bytePos] = (nWord >> 0) & 0xff;
-            if (bytePos > 0) target[bytePos - 1] = (nWord >> 8) & 0xff;
-            if (bytePos > 1) target[bytePos - 2] = (nWord >> 16) & 0xff;
-        }
-    }
+    uint256 target = compactToTarget(difficultyTarget);
     uint32_t nonce = 0;
     do {
         block.header.nonce = nonce;
@@ -138,7 +121,7 @@ void Miner::miningLoop() {
             uint64_t newHeight = chain_->getHeight() + 1;
             bool ok = chain_->addBlock(block, newHeight);
             if (ok) {
-                uint64_t totalIssued = getTotalSupplyUpTo(newHeight);
+                uint64_t totalIssued = chain_->getTotalSupply();
                 SHAWNCOIN_LOG(Info, "miner", "Mined block %llu (hash=%s) reward=%llu SHWN total=%llu",
                     (unsigned long long)newHeight,
                     uint256ToHex(block.getHash()).c_str(),
@@ -153,7 +136,7 @@ void Miner::miningLoop() {
                         + ",\"txcount\":" + std::to_string(block.transactions.size())
                         + ",\"difficulty\":\"" + difficultyToString(block.header.difficulty_target) + "\""
                         + ",\"hashrate\":" + std::to_string(hashrate_.load()) + "}";
-                    shawncoin::appendRealtimeEvent(evt);
+                    shawncoin::appendRealtimeEvent(std::move(evt));
                     
                     // Log difficulty adjustment info at retarget points
                     if (newHeight > 0 && newHeight % DIFFICULTY_INTERVAL == 0) {
@@ -161,7 +144,7 @@ void Miner::miningLoop() {
                         std::string diffInfo = "{\"type\":\"difficulty_adjustment\",\"height\":" + std::to_string(newHeight)
                             + ",\"difficulty\":\"" + difficultyToString(block.header.difficulty_target) + "\""
                             + ",\"network_hashrate\":" + std::to_string(networkHashRate) + "}";
-                        shawncoin::appendRealtimeEvent(diffInfo);
+                        shawncoin::appendRealtimeEvent(std::move(diffInfo));
                     }
                 } catch (...) { /* ignore errors */ }
             }
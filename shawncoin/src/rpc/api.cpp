@@ -2,16 +2,23 @@
 #include "core/blockchain.hpp"
 #include "core/transaction.hpp"
 #include "core/mempool.hpp"
+#include "core/mempoolaccept.hpp"
+#include "core/feeestimator.hpp"
 #include "mining/miner.hpp"
 #include "wallet/hdwallet.hpp"
 #include "wallet/wallet.hpp"
 #include "crypto/address.hpp"
+#include "storage/utxosnapshot.hpp"
 #include "util/logger.hpp"
 #include "util/util.hpp"
+#include <algorithm>
+#include <optional>
 #include <sstream>
 #include <fstream>
 #include <cstring>
+#include <cctype>
 #include <ctime>
+#include <stdexcept>
 
 // Simple JSON parser for RPC (avoid external dependency)
 #include <map>
@@ -27,6 +34,7 @@ public:
     
     SimpleJson() : data(nullptr) {}
     SimpleJson(const std::string& s) : data(s) {}
+    SimpleJson(const char* s) : data(std::string(s)) {}
     SimpleJson(int64_t i) : data(i) {}
     SimpleJson(int i) : data(static_cast<int64_t>(i)) {}
     SimpleJson(double d) : data(d) {}
@@ -35,6 +43,7 @@ public:
     
     // Assignment operators to resolve ambiguity
     SimpleJson& operator=(const std::string& s) { data = s; return *this; }
+    SimpleJson& operator=(const char* s) { data = std::string(s); return *this; }
     SimpleJson& operator=(int64_t i) { data = i; return *this; }
     SimpleJson& operator=(int i) { data = static_cast<int64_t>(i); return *this; }
     SimpleJson& operator=(uint32_t i) { data = static_cast<int64_t>(i); return *this; }
@@ -50,27 +59,10 @@ public:
     }
     
     static SimpleJson parse(const std::string& json) {
-        // Basic parsing - just handles simple RPC calls
-        SimpleJson result;
-        std::map<std::string, SimpleJson> obj;
-        
-        // Extract method
-        size_t method_pos = json.find("\"method\"");
-        if (method_pos != std::string::npos) {
-            size_t colon = json.find(":", method_pos);
-            if (colon != std::string::npos) {
-                size_t start = json.find("\"", colon);
-                if (start != std::string::npos) {
-                    size_t end = json.find("\"", start + 1);
-                    if (end != std::string::npos) {
-                        std::string method = json.substr(start + 1, end - start - 1);
-                        obj["method"] = method;
-                    }
-                }
-            }
-        }
-        
-        result.data = obj;
+        size_t pos = 0;
+        SimpleJson result = parseValue(json, pos);
+        skipWhitespace(json, pos);
+        if (pos != json.size()) throw std::runtime_error("trailing characters");
         return result;
     }
     
@@ -81,6 +73,12 @@ public:
         return false;
     }
     
+    SimpleJson& operator[](const std::string& key) {
+        if (!std::holds_alternative<std::map<std::string, SimpleJson>>(data))
+            data = std::map<std::string, SimpleJson>();
+        return std::get<std::map<std::string, SimpleJson>>(data)[key];
+    }
+    
     SimpleJson operator[](const std::string& key) const {
         if (auto* obj = std::get_if<std::map<std::string, SimpleJson>>(&data)) {
             auto it = obj->find(key);
@@ -92,12 +90,16 @@ public:
     bool is_string() const { return std::holds_alternative<std::string>(data); }
     bool is_object() const { return std::holds_alternative<std::map<std::string, SimpleJson>>(data); }
     bool is_array() const { return std::holds_alternative<std::vector<SimpleJson>>(data); }
+    bool is_null() const { return std::holds_alternative<std::nullptr_t>(data); }
     
     template<typename T>
     T get() const {
         if constexpr (std::is_same_v<T, std::string>) {
             if (auto* s = std::get_if<std::string>(&data)) return *s;
         }
+        if constexpr (std::is_same_v<T, bool>) {
+            if (auto* b = std::get_if<bool>(&data)) return *b;
+        }
         if constexpr (std::is_integral_v<T>) {
             if (auto* i = std::get_if<int64_t>(&data)) return static_cast<T>(*i);
         }
@@ -141,6 +143,10 @@ public:
         }
     }
     
+    SimpleJson operator[](int index) {
+        return static_cast<const SimpleJson&>(*this)[index];
+    }
+    
     SimpleJson operator[](int index) const {
         if (auto* arr = std::get_if<std::vector<SimpleJson>>(&data)) {
             if (index >= 0 && index < static_cast<int>(arr->size())) {
@@ -151,6 +157,94 @@ public:
     }
     
 private:
+    static void skipWhitespace(const std::string& s, size_t& pos) {
+        while (pos < s.size() && std::isspace((unsigned char)s[pos])) ++pos;
+    }
+    
+    static std::string parseString(const std::string& s, size_t& pos) {
+        std::string out;
+        ++pos; // opening quote
+        while (pos < s.size() && s[pos] != '"') {
+            char c = s[pos++];
+            if (c != '\\') { out += c; continue; }
+            if (pos >= s.size()) break;
+            char e = s[pos++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    if (pos + 4 > s.size()) throw std::runtime_error("bad escape");
+                    unsigned cp = (unsigned)std::stoul(s.substr(pos, 4), nullptr, 16);
+                    pos += 4;
+                    if (cp < 0x80) out += (char)cp;
+                    else if (cp < 0x800) { out += (char)(0xc0 | (cp >> 6)); out += (char)(0x80 | (cp & 0x3f)); }
+                    else { out += (char)(0xe0 | (cp >> 12)); out += (char)(0x80 | ((cp >> 6) & 0x3f)); out += (char)(0x80 | (cp & 0x3f)); }
+                    break;
+                }
+                default: out += e; break; // \" \\ \/
+            }
+        }
+        if (pos >= s.size()) throw std::runtime_error("unterminated string");
+        ++pos; // closing quote
+        return out;
+    }
+    
+    static SimpleJson parseValue(const std::string& s, size_t& pos) {
+        skipWhitespace(s, pos);
+        if (pos >= s.size()) throw std::runtime_error("unexpected end of input");
+        char c = s[pos];
+        if (c == '{') {
+            SimpleJson obj = object();
+            ++pos;
+            skipWhitespace(s, pos);
+            if (pos < s.size() && s[pos] == '}') { ++pos; return obj; }
+            for (;;) {
+                skipWhitespace(s, pos);
+                if (pos >= s.size() || s[pos] != '"') throw std::runtime_error("expected key");
+                std::string key = parseString(s, pos);
+                skipWhitespace(s, pos);
+                if (pos >= s.size() || s[pos] != ':') throw std::runtime_error("expected ':'");
+                ++pos;
+                obj[key] = parseValue(s, pos);
+                skipWhitespace(s, pos);
+                if (pos < s.size() && s[pos] == ',') { ++pos; continue; }
+                if (pos < s.size() && s[pos] == '}') { ++pos; return obj; }
+                throw std::runtime_error("expected ',' or '}'");
+            }
+        }
+        if (c == '[') {
+            SimpleJson arr = array();
+            ++pos;
+            skipWhitespace(s, pos);
+            if (pos < s.size() && s[pos] == ']') { ++pos; return arr; }
+            for (;;) {
+                arr.push_back(parseValue(s, pos));
+                skipWhitespace(s, pos);
+                if (pos < s.size() && s[pos] == ',') { ++pos; continue; }
+                if (pos < s.size() && s[pos] == ']') { ++pos; return arr; }
+                throw std::runtime_error("expected ',' or ']'");
+            }
+        }
+        if (c == '"') return SimpleJson(parseString(s, pos));
+        if (s.compare(pos, 4, "true") == 0) { pos += 4; return SimpleJson(true); }
+        if (s.compare(pos, 5, "false") == 0) { pos += 5; return SimpleJson(false); }
+        if (s.compare(pos, 4, "null") == 0) { pos += 4; return SimpleJson(nullptr); }
+        size_t start = pos;
+        bool isFloat = false;
+        while (pos < s.size() && (std::isdigit((unsigned char)s[pos]) || s[pos] == '-' || s[pos] == '+' ||
+                                  s[pos] == '.' || s[pos] == 'e' || s[pos] == 'E')) {
+            if (s[pos] == '.' || s[pos] == 'e' || s[pos] == 'E') isFloat = true;
+            ++pos;
+        }
+        if (start == pos) throw std::runtime_error("unexpected character");
+        std::string num = s.substr(start, pos - start);
+        if (isFloat) return SimpleJson(std::stod(num));
+        return SimpleJson(static_cast<int64_t>(std::stoll(num)));
+    }
+    
     void dump_recursive(std::ostringstream& oss) const {
         if (auto* s = std::get_if<std::string>(&data)) {
             oss << '"' << *s << '"';
@@ -185,12 +279,35 @@ private:
 
 using json = SimpleJson;
 
+static constexpr uint64_t MAX_CHAIN_STATS_RANGE = 1000;
+static constexpr size_t MAX_ADDRESS_QUERY = 1000;
+
+static json chainStatsToJson(const ChainStats& st) {
+    json j = json::object();
+    j["height"] = st.height;
+    j["time"] = st.timestamp;
+    j["interval"] = st.interval;
+    j["size"] = st.size;
+    j["txcount"] = st.txCount;
+    j["fees"] = st.fees;
+    j["utxo_delta"] = static_cast<int64_t>(st.utxoDelta);
+    j["total_supply"] = st.totalSupply;
+    j["total_txcount"] = st.totalTxCount;
+    return j;
+}
+
 std::string apiBlockchainInfo(RpcContext* ctx) {
     if (!ctx || !ctx->chain) return "{}";
+    uint64_t height = ctx->chain->getHeight();
+    auto stats = ctx->chain->getChainStats(height);
     std::ostringstream out;
-    out << "{\"chain\":\"shawncoin\",\"blocks\":" << ctx->chain->getHeight()
+    out << "{\"chain\":\"shawncoin\",\"blocks\":" << height
         << ",\"bestblockhash\":\"" << uint256ToHex(ctx->chain->getBestBlockHash())
-        << "\",\"mempool_size\":" << (ctx->mempool ? ctx->mempool->size() : 0) << "}";
+        << "\",\"mempool_size\":" << (ctx->mempool ? ctx->mempool->size() : 0)
+        << ",\"mempool_bytes\":" << (ctx->mempool ? ctx->mempool->bytes() : 0)
+        << ",\"mempool_minfee\":" << (ctx->mempool ? ctx->mempool->getMinFeeRate() : 0)
+        << ",\"total_supply\":" << (stats ? stats->totalSupply : 0)
+        << ",\"total_txcount\":" << (stats ? stats->totalTxCount : 0) << "}";
     return out.str();
 }
 
@@ -266,43 +383,40 @@ std::string handleRpcRequest(const std::string& request, RpcContext* ctx) {
         if (method == "wallet.listunspent") {
             if (!ctx || !ctx->wallet || !ctx->chain) throw std::runtime_error("no wallet/chain");
             json arr = json::array();
-            auto snap = ctx->chain->utxo().snapshot();
-            for (const auto& p : snap) {
-                const OutPoint& op = p.first;
-                const UTXOSet::Entry& e = p.second;
+            ctx->chain->utxo().forEach([&](const OutPoint& op, const UTXOSet::Entry& e) {
                 const Script& s = e.script_pubkey;
                 if (s.size() == 25 && s[0] == 0x76 && s[1] == 0xa9 && s[2] == 0x14 && s[23] == 0x88 && s[24] == 0xac) {
                     std::vector<uint8_t> hash160(20);
                     std::copy(s.begin() + 3, s.begin() + 23, hash160.begin());
                     // include only UTXOs that belong to our wallet
-                    if (!ctx->wallet->hasHash160(hash160)) continue;
+                    if (!ctx->wallet->hasHash160(hash160)) return true;
                     json obj;
                     obj["txid"] = uint256ToHex(op.hash);
                     obj["vout"] = op.index;
                     obj["amount"] = e.amount;
                     arr.push_back(obj);
                 }
-            }
+                return true;
+            });
             resp["result"] = arr;
             resp["id"] = id;
             return resp.dump();
         }
 
         if (method == "wallet.sendtoaddress") {
-            if (!ctx || !ctx->wallet || !ctx->chain || !ctx->mempool) throw std::runtime_error("no wallet/chain/mempool");
-            if (!params.is_array() || params.size() < 2) throw std::runtime_error("params: [address, amount_satoshis]");
+            if (!ctx || !ctx->wallet || !ctx->chain || !ctx->acceptor) throw std::runtime_error("no wallet/chain/mempool");
+            if (!params.is_array() || params.size() < 2) throw std::runtime_error("params: [address, amount_satoshis, fee?, schnorr?]");
             std::string dest = params[0].get<std::string>();
             uint64_t amount = params[1].get<uint64_t>();
             uint64_t fee = 0;
-            if (params.size() >= 3) fee = params[2].get<uint64_t>();
+            bool fixedFee = params.size() >= 3 && !params[2].is_null();
+            if (fixedFee) fee = params[2].get<uint64_t>();
+            bool schnorr = params.size() >= 4 && params[3].get<bool>();
 
             // gather UTXOs belonging to wallet
-            auto snap = ctx->chain->utxo().snapshot();
             struct U { OutPoint op; UTXOSet::Entry e; };
             std::vector<U> utxos;
-            for (const auto& p : snap) {
-                const OutPoint& op = p.first;
-                const UTXOSet::Entry& e = p.second;
+            ctx->chain->utxo().forEach([&](const OutPoint& op, const UTXOSet::Entry& e) {
                 const Script& s = e.script_pubkey;
                 if (s.size() == 25 && s[0] == 0x76 && s[1] == 0xa9 && s[2] == 0x14 && s[23] == 0x88 && s[24] == 0xac) {
                     std::vector<uint8_t> h(20);
@@ -320,56 +434,79 @@ std::string handleRpcRequest(const std::string& request, RpcContext* ctx) {
                         }
                     }
                 }
+                return true;
+            });
+            // Without an explicit fee, pay the estimated rate on the size the signed tx will have
+            uint64_t feeRate = 0;
+            if (!fixedFee) {
+                std::optional<uint64_t> estimate;
+                if (ctx->feeEstimator) estimate = ctx->feeEstimator->estimateFee(FeeEstimator::DEFAULT_TARGET);
+                feeRate = estimate.value_or(FeeEstimator::FALLBACK_FEE_RATE);
+                if (ctx->mempool) feeRate = std::max(feeRate, ctx->mempool->getMinFeeRate());
             }
-            // select UTXOs greedily
-            uint64_t total = 0;
-            std::vector<U> selected;
-            for (const auto& u : utxos) {
-                selected.push_back(u);
-                total += u.e.amount;
-                if (total >= amount + fee) break;
-            }
-            if (total < amount + fee) throw std::runtime_error("insufficient funds");
-
-            // Build transaction
-            Transaction tx;
-            tx.version = 1;
-            // inputs
-            for (const auto& sU : selected) {
-                TxInput in;
-                in.prev_tx_hash = sU.op.hash;
-                in.output_index = sU.op.index;
-                tx.inputs.push_back(in);
-            }
-            // outputs: destination
-            TxOutput out;
-            out.amount = amount;
-            // build P2PKH script for dest
             std::vector<uint8_t> dest_hash = addressToPubKeyHash(dest);
-            out.script_pubkey = {0x76, 0xa9, 0x14};
-            if (dest_hash.size() == 20) out.script_pubkey.insert(out.script_pubkey.end(), dest_hash.begin(), dest_hash.end()); else out.script_pubkey.insert(out.script_pubkey.end(), 20, 0);
-            out.script_pubkey.push_back(0x88); out.script_pubkey.push_back(0xac);
-            tx.outputs.push_back(out);
-
-            uint64_t change = total - amount - fee;
-            if (change > 0) {
-                // send change to first wallet address
-                std::string changeAddr = ctx->wallet->generateNewAddress();
-                TxOutput c;
-                c.amount = change;
-                std::vector<uint8_t> ch = addressToPubKeyHash(changeAddr);
-                c.script_pubkey = {0x76,0xa9,0x14};
-                if (ch.size() == 20) c.script_pubkey.insert(c.script_pubkey.end(), ch.begin(), ch.end()); else c.script_pubkey.insert(c.script_pubkey.end(), 20, 0);
-                c.script_pubkey.push_back(0x88); c.script_pubkey.push_back(0xac);
-                tx.outputs.push_back(c);
+            std::string changeAddr;
+            Transaction tx;
+            for (int attempt = 0;; ++attempt) {
+                // select UTXOs greedily
+                uint64_t total = 0;
+                std::vector<U> selected;
+                for (const auto& u : utxos) {
+                    selected.push_back(u);
+                    total += u.e.amount;
+                    if (total >= amount + fee) break;
+                }
+                if (total < amount + fee) throw std::runtime_error("insufficient funds");
+
+                // Build transaction
+                tx = Transaction();
+                tx.version = schnorr ? TX_VERSION_SCHNORR : 1;
+                // inputs
+                for (const auto& sU : selected) {
+                    TxInput in;
+                    in.prev_tx_hash = sU.op.hash;
+                    in.output_index = sU.op.index;
+                    tx.inputs.push_back(in);
+                }
+                // outputs: destination
+                TxOutput out;
+                out.amount = amount;
+                // build P2PKH script for dest
+                out.script_pubkey = {0x76, 0xa9, 0x14};
+                if (dest_hash.size() == 20) out.script_pubkey.insert(out.script_pubkey.end(), dest_hash.begin(), dest_hash.end()); else out.script_pubkey.insert(out.script_pubkey.end(), 20, 0);
+                out.script_pubkey.push_back(0x88); out.script_pubkey.push_back(0xac);
+                tx.outputs.push_back(out);
+
+                uint64_t change = total - amount - fee;
+                if (change > 0) {
+                    // send change to a fresh wallet address
+                    if (changeAddr.empty()) changeAddr = ctx->wallet->generateNewAddress();
+                    TxOutput c;
+                    c.amount = change;
+                    std::vector<uint8_t> ch = addressToPubKeyHash(changeAddr);
+                    c.script_pubkey = {0x76,0xa9,0x14};
+                    if (ch.size() == 20) c.script_pubkey.insert(c.script_pubkey.end(), ch.begin(), ch.end()); else c.script_pubkey.insert(c.script_pubkey.end(), 20, 0);
+                    c.script_pubkey.push_back(0x88); c.script_pubkey.push_back(0xac);
+                    tx.outputs.push_back(c);
+                }
+                if (fixedFee) break;
+                // Each input will carry a 64-byte signature and a 33-byte pubkey
+                std::vector<uint8_t> unsignedTx;
+                serializeTransaction(tx, unsignedTx);
+                size_t signedSize = unsignedTx.size() + tx.inputs.size() * (64 + 33);
+                uint64_t needed = (feeRate * signedSize + 999) / 1000;
+                if (needed <= fee) break;
+                if (attempt >= 10) throw std::runtime_error("could not settle on a fee");
+                fee = needed; // more inputs may be needed to cover it
             }
 
             // sign
             if (!ctx->wallet->signTransaction(tx, &ctx->chain->utxo())) throw std::runtime_error("failed to sign tx");
 
             // add to mempool
-            bool ok = ctx->mempool->add(tx, fee);
-            if (!ok) throw std::runtime_error("mempool rejected tx");
+            AcceptResult accepted = ctx->acceptor->accept(tx);
+            if (accepted.status != AcceptStatus::Accepted)
+                throw std::runtime_error(std::string("mempool rejected tx: ") + acceptStatusName(accepted.status));
 
             // return tx hex
             std::vector<uint8_t> buf;
@@ -450,6 +587,157 @@ std::string handleRpcRequest(const std::string& request, RpcContext* ctx) {
             return resp.dump();
         }
 
+        if (method == "blockchain.getchainstats") {
+            if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
+            uint64_t tip = ctx->chain->getHeight();
+            uint64_t start = tip, count = 1;
+            if (params.is_object()) {
+                if (params.contains("start")) start = params["start"].get<uint64_t>();
+                if (params.contains("count")) count = params["count"].get<uint64_t>();
+            } else if (params.is_array() && params.size() >= 1) {
+                start = params[0].get<uint64_t>();
+                if (params.size() >= 2) count = params[1].get<uint64_t>();
+            }
+            if (count > MAX_CHAIN_STATS_RANGE) throw std::runtime_error("count too large (max 1000)");
+            json arr = json::array();
+            for (const auto& st : ctx->chain->getChainStatsRange(start, count))
+                arr.push_back(chainStatsToJson(st));
+            resp["result"] = arr;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.getchaintxstats") {
+            if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
+            uint64_t tip = ctx->chain->getHeight();
+            uint64_t window = 144; // ~1 day of blocks
+            if (params.is_object() && params.contains("blocks")) window = params["blocks"].get<uint64_t>();
+            else if (params.is_array() && params.size() >= 1) window = params[0].get<uint64_t>();
+            if (window == 0 || window > tip) window = tip;
+            auto last = ctx->chain->getChainStats(tip);
+            auto first = ctx->chain->getChainStats(tip - window);
+            if (!last || !first) throw std::runtime_error("chain stats unavailable");
+            json r = json::object();
+            uint64_t txs = last->totalTxCount - first->totalTxCount;
+            uint64_t elapsed = last->timestamp > first->timestamp ? last->timestamp - first->timestamp : 0;
+            r["height"] = tip;
+            r["window_blocks"] = window;
+            r["window_txcount"] = txs;
+            r["window_interval"] = elapsed;
+            r["txcount"] = last->totalTxCount;
+            if (elapsed > 0) r["txrate"] = static_cast<double>(txs) / static_cast<double>(elapsed);
+            resp["result"] = r;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.getaddressutxos") {
+            if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
+            const AddressIndex* index = ctx->chain->addressIndex();
+            if (!index) throw std::runtime_error("address index not enabled (addressindex=1)");
+            json list = params;
+            if (params.is_object() && params.contains("addresses")) list = params["addresses"];
+            if (!list.is_array() || list.size() == 0) throw std::runtime_error("params: [address, ...] or {\"addresses\": [...]}");
+            if (list.size() > MAX_ADDRESS_QUERY) throw std::runtime_error("too many addresses (max 1000)");
+            json arr = json::array();
+            for (size_t i = 0; i < list.size(); ++i) {
+                std::string addr = list[(int)i].get<std::string>();
+                std::vector<uint8_t> h = addressToPubKeyHash(addr);
+                if (h.size() != 20) throw std::runtime_error("invalid address: " + addr);
+                Hash160 key;
+                std::copy(h.begin(), h.end(), key.begin());
+                json coins = json::array();
+                uint64_t balance = 0;
+                for (const auto& e : index->get(key)) {
+                    json c;
+                    c["txid"] = uint256ToHex(e.outpoint.hash);
+                    c["vout"] = e.outpoint.index;
+                    c["amount"] = e.amount;
+                    coins.push_back(c);
+                    balance += e.amount;
+                }
+                json obj;
+                obj["address"] = addr;
+                obj["balance"] = balance;
+                obj["utxos"] = coins;
+                arr.push_back(obj);
+            }
+            resp["result"] = arr;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.gettxoutsetinfo") {
+            if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
+            UTXOSetInfo info = ctx->chain->getUTXOSetInfo();
+            json r;
+            r["height"] = info.height;
+            r["bestblock"] = uint256ToHex(info.bestBlock);
+            r["txouts"] = info.stats.coinCount;
+            r["total_amount"] = info.stats.totalAmount;
+            r["muhash"] = uint256ToHex(info.stats.muhash.digest());
+            resp["result"] = r;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.estimatefee") {
+            if (!ctx || !ctx->feeEstimator) throw std::runtime_error("no fee estimator");
+            unsigned blocks = FeeEstimator::DEFAULT_TARGET;
+            if (params.is_object() && params.contains("blocks")) blocks = (unsigned)params["blocks"].get<uint64_t>();
+            if (blocks < 1 || blocks > FeeEstimator::MAX_TARGET)
+                throw std::runtime_error("blocks must be 1-" + std::to_string(FeeEstimator::MAX_TARGET));
+            std::optional<uint64_t> rate = ctx->feeEstimator->estimateFee(blocks);
+            if (!rate) throw std::runtime_error("insufficient data for an estimate");
+            json r;
+            r["feerate"] = *rate;
+            r["blocks"] = (uint64_t)blocks;
+            resp["result"] = r;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.sendrawtransaction") {
+            if (!ctx || !ctx->acceptor) throw std::runtime_error("no mempool");
+            if (!params.is_object() || !params.contains("hex")) throw std::runtime_error("missing hex");
+            std::vector<uint8_t> raw = shawncoin::hexDecode(params["hex"].get<std::string>());
+            Transaction tx;
+            size_t pos = 0;
+            if (raw.empty() || !deserializeTransaction(raw.data(), raw.size(), pos, tx) || pos != raw.size())
+                throw std::runtime_error("failed to deserialize transaction");
+            AcceptResult accepted = ctx->acceptor->accept(tx);
+            if (accepted.status != AcceptStatus::Accepted)
+                throw std::runtime_error(std::string("transaction rejected: ") + acceptStatusName(accepted.status));
+            json r;
+            r["txid"] = uint256ToHex(tx.getTxid());
+            r["fee"] = accepted.fee;
+            resp["result"] = r;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
+        if (method == "blockchain.dumputxoset" || method == "blockchain.loadutxoset") {
+            if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
+            if (!params.is_object() || !params.contains("path")) throw std::runtime_error("missing path");
+            std::string path = params["path"].get<std::string>();
+            UTXOSnapshotMeta meta;
+            if (method == "blockchain.dumputxoset") {
+                if (!ctx->chain->dumpUTXOSet(path, meta)) throw std::runtime_error("failed to write snapshot");
+            } else if (!ctx->chain->loadUTXOSet(path, meta)) {
+                throw std::runtime_error("failed to load snapshot");
+            }
+            json r;
+            r["path"] = path;
+            r["blockhash"] = uint256ToHex(meta.blockHash);
+            r["height"] = meta.height;
+            r["coins"] = meta.coinCount;
+            r["muhash"] = uint256ToHex(meta.setHash);
+            r["total_supply"] = meta.totalSupply;
+            resp["result"] = r;
+            resp["id"] = id;
+            return resp.dump();
+        }
+
         if (method == "mining.getblocktemplate") {
             if (!ctx || !ctx->chain) throw std::runtime_error("no chain");
             json t;
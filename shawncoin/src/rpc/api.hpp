@@ -11,10 +11,14 @@ namespace shawncoin {
 
 class Wallet;
 class Miner;
+class MempoolAcceptor;
+class FeeEstimator;
 
 struct RpcContext {
     Blockchain* chain = nullptr;
     Mempool* mempool = nullptr;
+    MempoolAcceptor* acceptor = nullptr; // checks and admits transactions to mempool
+    FeeEstimator* feeEstimator = nullptr;
     Wallet* wallet = nullptr;
     Miner* miner = nullptr;
     // RPC credentials (optional)
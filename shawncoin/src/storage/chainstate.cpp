@@ -47,6 +47,21 @@ bool MemoryChainState::putBlock(const uint256& hash, const Block& block) {
     return true;
 }
 
+bool MemoryChainState::getUndo(const uint256& hash, BlockUndo& undo) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = undo_.find(hash);
+    if (it == undo_.end()) return false;
+    return deserializeBlockUndo(it->second.data(), it->second.size(), undo);
+}
+
+bool MemoryChainState::putUndo(const uint256& hash, const BlockUndo& undo) {
+    std::vector<uint8_t> data;
+    serializeBlockUndo(undo, data);
+    std::lock_guard<std::mutex> lock(mutex_);
+    undo_[hash] = std::move(data);
+    return true;
+}
+
 // Enhanced persistence methods
 bool MemoryChainState::saveToDisk() const {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -3,6 +3,7 @@
 
 #include "../core/types.hpp"
 #include "../core/block.hpp"
+#include "../core/undo.hpp"
 #include <string>
 #include <cstdint>
 #include <map>
@@ -21,6 +22,8 @@ public:
     virtual void setBestBlock(const uint256& hash, uint64_t height) = 0;
     virtual bool getBlock(const uint256& hash, Block& block) const = 0;
     virtual bool putBlock(const uint256& hash, const Block& block) = 0;
+    virtual bool getUndo(const uint256& hash, BlockUndo& undo) const = 0;
+    virtual bool putUndo(const uint256& hash, const BlockUndo& undo) = 0;
 };
 
 /** In-memory chain state (no persistence). */
@@ -33,6 +36,8 @@ public:
     void setBestBlock(const uint256& hash, uint64_t height) override;
     bool getBlock(const uint256& hash, Block& block) const override;
     bool putBlock(const uint256& hash, const Block& block) override;
+    bool getUndo(const uint256& hash, BlockUndo& undo) const override;
+    bool putUndo(const uint256& hash, const BlockUndo& undo) override;
     bool saveToDisk() const;
     bool loadFromDisk();
 private:
@@ -40,6 +45,7 @@ private:
     uint256 bestHash_;
     uint64_t bestHeight_ = 0;
     std::map<uint256, std::vector<uint8_t>> blocks_;
+    std::map<uint256, std::vector<uint8_t>> undo_;
     mutable std::mutex mutex_;
 };
 
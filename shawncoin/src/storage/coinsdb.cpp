@@ -0,0 +1,133 @@
+#include "storage/coinsdb.hpp"
+#include "util/logger.hpp"
+#include "util/serialize.hpp"
+#include <cstring>
+
+namespace shawncoin {
+
+namespace {
+
+const char COIN_PREFIX = 'c';
+const char* const BEST_BLOCK_KEY = "B";
+const char* const COIN_COUNT_KEY = "N";
+const char* const TOTAL_AMOUNT_KEY = "A";
+const char* const MUHASH_KEY = "M";
+
+std::string serializeU64String(uint64_t v) {
+    std::vector<uint8_t> out;
+    serializeU64(out, v);
+    return std::string(out.begin(), out.end());
+}
+
+bool readU64(const Database& db, const char* key, uint64_t& v) {
+    std::string value;
+    if (!db.get(key, value) || value.size() != 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)(uint8_t)value[i] << (8 * i);
+    return true;
+}
+
+std::string serializeCoin(const Coin& coin) {
+    std::vector<uint8_t> out;
+    encodeCoin(coin, out);
+    return std::string(out.begin(), out.end());
+}
+
+bool deserializeCoin(const std::string& data, Coin& coin) {
+    size_t used = 0;
+    return decodeCoin(reinterpret_cast<const uint8_t*>(data.data()), data.size(), coin, used) && used == data.size();
+}
+
+} // namespace
+
+std::string coinKey(const OutPoint& out) {
+    std::string key(1 + 32 + 4, '\0');
+    key[0] = COIN_PREFIX;
+    memcpy(&key[1], out.hash.data(), 32);
+    for (int i = 0; i < 4; ++i) key[33 + i] = (char)((out.index >> (24 - 8 * i)) & 0xff);
+    return key;
+}
+
+bool parseCoinKey(const std::string& key, OutPoint& out) {
+    if (key.size() != 37 || key[0] != COIN_PREFIX) return false;
+    memcpy(out.hash.data(), key.data() + 1, 32);
+    out.index = 0;
+    for (int i = 0; i < 4; ++i) out.index = (out.index << 8) | (uint8_t)key[33 + i];
+    return true;
+}
+
+std::optional<Coin> CoinsDB::getCoin(const OutPoint& out) const {
+    std::string value;
+    if (!db_.get(coinKey(out), value)) return std::nullopt;
+    Coin coin;
+    if (!deserializeCoin(value, coin)) return std::nullopt;
+    return coin;
+}
+
+bool CoinsDB::batchWrite(const std::vector<Change>& changes, const uint256& bestBlock, const CoinsStats& stats) {
+    DatabaseBatch batch;
+    for (const auto& c : changes) {
+        if (c.coin) batch.put(coinKey(c.outpoint), serializeCoin(*c.coin));
+        else batch.del(coinKey(c.outpoint));
+    }
+    std::vector<uint8_t> muhash = stats.muhash.serialize();
+    batch.put(COIN_COUNT_KEY, serializeU64String(stats.coinCount));
+    batch.put(TOTAL_AMOUNT_KEY, serializeU64String(stats.totalAmount));
+    batch.put(MUHASH_KEY, std::string(muhash.begin(), muhash.end()));
+    batch.put(BEST_BLOCK_KEY, std::string(bestBlock.begin(), bestBlock.end()));
+    return db_.write(batch);
+}
+
+uint256 CoinsDB::getBestBlock() const {
+    uint256 hash{};
+    std::string value;
+    if (db_.get(BEST_BLOCK_KEY, value) && value.size() == hash.size())
+        memcpy(hash.data(), value.data(), hash.size());
+    return hash;
+}
+
+CoinsStats CoinsDB::getStats() const {
+    CoinsStats stats;
+    std::string muhash;
+    if (readU64(db_, COIN_COUNT_KEY, stats.coinCount) && readU64(db_, TOTAL_AMOUNT_KEY, stats.totalAmount) &&
+        db_.get(MUHASH_KEY, muhash) &&
+        stats.muhash.deserialize(reinterpret_cast<const uint8_t*>(muhash.data()), muhash.size()))
+        return stats;
+    stats = CoinsStats();
+    if (!readU64(db_, COIN_COUNT_KEY, stats.coinCount) || stats.coinCount == 0) return stats;
+    SHAWNCOIN_LOG(Info, "utxo", "Computing totals for %llu coins in the coins database",
+        (unsigned long long)stats.coinCount);
+    stats.coinCount = 0;
+    forEach([&stats](const OutPoint& out, const Coin& coin) {
+        std::vector<uint8_t> data = coinHashData(out, coin);
+        stats.muhash.insert(data.data(), data.size());
+        stats.totalAmount += coin.amount;
+        ++stats.coinCount;
+        return true;
+    });
+    return stats;
+}
+
+void CoinsDB::forEach(const Visitor& fn) const {
+    db_.forEach(std::string(1, COIN_PREFIX), [&fn](const std::string& key, const std::string& value) {
+        OutPoint out;
+        Coin coin;
+        if (!parseCoinKey(key, out) || !deserializeCoin(value, coin)) return true;
+        return fn(out, coin);
+    });
+}
+
+bool CoinsDB::clear() {
+    DatabaseBatch batch;
+    db_.forEach(std::string(1, COIN_PREFIX), [&batch](const std::string& key, const std::string&) {
+        batch.del(key);
+        return true;
+    });
+    batch.del(COIN_COUNT_KEY);
+    batch.del(TOTAL_AMOUNT_KEY);
+    batch.del(MUHASH_KEY);
+    batch.del(BEST_BLOCK_KEY);
+    return db_.write(batch);
+}
+
+} // namespace shawncoin
@@ -0,0 +1,34 @@
+#ifndef SHAWNCOIN_STORAGE_COINSDB_HPP
+#define SHAWNCOIN_STORAGE_COINSDB_HPP
+
+#include "../core/utxo.hpp"
+#include "database.hpp"
+#include <string>
+
+namespace shawncoin {
+
+/** UTXO backend on a Database: one key per coin plus best-block, coin-count, total-amount
+ *  and MuHash records. */
+class CoinsDB : public CoinsView {
+public:
+    explicit CoinsDB(Database& db) : db_(db) {}
+
+    std::optional<Coin> getCoin(const OutPoint& out) const override;
+    bool batchWrite(const std::vector<Change>& changes, const uint256& bestBlock, const CoinsStats& stats) override;
+    uint256 getBestBlock() const override;
+    /** Stored totals; a database written before totals were kept is scanned once to get them. */
+    CoinsStats getStats() const override;
+    void forEach(const Visitor& fn) const override;
+    bool clear() override;
+
+private:
+    Database& db_;
+};
+
+/** Database key for a coin: 'c' || txid || big-endian index, so iteration is in outpoint order. */
+std::string coinKey(const OutPoint& out);
+bool parseCoinKey(const std::string& key, OutPoint& out);
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_STORAGE_COINSDB_HPP
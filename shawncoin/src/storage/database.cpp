@@ -8,6 +8,7 @@ namespace shawncoin {
 #if defined(HAVE_ROCKSDB)
 #include <rocksdb/db.h>
 #include <rocksdb/options.h>
+#include <rocksdb/write_batch.h>
 
 class RocksDBDatabase : public Database {
 public:
@@ -28,6 +29,20 @@ public:
     bool del(const std::string& key) override {
         return db_->Delete(rocksdb::WriteOptions(), key).ok();
     }
+    bool write(const DatabaseBatch& batch) override {
+        rocksdb::WriteBatch wb;
+        for (const auto& op : batch.ops()) {
+            if (op.erase) wb.Delete(op.key);
+            else wb.Put(op.key, op.value);
+        }
+        return db_->Write(rocksdb::WriteOptions(), &wb).ok();
+    }
+    void forEach(const std::string& prefix, const Visitor& fn) const override {
+        std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions()));
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            if (!fn(it->key().ToString(), it->value().ToString())) break;
+        }
+    }
 private:
     rocksdb::DB* db_ = nullptr;
 };
@@ -58,6 +73,28 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
         return map_.erase(key) > 0;
     }
+    bool write(const DatabaseBatch& batch) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& op : batch.ops()) {
+            if (op.erase) map_.erase(op.key);
+            else map_[op.key] = op.value;
+        }
+        return true;
+    }
+    void forEach(const std::string& prefix, const Visitor& fn) const override {
+        // Re-seek after each key so the visitor runs without the lock (it may read or write)
+        std::string key, value;
+        for (bool first = true;; first = false) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = first ? map_.lower_bound(prefix) : map_.upper_bound(key);
+                if (it == map_.end() || it->first.compare(0, prefix.size(), prefix) != 0) return;
+                key = it->first;
+                value = it->second;
+            }
+            if (!fn(key, value)) return;
+        }
+    }
 private:
     mutable std::mutex mutex_;
     std::map<std::string, std::string> map_;
@@ -6,18 +6,44 @@
 #include <string>
 #include <memory>
 #include <optional>
+#include <functional>
+#include <vector>
 
 namespace shawncoin {
 
+/** Puts and deletes applied together by Database::write. */
+class DatabaseBatch {
+public:
+    struct Op {
+        std::string key;
+        std::string value;
+        bool erase = false;
+    };
+    void put(const std::string& key, const std::string& value) { ops_.push_back({ key, value, false }); }
+    void del(const std::string& key) { ops_.push_back({ key, std::string(), true }); }
+    const std::vector<Op>& ops() const { return ops_; }
+    size_t size() const { return ops_.size(); }
+    void clear() { ops_.clear(); }
+
+private:
+    std::vector<Op> ops_;
+};
+
 /** Database interface (RocksDB implementation when HAVE_ROCKSDB). */
 class Database {
 public:
+    using Visitor = std::function<bool(const std::string& key, const std::string& value)>;
+
     virtual ~Database() = default;
     virtual bool open(const std::string& path) = 0;
     virtual void close() = 0;
     virtual bool get(const std::string& key, std::string& value) const = 0;
     virtual bool put(const std::string& key, const std::string& value) = 0;
     virtual bool del(const std::string& key) = 0;
+    /** Apply all operations of the batch atomically, in order. */
+    virtual bool write(const DatabaseBatch& batch) = 0;
+    /** Visit keys starting with prefix in key order; stops early when fn returns false. */
+    virtual void forEach(const std::string& prefix, const Visitor& fn) const = 0;
 };
 
 /** Create database (RocksDB if available, else null). */
@@ -0,0 +1,117 @@
+#include "storage/mempoolfile.hpp"
+#include "core/mempool.hpp"
+#include "core/mempoolaccept.hpp"
+#include "core/transaction.hpp"
+#include "crypto/hash.h"
+#include "util/logger.hpp"
+#include "util/serialize.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+
+namespace shawncoin {
+
+namespace {
+
+const char MEMPOOL_MAGIC[8] = { 'S', 'H', 'W', 'N', 'M', 'P', 'O', 'L' };
+const size_t HEADER_SIZE = 8 + 4 + 8;
+
+uint64_t readU64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+} // namespace
+
+bool writeMempoolFile(const std::string& path, const Mempool& pool) {
+    std::vector<MempoolEntry> entries = pool.getEntries();
+    std::vector<uint8_t> buf(MEMPOOL_MAGIC, MEMPOOL_MAGIC + 8);
+    serializeU32(buf, MEMPOOL_FILE_VERSION);
+    serializeU64(buf, entries.size());
+    for (const auto& e : entries) {
+        serializeU64(buf, e.fee);
+        serializeU64(buf, (uint64_t)e.time);
+        std::vector<uint8_t> raw;
+        serializeTransaction(e.tx, raw);
+        serializeU32(buf, (uint32_t)raw.size());
+        buf.insert(buf.end(), raw.begin(), raw.end());
+    }
+    unsigned char digest[32];
+    shawncoin_sha256(buf.data(), buf.size(), digest);
+    buf.insert(buf.end(), digest, digest + 32);
+
+    std::string tmp = path + ".tmp";
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if (f) f.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    f.close();
+    if (!f || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        SHAWNCOIN_LOG(Error, "mempool", "Failed to write %s", path.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    SHAWNCOIN_LOG(Info, "mempool", "Saved %zu transactions to %s", entries.size(), path.c_str());
+    return true;
+}
+
+bool readMempoolFile(const std::string& path, std::vector<MempoolFileEntry>& entries) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::vector<uint8_t> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (buf.size() < HEADER_SIZE + 32 || memcmp(buf.data(), MEMPOOL_MAGIC, 8) != 0) {
+        SHAWNCOIN_LOG(Error, "mempool", "%s is not a mempool file", path.c_str());
+        return false;
+    }
+    size_t end = buf.size() - 32;
+    unsigned char digest[32];
+    shawncoin_sha256(buf.data(), end, digest);
+    if (memcmp(digest, buf.data() + end, 32) != 0) {
+        SHAWNCOIN_LOG(Error, "mempool", "%s: checksum mismatch", path.c_str());
+        return false;
+    }
+    uint32_t version = readU32(buf.data() + 8);
+    if (version != MEMPOOL_FILE_VERSION) {
+        SHAWNCOIN_LOG(Error, "mempool", "%s: unsupported version %u", path.c_str(), version);
+        return false;
+    }
+    uint64_t count = readU64(buf.data() + 12);
+    entries.clear();
+    size_t pos = HEADER_SIZE;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (end - pos < 8 + 8 + 4) return false;
+        MempoolFileEntry e;
+        e.fee = readU64(buf.data() + pos);
+        e.time = (int64_t)readU64(buf.data() + pos + 8);
+        uint32_t len = readU32(buf.data() + pos + 16);
+        pos += 20;
+        if (end - pos < len) return false;
+        size_t txPos = 0;
+        if (!deserializeTransaction(buf.data() + pos, len, txPos, e.tx) || txPos != len) return false;
+        pos += len;
+        entries.push_back(std::move(e));
+    }
+    return pos == end;
+}
+
+size_t loadMempoolFile(const std::string& path, MempoolAcceptor& acceptor, const std::atomic<bool>* abort) {
+    std::vector<MempoolFileEntry> entries;
+    if (!readMempoolFile(path, entries)) return 0;
+    int64_t cutoff = (int64_t)std::time(nullptr) - Mempool::EXPIRY_SECONDS;
+    size_t admitted = 0, skipped = 0;
+    for (const auto& e : entries) {
+        if (abort && abort->load()) break;
+        // One at a time: children must find their parents already pooled
+        if (e.time >= cutoff && acceptor.accept(e.tx, e.time).status == AcceptStatus::Accepted) ++admitted;
+        else ++skipped;
+    }
+    SHAWNCOIN_LOG(Info, "mempool", "Loaded %zu transactions from %s (%zu skipped)", admitted, path.c_str(), skipped);
+    return admitted;
+}
+
+} // namespace shawncoin
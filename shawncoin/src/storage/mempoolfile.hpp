@@ -0,0 +1,41 @@
+#ifndef SHAWNCOIN_STORAGE_MEMPOOLFILE_HPP
+#define SHAWNCOIN_STORAGE_MEMPOOLFILE_HPP
+
+#include "../core/types.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shawncoin {
+
+class Mempool;
+class MempoolAcceptor;
+
+/** A pooled transaction as saved across restarts. */
+struct MempoolFileEntry {
+    Transaction tx;
+    uint64_t fee = 0;
+    int64_t time = 0; // unix time it entered the pool
+};
+
+/** mempool.dat: magic, version and entry count, then per entry fee, entry time and the
+ *  serialized transaction, parents before children; a SHA-256 of everything before it ends
+ *  the file. */
+constexpr uint32_t MEMPOOL_FILE_VERSION = 1;
+
+/** Write every pooled transaction to path (via a temporary file, renamed into place). */
+bool writeMempoolFile(const std::string& path, const Mempool& pool);
+
+/** Read and verify path. */
+bool readMempoolFile(const std::string& path, std::vector<MempoolFileEntry>& entries);
+
+/** Pass the transactions saved in path through acceptor, in file order and keeping their
+ *  entry times, skipping those that have expired; the fees are recomputed from the coins
+ *  they spend. Stops early once abort is set. Returns how many were admitted. */
+size_t loadMempoolFile(const std::string& path, MempoolAcceptor& acceptor,
+                       const std::atomic<bool>* abort = nullptr);
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_STORAGE_MEMPOOLFILE_HPP
@@ -0,0 +1,281 @@
+#include "storage/utxosnapshot.hpp"
+#include "core/utxo.hpp"
+#include "crypto/hash.h"
+#include "util/logger.hpp"
+#include "util/serialize.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shawncoin {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'H', 'W', 'N', 'U', 'T', 'X', 'O' };
+const size_t COINS_PER_SEGMENT = 50000;
+const size_t HEADER_SIZE = 8 + 4 + 32 + 8 + 4 + 8 + 32 + 8 + 8 + 8 + 32 + 4 + 32;
+const size_t SEGMENT_HEADER_SIZE = 4 + 4 + 32;
+
+uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t readU64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+/** Read-only view of a whole file: mmap where available, else read into memory. */
+class MappedFile {
+public:
+    bool open(const std::string& path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+        size_ = (size_t)st.st_size;
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) { ::close(fd); return false; }
+            madvise(p, size_, MADV_SEQUENTIAL);
+            mapped_ = p;
+            data_ = static_cast<const uint8_t*>(p);
+        }
+        ::close(fd);
+        return true;
+#else
+        std::ifstream f(path, std::ios::binary);
+        if (!f) return false;
+        buffer_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        data_ = reinterpret_cast<const uint8_t*>(buffer_.data());
+        size_ = buffer_.size();
+        return true;
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (mapped_) munmap(mapped_, size_);
+#endif
+    }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifndef _WIN32
+    void* mapped_ = nullptr;
+#else
+    std::string buffer_;
+#endif
+};
+
+struct Segment {
+    const uint8_t* payload = nullptr;
+    uint32_t coins = 0;
+    uint32_t bytes = 0;
+    const uint8_t* checksum = nullptr;
+};
+
+bool decodeSegment(const Segment& seg, std::vector<std::pair<OutPoint, Coin>>& out, MuHash3072& muhash) {
+    unsigned char digest[32];
+    shawncoin_sha256(seg.payload, seg.bytes, digest);
+    if (memcmp(digest, seg.checksum, 32) != 0) return false;
+    out.clear();
+    out.reserve(seg.coins);
+    size_t pos = 0;
+    for (uint32_t i = 0; i < seg.coins; ++i) {
+        if (seg.bytes - pos < 36) return false;
+        OutPoint op;
+        memcpy(op.hash.data(), seg.payload + pos, 32);
+        op.index = readU32(seg.payload + pos + 32);
+        pos += 36;
+        Coin coin;
+        size_t used = 0;
+        if (!decodeCoin(seg.payload + pos, seg.bytes - pos, coin, used)) return false;
+        pos += used;
+        if (!out.empty() && !(out.back().first < op)) return false; // must be strictly sorted
+        std::vector<uint8_t> data = coinHashData(op, coin);
+        muhash.insert(data.data(), data.size());
+        out.emplace_back(op, std::move(coin));
+    }
+    return pos == seg.bytes;
+}
+
+} // namespace
+
+bool writeUTXOSnapshot(const std::string& path, UTXOSnapshotMeta& meta, const UTXOSet& utxo) {
+    // Encode into one arena and sort an index over it, rather than holding a Coin per entry
+    struct Ref {
+        OutPoint out;
+        size_t offset;
+        uint32_t length;
+    };
+    std::vector<uint8_t> arena;
+    std::vector<Ref> refs;
+    refs.reserve(utxo.size());
+    utxo.forEach([&](const OutPoint& out, const Coin& coin) {
+        size_t start = arena.size();
+        encodeCoin(coin, arena);
+        refs.push_back({ out, start, (uint32_t)(arena.size() - start) });
+        return true;
+    });
+    std::sort(refs.begin(), refs.end(), [](const Ref& a, const Ref& b) { return a.out < b.out; });
+    meta.coinCount = refs.size();
+
+    std::string tmp = path + ".tmp";
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if (!f) {
+        SHAWNCOIN_LOG(Error, "utxo", "Cannot create snapshot file %s", tmp.c_str());
+        return false;
+    }
+    uint32_t segments = (uint32_t)((refs.size() + COINS_PER_SEGMENT - 1) / COINS_PER_SEGMENT);
+    std::vector<uint8_t> header(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8);
+    serializeU32(header, UTXO_SNAPSHOT_VERSION);
+    serializeUint256(header, meta.blockHash);
+    serializeU64(header, meta.height);
+    serializeU32(header, meta.bits);
+    serializeU64(header, meta.timestamp);
+    serializeUint256(header, meta.chainWork);
+    serializeU64(header, meta.coinCount);
+    serializeU64(header, meta.totalSupply);
+    serializeU64(header, meta.totalTxCount);
+    serializeUint256(header, meta.setHash);
+    serializeU32(header, segments);
+    unsigned char digest[32];
+    shawncoin_sha256(header.data(), header.size(), digest);
+    header.insert(header.end(), digest, digest + 32);
+    f.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    std::vector<uint8_t> payload;
+    for (size_t start = 0; start < refs.size(); start += COINS_PER_SEGMENT) {
+        size_t end = std::min(refs.size(), start + COINS_PER_SEGMENT);
+        payload.clear();
+        for (size_t i = start; i < end; ++i) {
+            serializeUint256(payload, refs[i].out.hash);
+            serializeU32(payload, refs[i].out.index);
+            payload.insert(payload.end(), arena.begin() + refs[i].offset, arena.begin() + refs[i].offset + refs[i].length);
+        }
+        std::vector<uint8_t> seg;
+        serializeU32(seg, (uint32_t)(end - start));
+        serializeU32(seg, (uint32_t)payload.size());
+        shawncoin_sha256(payload.data(), payload.size(), digest);
+        seg.insert(seg.end(), digest, digest + 32);
+        f.write(reinterpret_cast<const char*>(seg.data()), seg.size());
+        f.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    }
+    f.close();
+    if (!f || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        SHAWNCOIN_LOG(Error, "utxo", "Failed to write snapshot %s", path.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    SHAWNCOIN_LOG(Info, "utxo", "Wrote UTXO snapshot %s: %llu coins in %u segments at height %llu", path.c_str(),
+        (unsigned long long)meta.coinCount, segments, (unsigned long long)meta.height);
+    return true;
+}
+
+bool readUTXOSnapshot(const std::string& path, UTXOSnapshotMeta& meta,
+                      std::vector<std::vector<std::pair<OutPoint, Coin>>>& coins, unsigned threads) {
+    MappedFile file;
+    if (!file.open(path)) {
+        SHAWNCOIN_LOG(Error, "utxo", "Cannot open snapshot %s", path.c_str());
+        return false;
+    }
+    const uint8_t* p = file.data();
+    size_t size = file.size();
+    if (size < HEADER_SIZE || memcmp(p, SNAPSHOT_MAGIC, 8) != 0) {
+        SHAWNCOIN_LOG(Error, "utxo", "%s is not a UTXO snapshot", path.c_str());
+        return false;
+    }
+    unsigned char digest[32];
+    shawncoin_sha256(p, HEADER_SIZE - 32, digest);
+    if (memcmp(digest, p + HEADER_SIZE - 32, 32) != 0) {
+        SHAWNCOIN_LOG(Error, "utxo", "Snapshot %s: header checksum mismatch", path.c_str());
+        return false;
+    }
+    uint32_t version = readU32(p + 8);
+    if (version != UTXO_SNAPSHOT_VERSION) {
+        SHAWNCOIN_LOG(Error, "utxo", "Snapshot %s: unsupported version %u", path.c_str(), version);
+        return false;
+    }
+    size_t pos = 12;
+    memcpy(meta.blockHash.data(), p + pos, 32); pos += 32;
+    meta.height = readU64(p + pos); pos += 8;
+    meta.bits = readU32(p + pos); pos += 4;
+    meta.timestamp = readU64(p + pos); pos += 8;
+    memcpy(meta.chainWork.data(), p + pos, 32); pos += 32;
+    meta.coinCount = readU64(p + pos); pos += 8;
+    meta.totalSupply = readU64(p + pos); pos += 8;
+    meta.totalTxCount = readU64(p + pos); pos += 8;
+    memcpy(meta.setHash.data(), p + pos, 32); pos += 32;
+    uint32_t segmentCount = readU32(p + pos);
+    pos = HEADER_SIZE;
+
+    // Walk segment headers (cheap, sequential) so the payloads can be decoded in parallel
+    std::vector<Segment> segments;
+    segments.reserve(segmentCount);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < segmentCount; ++i) {
+        if (size - pos < SEGMENT_HEADER_SIZE) break;
+        Segment seg;
+        seg.coins = readU32(p + pos);
+        seg.bytes = readU32(p + pos + 4);
+        seg.checksum = p + pos + 8;
+        pos += SEGMENT_HEADER_SIZE;
+        if (size - pos < seg.bytes) break;
+        seg.payload = p + pos;
+        pos += seg.bytes;
+        total += seg.coins;
+        segments.push_back(seg);
+    }
+    if (segments.size() != segmentCount || pos != size || total != meta.coinCount) {
+        SHAWNCOIN_LOG(Error, "utxo", "Snapshot %s is truncated or malformed", path.c_str());
+        return false;
+    }
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, std::max<size_t>(1, segments.size()));
+    coins.assign(segments.size(), {});
+    std::vector<MuHash3072> hashes(segments.size());
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    auto worker = [&]() {
+        for (size_t i; ok && (i = next++) < segments.size();) {
+            if (!decodeSegment(segments[i], coins[i], hashes[i])) ok = false;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    for (size_t i = 1; ok && i < coins.size(); ++i) {
+        if (!coins[i - 1].empty() && !coins[i].empty() && !(coins[i - 1].back().first < coins[i].front().first)) ok = false;
+    }
+    if (!ok) {
+        SHAWNCOIN_LOG(Error, "utxo", "Snapshot %s: corrupt segment", path.c_str());
+        coins.clear();
+        return false;
+    }
+    MuHash3072 muhash;
+    for (const auto& h : hashes) muhash *= h;
+    if (muhash.digest() != meta.setHash) {
+        SHAWNCOIN_LOG(Error, "utxo", "Snapshot %s: coins do not match the set hash", path.c_str());
+        coins.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace shawncoin
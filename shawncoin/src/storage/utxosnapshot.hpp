@@ -0,0 +1,53 @@
+#ifndef SHAWNCOIN_STORAGE_UTXOSNAPSHOT_HPP
+#define SHAWNCOIN_STORAGE_UTXOSNAPSHOT_HPP
+
+#include "../core/types.hpp"
+#include "../core/coin.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace shawncoin {
+
+class UTXOSet;
+
+/** Block a UTXO snapshot was taken at, with what a node needs to continue from it. */
+struct UTXOSnapshotMeta {
+    uint256 blockHash{};
+    uint64_t height = 0;
+    uint32_t bits = 0;
+    uint64_t timestamp = 0;
+    uint256 chainWork{};
+    uint64_t coinCount = 0;
+    uint64_t totalSupply = 0;
+    uint64_t totalTxCount = 0;
+    uint256 setHash{}; // MuHash digest of the coins (CoinsStats::muhash), checked on load
+};
+
+/** A snapshot the node is told to trust. A node at genesis only adopts a snapshot block it
+ *  has never seen if it is listed here with the same height and coins hash (the MuHash
+ *  digest, which loading checks against the coins actually read). */
+struct TrustedSnapshot {
+    uint256 blockHash{};
+    uint64_t height = 0;
+    uint256 setHash{};
+};
+
+/** Snapshot file: versioned header (with its own SHA-256) followed by segments of coins sorted
+ *  by outpoint, each carrying its coin count, byte length and SHA-256, so segments can be
+ *  verified and decoded independently. */
+constexpr uint32_t UTXO_SNAPSHOT_VERSION = 2;
+
+/** Write every coin of utxo to path; meta.coinCount is filled in, meta.setHash must be set. */
+bool writeUTXOSnapshot(const std::string& path, UTXOSnapshotMeta& meta, const UTXOSet& utxo);
+
+/** Map path, verify it, and decode its segments on up to threads workers (0: one per core).
+ *  The decoded coins must hash to meta.setHash. On success coins holds one sorted vector
+ *  per segment. */
+bool readUTXOSnapshot(const std::string& path, UTXOSnapshotMeta& meta,
+                      std::vector<std::vector<std::pair<OutPoint, Coin>>>& coins, unsigned threads = 0);
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_STORAGE_UTXOSNAPSHOT_HPP
@@ -0,0 +1,55 @@
+#include "util/checkqueue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace shawncoin {
+
+namespace {
+
+unsigned defaultWorkers(unsigned threads) {
+    if (threads) return threads;
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+} // namespace
+
+CheckQueue::CheckQueue(unsigned threads) : pool_(defaultWorkers(threads)) {}
+
+bool CheckQueue::run(size_t count, const std::function<bool(size_t)>& check) {
+    if (count == 0) return true;
+    std::lock_guard<std::mutex> lock(runMutex_);
+    std::atomic<size_t> next{ 0 };
+    std::atomic<bool> failed{ false };
+    auto work = [&]() {
+        while (!failed.load(std::memory_order_relaxed)) {
+            size_t begin = next.fetch_add(BATCH_SIZE, std::memory_order_relaxed);
+            if (begin >= count) return;
+            size_t end = std::min(count, begin + BATCH_SIZE);
+            for (size_t i = begin; i < end; ++i) {
+                bool ok = false;
+                try {
+                    ok = check(i);
+                } catch (...) {
+                }
+                if (!ok) {
+                    failed.store(true, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+    };
+    // No point waking more workers than there are batches beyond the caller's first
+    size_t batches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+    size_t helpers = std::min(pool_.threads(), batches - 1);
+    std::vector<std::future<void>> done;
+    done.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i) done.push_back(pool_.submit(work));
+    work();
+    for (auto& f : done) f.wait(); // they share this frame's counters
+    return !failed.load();
+}
+
+} // namespace shawncoin
@@ -0,0 +1,36 @@
+#ifndef SHAWNCOIN_UTIL_CHECKQUEUE_HPP
+#define SHAWNCOIN_UTIL_CHECKQUEUE_HPP
+
+#include "util/threadpool.hpp"
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace shawncoin {
+
+/** Runs a batch of independent checks (such as the input signatures of a block) on a worker
+ *  pool, with the calling thread taking checks too. Workers claim a few checks at a time from
+ *  a shared counter; once one fails no more are handed out. One batch runs at a time. */
+class CheckQueue {
+public:
+    /** Checks claimed per grab of the shared counter. */
+    static constexpr size_t BATCH_SIZE = 4;
+
+    /** Start threads workers besides the caller (0: one per core, less the caller's). */
+    explicit CheckQueue(unsigned threads = 0);
+
+    /** Run check(i) for i in [0, count); true if every check passed. A check that throws
+     *  counts as failed. */
+    bool run(size_t count, const std::function<bool(size_t)>& check);
+
+    /** Worker threads, not counting the caller. */
+    size_t threads() const { return pool_.threads(); }
+
+private:
+    ThreadPool pool_;
+    std::mutex runMutex_;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_UTIL_CHECKQUEUE_HPP
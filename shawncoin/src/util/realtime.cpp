@@ -1,31 +1,146 @@
 #include "util/realtime.hpp"
-#include <fstream>
-#include <cstdlib>
-#include <string>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
 
 namespace shawncoin {
 
-static std::string defaultDataDir() {
-    const char* home = std::getenv("HOME");
-    if (!home) home = "/tmp";
-    std::string dir = std::string(home) + "/.shawncoin";
-    // try to create if missing
-    struct stat st;
-    if (stat(dir.c_str(), &st) != 0) {
-        // attempt create
-        mkdir(dir.c_str(), 0700);
+RealtimeBus::RealtimeBus(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) n <<= 1;
+    slots_.reset(new Slot[n]);
+    for (size_t i = 0; i < n; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+    mask_ = n - 1;
+}
+
+RealtimeBus::~RealtimeBus() {
+    stop();
+}
+
+bool RealtimeBus::publish(std::string event) {
+    // Bounded MPMC ring in the style of Vyukov: a slot whose sequence equals the position is
+    // free for the producer that claims that position; publishing sets it to position + 1
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[pos & mask_];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed); // full
+            return false;
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->event = std::move(event);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool RealtimeBus::pop(std::string& event) {
+    Slot& slot = slots_[tail_ & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+    event = std::move(slot.event);
+    slot.event.clear();
+    slot.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+}
+
+size_t RealtimeBus::drain() {
+    std::lock_guard<std::mutex> lock(drainMutex_);
+    std::string batch, event;
+    size_t count = 0;
+    std::vector<Subscriber> subscribers;
+    {
+        std::lock_guard<std::mutex> sl(subscribersMutex_);
+        for (const auto& kv : subscribers_) subscribers.push_back(kv.second);
+    }
+    while (pop(event)) {
+        for (const auto& fn : subscribers) fn(event);
+        batch += event;
+        batch += '\n';
+        ++count;
+    }
+    if (count) writeBatch(batch);
+    return count;
+}
+
+void RealtimeBus::writeBatch(const std::string& batch) {
+    if (!feed_.is_open()) return;
+    if (feedBytes_ > 0 && feedBytes_ + batch.size() > MAX_FEED_BYTES) {
+        feed_.close();
+        std::string rotated = feedPath_ + ".1";
+        std::remove(rotated.c_str());
+        std::rename(feedPath_.c_str(), rotated.c_str());
+        feed_.open(feedPath_, std::ios::trunc);
+        feedBytes_ = 0;
     }
-    return dir;
+    feed_.write(batch.data(), (std::streamsize)batch.size());
+    feed_.flush();
+    feedBytes_ += batch.size();
+}
+
+void RealtimeBus::start(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(runMutex_);
+    if (writer_.joinable()) return;
+    if (!dir.empty()) {
+        std::lock_guard<std::mutex> dl(drainMutex_);
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        feedPath_ = dir + "/realtime_feed.log";
+        feed_.open(feedPath_, std::ios::app);
+        feedBytes_ = (size_t)std::filesystem::file_size(feedPath_, ec);
+        if (ec) feedBytes_ = 0;
+    }
+    stopping_ = false;
+    writer_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(runMutex_);
+        while (!stopping_) {
+            stopCv_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    });
+}
+
+void RealtimeBus::stop() {
+    {
+        std::lock_guard<std::mutex> lock(runMutex_);
+        if (!writer_.joinable()) return;
+        stopping_ = true;
+    }
+    stopCv_.notify_all();
+    writer_.join();
+    drain();
+    std::lock_guard<std::mutex> lock(drainMutex_);
+    feed_.close();
+}
+
+size_t RealtimeBus::subscribe(Subscriber fn) {
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    size_t id = nextSubscriber_++;
+    subscribers_[id] = std::move(fn);
+    return id;
+}
+
+void RealtimeBus::unsubscribe(size_t id) {
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    subscribers_.erase(id);
+}
+
+RealtimeBus& realtimeBus() {
+    static RealtimeBus bus;
+    return bus;
 }
 
-void appendRealtimeEvent(const std::string& jsonLine) {
-    std::string dir = defaultDataDir();
-    std::string path = dir + "/realtime_feed.log";
-    std::ofstream f(path, std::ios::app);
-    if (!f) return;
-    f << jsonLine << "\n";
+void appendRealtimeEvent(std::string jsonLine) {
+    realtimeBus().publish(std::move(jsonLine));
 }
 
 } // namespace shawncoin
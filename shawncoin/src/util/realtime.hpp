@@ -1,12 +1,90 @@
 #ifndef SHAWNCOIN_UTIL_REALTIME_HPP
 #define SHAWNCOIN_UTIL_REALTIME_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace shawncoin {
 
-// Append a single-line JSON event to the realtime feed file (~/.shawncoin/realtime_feed.log).
-void appendRealtimeEvent(const std::string& jsonLine);
+/** Realtime feed of single-line JSON events (new transactions, mined blocks). Producers push
+ *  into a bounded lock-free ring (one compare-and-swap, no allocation beyond the event string
+ *  itself, no syscalls); when it is full the event is dropped and counted rather than making
+ *  the producer wait. A background writer drains the ring every FLUSH_INTERVAL_MS, hands each
+ *  event to in-process subscribers and appends the batch to realtime_feed.log with a single
+ *  write, rotating the file to realtime_feed.log.1 once it passes MAX_FEED_BYTES. */
+class RealtimeBus {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096; // rounded up to a power of two
+    static constexpr size_t MAX_FEED_BYTES = 16 * 1024 * 1024;
+    static constexpr int FLUSH_INTERVAL_MS = 50;
+    using Subscriber = std::function<void(const std::string&)>;
+
+    explicit RealtimeBus(size_t capacity = DEFAULT_CAPACITY);
+    ~RealtimeBus();
+    RealtimeBus(const RealtimeBus&) = delete;
+    RealtimeBus& operator=(const RealtimeBus&) = delete;
+
+    /** Queue an event; false if the ring was full and it was dropped. Safe from any thread. */
+    bool publish(std::string event);
+
+    /** Start the writer, appending to dir/realtime_feed.log (empty dir: subscribers only). */
+    void start(const std::string& dir);
+    /** Deliver what is queued and stop the writer. */
+    void stop();
+    /** Deliver queued events now; returns how many. The writer calls this; so can tests. */
+    size_t drain();
+
+    /** Call fn from the writer thread for every event; it must not (un)subscribe. */
+    size_t subscribe(Subscriber fn);
+    void unsubscribe(size_t id);
+
+    /** Events dropped because the ring was full. */
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq{ 0 };
+        std::string event;
+    };
+
+    bool pop(std::string& event);
+    void writeBatch(const std::string& batch);
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{ 0 }; // next position producers claim
+    alignas(64) size_t tail_ = 0;               // next position to drain (under drainMutex_)
+    std::atomic<uint64_t> dropped_{ 0 };
+
+    std::mutex drainMutex_;
+    std::ofstream feed_;
+    std::string feedPath_;
+    size_t feedBytes_ = 0;
+
+    std::mutex subscribersMutex_;
+    std::map<size_t, Subscriber> subscribers_;
+    size_t nextSubscriber_ = 1;
+
+    std::mutex runMutex_;
+    std::condition_variable stopCv_;
+    bool stopping_ = false;
+    std::thread writer_;
+};
+
+/** The process-wide feed. */
+RealtimeBus& realtimeBus();
+
+/** Publish a single-line JSON event to the realtime feed. */
+void appendRealtimeEvent(std::string jsonLine);
 
 } // namespace shawncoin
 
@@ -0,0 +1,54 @@
+#ifndef SHAWNCOIN_UTIL_THREADPOOL_HPP
+#define SHAWNCOIN_UTIL_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace shawncoin {
+
+/** Fixed set of worker threads running queued tasks in FIFO order. Tasks still queued when
+ *  the pool is destroyed are run before the workers exit. */
+class ThreadPool {
+public:
+    /** Start threads workers (0: one per core). */
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** Queue fn; the future yields its result, or rethrows what it threw. */
+    template <typename F>
+    auto submit(F&& fn) -> std::future<typename std::invoke_result<F>::type> {
+        using R = typename std::invoke_result<F>::type;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    size_t threads() const { return workers_.size(); }
+    /** Tasks waiting for a worker. */
+    size_t pending() const;
+
+private:
+    void enqueue(std::function<void()> job);
+    void work();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> queue_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+} // namespace shawncoin
+
+#endif // SHAWNCOIN_UTIL_THREADPOOL_HPP
@@ -2,6 +2,7 @@
 #include "wallet/mnemonic.hpp"
 #include "core/utxo.hpp"
 #include "crypto/keys.h"
+#include "crypto/schnorr.h"
 #include "crypto/signatures.h"
 #include "crypto/hash.h"
 #include "crypto/address.hpp"
@@ -100,8 +101,11 @@ bool Wallet::signTransaction(Transaction& tx, const UTXOSet* utxo) {
         if (priv.size() != 32) return false;
         shawncoin_keypair_t* kp = shawncoin_keypair_from_priv(priv.data());
         if (!kp) return false;
-        unsigned char sig[128]; size_t siglen = sizeof(sig);
-        if (shawncoin_sign(kp, hash, sig, &siglen) != 1) {
+        // Version 2 transactions carry Schnorr signatures
+        bool schnorr = tx.version == TX_VERSION_SCHNORR;
+        unsigned char sig[128]; size_t siglen = schnorr ? SHAWNCOIN_SCHNORR_SIG_LEN : sizeof(sig);
+        int signedOk = schnorr ? shawncoin_schnorr_sign(kp, hash, sig) : shawncoin_sign(kp, hash, sig, &siglen);
+        if (signedOk != 1) {
             shawncoin_keypair_destroy(kp);
             return false;
         }
@@ -147,9 +151,7 @@ bool Wallet::hasHash160(const std::vector<uint8_t>& h) const {
 uint64_t Wallet::getBalance(const UTXOSet* utxo) const {
     if (!utxo) return 0;
     uint64_t sum = 0;
-    auto snap = utxo->snapshot();
-    for (const auto& it : snap) {
-        const UTXOSet::Entry& e = it.second;
+    utxo->forEach([&](const OutPoint&, const UTXOSet::Entry& e) {
         const Script& s = e.script_pubkey;
         // Recognize simple P2PKH: OP_DUP OP_HASH160 PUSH20 <20> OP_EQUALVERIFY OP_CHECKSIG
         if (s.size() == 25 && s[0] == 0x76 && s[1] == 0xa9 && s[2] == 0x14 && s[23] == 0x88 && s[24] == 0xac) {
@@ -164,7 +166,8 @@ uint64_t Wallet::getBalance(const UTXOSet* utxo) const {
                 }
             }
         }
-    }
+        return true;
+    });
     return sum;
 }
 
@@ -2,10 +2,47 @@
 #include "core/blockchain.hpp"
 #include "core/block.hpp"
 #include "core/types.hpp"
+#include "core/consensus.hpp"
+#include "core/mempool.hpp"
+#include "mining/difficulty.hpp"
+#include "mining/merkle.hpp"
+#include "storage/utxosnapshot.hpp"
+#include "crypto/hash.h"
+#include "crypto/keys.h"
+#include "crypto/schnorr.h"
+#include "crypto/signatures.h"
+#include "core/sigcache.hpp"
+#include "util/checkqueue.hpp"
 #include "util/util.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
 
 using namespace shawncoin;
 
+// Build and mine a block with a single coinbase on top of prev; tag keeps coinbases distinct.
+static Block mineChild(const uint256& prev, uint8_t tag) {
+    Block block;
+    block.header.version = 1;
+    block.header.previous_hash = prev;
+    block.header.timestamp = (uint64_t)std::time(nullptr);
+    block.header.difficulty_target = EASY_MINE_DIFFICULTY;
+    Transaction cb;
+    cb.inputs.resize(1);
+    cb.inputs[0].output_index = 0xffffffffu;
+    cb.inputs[0].signature = { tag };
+    cb.outputs.resize(1);
+    cb.outputs[0].amount = getBlockSubsidy(1);
+    cb.outputs[0].script_pubkey = { 0x76, 0xa9, 0x14 };
+    cb.outputs[0].script_pubkey.insert(cb.outputs[0].script_pubkey.end(), 20, tag);
+    cb.outputs[0].script_pubkey.push_back(0x88);
+    cb.outputs[0].script_pubkey.push_back(0xac);
+    block.transactions.push_back(cb);
+    block.header.merkle_root = computeMerkleRoot(block.transactions);
+    while (!checkProofOfWork(block.header)) ++block.header.nonce;
+    return block;
+}
+
 TEST(Blockchain, Genesis) {
     Blockchain chain;
     Block genesis = chain.getGenesisBlock();
@@ -30,3 +67,521 @@ TEST(Types, GetBlockSubsidy) {
     EXPECT_EQ(getBlockSubsidy(419999), 25 * COIN / 2);
     EXPECT_EQ(getBlockSubsidy(420000), 25 * COIN / 4);
 }
+
+TEST(Types, GetTotalSupplyUpTo) {
+    EXPECT_EQ(getTotalSupplyUpTo(0), 25 * COIN);
+    EXPECT_EQ(getTotalSupplyUpTo(209999), 210000 * 25 * COIN);
+    EXPECT_EQ(getTotalSupplyUpTo(210001), 210000 * 25 * COIN + 2 * (25 * COIN / 2));
+}
+
+TEST(Blockchain, ChainStatsFollowTip) {
+    Blockchain chain;
+    Block a1 = mineChild(chain.getBestBlockHash(), 0xa1);
+    ASSERT_TRUE(chain.addBlock(a1, 1));
+    auto st = chain.getChainStats(1);
+    ASSERT_TRUE(st.has_value());
+    EXPECT_EQ(st->txCount, 1u);
+    EXPECT_EQ(st->totalTxCount, 2u);
+    EXPECT_EQ(st->utxoDelta, 1);
+    EXPECT_EQ(st->size, serializeBlock(a1).size());
+    EXPECT_EQ(chain.getTotalSupply(), getBlockSubsidy(0) + a1.transactions[0].getTotalOutput());
+    EXPECT_EQ(chain.getChainStatsRange(0, 10).size(), 2u);
+    EXPECT_FALSE(chain.getChainStats(2).has_value());
+}
+
+TEST(Blockchain, UTXOSnapshotStartsFreshChain) {
+    Blockchain source;
+    uint256 tip = source.getBestBlockHash();
+    for (uint8_t tag = 1; tag <= 3; ++tag) {
+        Block b = mineChild(tip, tag);
+        ASSERT_TRUE(source.addBlock(b, tag));
+        tip = b.getHash();
+    }
+    std::string path = "test_utxo_snapshot.dat";
+    UTXOSnapshotMeta meta;
+    ASSERT_TRUE(source.dumpUTXOSet(path, meta));
+    EXPECT_EQ(meta.blockHash, tip);
+    EXPECT_EQ(meta.coinCount, source.utxo().size());
+
+    // An unknown block is only adopted when trusted with the same height and coins hash
+    Blockchain fresh;
+    UTXOSnapshotMeta loaded;
+    EXPECT_FALSE(fresh.loadUTXOSet(path, loaded));
+    TrustedSnapshot trusted{ meta.blockHash, meta.height, meta.setHash };
+    trusted.setHash[0] ^= 1;
+    fresh.addTrustedSnapshot(trusted);
+    EXPECT_FALSE(fresh.loadUTXOSet(path, loaded));
+    EXPECT_EQ(fresh.getHeight(), 0u);
+    trusted.setHash = meta.setHash;
+    fresh.addTrustedSnapshot(trusted);
+    ASSERT_TRUE(fresh.loadUTXOSet(path, loaded));
+    EXPECT_EQ(fresh.getBestBlockHash(), tip);
+    EXPECT_EQ(fresh.getHeight(), 3u);
+    EXPECT_EQ(fresh.utxo().size(), source.utxo().size());
+    EXPECT_EQ(fresh.getTotalSupply(), source.getTotalSupply());
+    Block next = mineChild(tip, 4);
+    EXPECT_TRUE(fresh.addBlock(next, 4));
+    EXPECT_EQ(fresh.getHeight(), 4u);
+
+    // Already past genesis on another chain: refused
+    Blockchain other;
+    other.addTrustedSnapshot(trusted);
+    ASSERT_TRUE(other.addBlock(mineChild(other.getBestBlockHash(), 9), 1));
+    EXPECT_FALSE(other.loadUTXOSet(path, loaded));
+
+    // A flipped payload byte fails its segment checksum
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(-1, std::ios::end);
+        char c = 0;
+        f.read(&c, 1);
+        f.seekp(-1, std::ios::end);
+        c ^= 1;
+        f.write(&c, 1);
+    }
+    Blockchain corrupt;
+    corrupt.addTrustedSnapshot(trusted);
+    EXPECT_FALSE(corrupt.loadUTXOSet(path, loaded));
+    EXPECT_EQ(corrupt.getHeight(), 0u);
+    std::remove(path.c_str());
+}
+
+TEST(Blockchain, SnapshotChainRetargetsWithoutEarlierBlocks) {
+    Blockchain source;
+    Block b = mineChild(source.getBestBlockHash(), 1);
+    ASSERT_TRUE(source.addBlock(b, 1));
+    std::string path = "test_utxo_snapshot_retarget.dat";
+    UTXOSnapshotMeta meta;
+    ASSERT_TRUE(source.dumpUTXOSet(path, meta));
+    // Claim a base just short of the second retarget, whose window starts below it
+    meta.height = 2 * DIFFICULTY_INTERVAL - 2;
+    ASSERT_TRUE(writeUTXOSnapshot(path, meta, source.utxo()));
+
+    Blockchain fresh;
+    fresh.addTrustedSnapshot({ meta.blockHash, meta.height, meta.setHash });
+    UTXOSnapshotMeta loaded;
+    ASSERT_TRUE(fresh.loadUTXOSet(path, loaded));
+    std::remove(path.c_str());
+    EXPECT_FALSE(fresh.getAncestor(fresh.getBestBlockHash(), DIFFICULTY_INTERVAL).has_value());
+    uint256 tip = fresh.getBestBlockHash();
+    for (uint8_t tag = 2; tag <= 4; ++tag) {
+        Block next = mineChild(tip, tag);
+        ASSERT_TRUE(fresh.addBlock(next, meta.height + tag - 1));
+        tip = next.getHash();
+    }
+    EXPECT_EQ(fresh.getHeight(), 2 * DIFFICULTY_INTERVAL + 1);
+}
+
+TEST(Blockchain, ReorgToHeavierBranch) {
+    Blockchain chain;
+    uint256 genesis = chain.getBestBlockHash();
+    Block a1 = mineChild(genesis, 0xa1);
+    Block a2 = mineChild(a1.getHash(), 0xa2);
+    ASSERT_TRUE(chain.addBlock(a1, 1));
+    ASSERT_TRUE(chain.addBlock(a2, 2));
+    EXPECT_EQ(chain.getBestBlockHash(), a2.getHash());
+
+    // Equal-work side branch is stored but does not replace the tip
+    Block b1 = mineChild(genesis, 0xb1);
+    Block b2 = mineChild(b1.getHash(), 0xb2);
+    ASSERT_TRUE(chain.addBlock(b1, 1));
+    ASSERT_TRUE(chain.addBlock(b2, 2));
+    EXPECT_EQ(chain.getBestBlockHash(), a2.getHash());
+    auto side = chain.getBlockIndex(b2.getHash());
+    ASSERT_TRUE(side.has_value());
+    EXPECT_EQ(side->height, 2u);
+
+    // One more block makes branch b heavier: reorganize
+    Block b3 = mineChild(b2.getHash(), 0xb3);
+    ASSERT_TRUE(chain.addBlock(b3, 3));
+    EXPECT_EQ(chain.getBestBlockHash(), b3.getHash());
+    EXPECT_EQ(chain.getHeight(), 3u);
+    EXPECT_EQ(chain.getBlockByHeight(1)->getHash(), b1.getHash());
+    EXPECT_FALSE(chain.utxo().has({ a1.transactions[0].getTxid(), 0 }));
+    EXPECT_TRUE(chain.utxo().has({ b1.transactions[0].getTxid(), 0 }));
+    EXPECT_EQ(chain.getAncestor(b3.getHash(), 1)->hash, b1.getHash());
+    EXPECT_EQ(chain.getAncestor(a2.getHash(), 1)->hash, a1.getHash());
+    EXPECT_EQ(chain.getChainStats(3)->totalTxCount, 4u);
+}
+
+TEST(Blockchain, AddressIndexFollowsReorg) {
+    Blockchain chain;
+    chain.enableAddressIndex();
+    uint256 genesis = chain.getBestBlockHash();
+    Hash160 tagA, tagB;
+    tagA.fill(0xa1);
+    tagB.fill(0xb1);
+    Block a1 = mineChild(genesis, 0xa1);
+    ASSERT_TRUE(chain.addBlock(a1, 1));
+    ASSERT_EQ(chain.addressIndex()->get(tagA).size(), 1u);
+    EXPECT_EQ(chain.addressIndex()->getBalance(tagA), getBlockSubsidy(1));
+
+    Block b1 = mineChild(genesis, 0xb1);
+    Block b2 = mineChild(b1.getHash(), 0xb2);
+    ASSERT_TRUE(chain.addBlock(b1, 1));
+    ASSERT_TRUE(chain.addBlock(b2, 2));
+    EXPECT_TRUE(chain.addressIndex()->get(tagA).empty());
+    ASSERT_EQ(chain.addressIndex()->get(tagB).size(), 1u);
+    EXPECT_EQ(chain.addressIndex()->get(tagB)[0].outpoint.hash, b1.transactions[0].getTxid());
+}
+
+TEST(Blockchain, ConnectVerifiesInputSignatures) {
+    std::vector<unsigned char> priv(32, 0x22);
+    shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+    unsigned char pub[33], h[20];
+    shawncoin_pubkey_get(key, pub);
+    shawncoin_hash160(pub, sizeof(pub), h);
+    Script script = { 0x76, 0xa9, 0x14 };
+    script.insert(script.end(), h, h + 20);
+    script.push_back(0x88);
+    script.push_back(0xac);
+
+    Blockchain chain;
+    CheckQueue queue(2);
+    chain.setCheckQueue(&queue);
+    // A coinbase split into ten outputs to the key, then a block spending all of them
+    Block a1 = mineChild(chain.getBestBlockHash(), 0xa1);
+    Transaction& cb = a1.transactions[0];
+    cb.outputs.assign(10, TxOutput{});
+    for (auto& out : cb.outputs) {
+        out.amount = getBlockSubsidy(1) / 10;
+        out.script_pubkey = script;
+    }
+    cb.cached_txid.reset();
+    a1.header.merkle_root = computeMerkleRoot(a1.transactions);
+    while (!checkProofOfWork(a1.header)) ++a1.header.nonce;
+    ASSERT_TRUE(chain.addBlock(a1, 1));
+
+    Transaction spend;
+    for (uint32_t i = 0; i < 10; ++i) spend.inputs.push_back(TxInput{ cb.getTxid(), i, {}, {} });
+    spend.outputs.resize(1);
+    spend.outputs[0].amount = getBlockSubsidy(1) - 1000;
+    spend.outputs[0].script_pubkey = script;
+    uint256 hash = signatureHash(spend);
+    unsigned char sig[72];
+    size_t sigLen = sizeof(sig);
+    ASSERT_EQ(shawncoin_sign(key, hash.data(), sig, &sigLen), 1);
+    for (auto& in : spend.inputs) {
+        in.signature.assign(sig, sig + sigLen);
+        in.pubkey.assign(pub, pub + 33);
+    }
+    shawncoin_keypair_destroy(key);
+
+    auto withSpend = [&](const Transaction& tx, uint8_t tag) {
+        Block b = mineChild(a1.getHash(), tag);
+        b.transactions.push_back(tx);
+        b.header.merkle_root = computeMerkleRoot(b.transactions);
+        while (!checkProofOfWork(b.header)) ++b.header.nonce;
+        return b;
+    };
+    Transaction forged = spend;
+    forged.inputs[7].signature[10] ^= 1;
+    forged.cached_txid.reset();
+    EXPECT_FALSE(chain.addBlock(withSpend(forged, 0xb2), 2));
+    EXPECT_EQ(chain.getHeight(), 1u);
+    EXPECT_TRUE(chain.utxo().has({ cb.getTxid(), 7 })); // the failed block was rolled back
+
+    Transaction stolen = spend; // valid signature, but not by the key the coins pay to
+    stolen.inputs[3].pubkey[5] ^= 1;
+    stolen.cached_txid.reset();
+    EXPECT_FALSE(chain.addBlock(withSpend(stolen, 0xb3), 2));
+
+    ASSERT_TRUE(chain.addBlock(withSpend(spend, 0xa2), 2));
+    EXPECT_EQ(chain.getHeight(), 2u);
+    EXPECT_FALSE(chain.utxo().has({ cb.getTxid(), 0 }));
+    EXPECT_TRUE(chain.utxo().has({ spend.getTxid(), 0 }));
+
+    // A heavier branch without the spend returns it to the mempool
+    Mempool pool;
+    chain.setMempool(&pool);
+    Block c2 = mineChild(a1.getHash(), 0xc2);
+    Block c3 = mineChild(c2.getHash(), 0xc3);
+    ASSERT_TRUE(chain.addBlock(c2, 2));
+    ASSERT_TRUE(chain.addBlock(c3, 3));
+    EXPECT_EQ(chain.getBestBlockHash(), c3.getHash());
+    auto entry = pool.getEntry(spend.getTxid());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->fee, 1000u);
+}
+
+TEST(Consensus, HighSSignaturesRejected) {
+    static const unsigned char order[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41
+    };
+    std::vector<unsigned char> priv(32, 0x47);
+    shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+    unsigned char pub[33], sig[72];
+    shawncoin_pubkey_get(key, pub);
+    for (uint8_t i = 0; i < 8; ++i) {
+        uint256 hash{};
+        hash[0] = i;
+        size_t len = sizeof(sig);
+        ASSERT_EQ(shawncoin_sign(key, hash.data(), sig, &len), 1);
+        ASSERT_EQ(len, 64u);
+        EXPECT_LT(sig[32], 0x80); // s is at most half the order
+        EXPECT_EQ(shawncoin_verify(pub, hash.data(), sig, len), 1);
+        // (r, n - s) is the same signature in its other encoding
+        int borrow = 0;
+        for (int j = 31; j >= 0; --j) {
+            int d = order[j] - sig[32 + j] - borrow;
+            borrow = d < 0;
+            sig[32 + j] = (unsigned char)(d + (borrow ? 256 : 0));
+        }
+        EXPECT_EQ(shawncoin_verify(pub, hash.data(), sig, len), 0);
+    }
+    shawncoin_keypair_destroy(key);
+}
+
+TEST(Consensus, SignatureCacheSkipsVerifiedSignatures) {
+    std::vector<unsigned char> priv(32, 0x33);
+    shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+    unsigned char pub[33], h[20], sig[72];
+    shawncoin_pubkey_get(key, pub);
+    shawncoin_hash160(pub, sizeof(pub), h);
+    Script script = { 0x76, 0xa9, 0x14 };
+    script.insert(script.end(), h, h + 20);
+    script.push_back(0x88);
+    script.push_back(0xac);
+    uint256 hash{};
+    hash[0] = 0x5a;
+    size_t sigLen = sizeof(sig);
+    ASSERT_EQ(shawncoin_sign(key, hash.data(), sig, &sigLen), 1);
+    shawncoin_keypair_destroy(key);
+    TxInput in{ uint256{}, 0, std::vector<uint8_t>(sig, sig + sigLen), std::vector<uint8_t>(pub, pub + 33) };
+
+    SignatureCache cache(4096);
+    EXPECT_EQ(cache.capacity(), 128u);
+    uint256 k = cache.entryKey(hash, in.pubkey, in.signature);
+    EXPECT_NE(SignatureCache().entryKey(hash, in.pubkey, in.signature), k); // salted per cache
+    ASSERT_TRUE(verifyInputSignature(in, script, hash, &cache));
+    EXPECT_FALSE(cache.contains(k)); // not stored without store
+    ASSERT_TRUE(verifyInputSignature(in, script, hash, &cache, true));
+    EXPECT_TRUE(cache.contains(k));
+
+    // A cached entry is trusted without ECDSA, so only successes may ever be stored
+    TxInput forged = in;
+    forged.signature[5] ^= 1;
+    EXPECT_FALSE(verifyInputSignature(forged, script, hash, &cache, true));
+    uint256 forgedKey = cache.entryKey(hash, forged.pubkey, forged.signature);
+    EXPECT_FALSE(cache.contains(forgedKey));
+    cache.insert(forgedKey);
+    EXPECT_TRUE(verifyInputSignature(forged, script, hash, &cache));
+    // ... but the pubkey must still match the script
+    Script other = script;
+    other[5] ^= 1;
+    EXPECT_FALSE(verifyInputSignature(in, other, hash, &cache));
+
+    // Full buckets evict; the cache never grows
+    for (uint8_t i = 0; i < 255; ++i) {
+        uint256 filler{};
+        filler[0] = i;
+        filler[31] = 1;
+        cache.insert(cache.entryKey(filler, in.pubkey, in.signature));
+    }
+    EXPECT_EQ(cache.capacity(), 128u);
+}
+
+TEST(Consensus, SchnorrSignaturesVerifyAloneAndInBatches) {
+    const size_t count = 20;
+    std::vector<std::vector<unsigned char>> pubs(count, std::vector<unsigned char>(33));
+    std::vector<uint256> hashes(count);
+    std::vector<std::array<unsigned char, 64>> sigs(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> priv(32, (unsigned char)(0x40 + i));
+        shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+        shawncoin_pubkey_get(key, pubs[i].data());
+        hashes[i] = uint256{};
+        hashes[i][0] = (uint8_t)i;
+        ASSERT_EQ(shawncoin_schnorr_sign(key, hashes[i].data(), sigs[i].data()), 1);
+        shawncoin_keypair_destroy(key);
+        EXPECT_EQ(shawncoin_schnorr_verify(pubs[i].data(), hashes[i].data(), sigs[i].data()), 1);
+    }
+    // Keys are x-only, so the parity byte of the pubkey does not matter
+    std::vector<unsigned char> flipped = pubs[0];
+    flipped[0] ^= 1;
+    EXPECT_EQ(shawncoin_schnorr_verify(flipped.data(), hashes[0].data(), sigs[0].data()), 1);
+    EXPECT_EQ(shawncoin_schnorr_verify(pubs[0].data(), hashes[1].data(), sigs[0].data()), 0);
+    EXPECT_EQ(shawncoin_schnorr_verify(pubs[1].data(), hashes[0].data(), sigs[0].data()), 0);
+
+    std::vector<const unsigned char*> p, h, sg;
+    for (size_t i = 0; i < count; ++i) {
+        p.push_back(pubs[i].data());
+        h.push_back(hashes[i].data());
+        sg.push_back(sigs[i].data());
+    }
+    EXPECT_EQ(shawncoin_schnorr_verify_batch(p.data(), h.data(), sg.data(), count), 1);
+    sigs[13][40] ^= 1;
+    EXPECT_EQ(shawncoin_schnorr_verify_batch(p.data(), h.data(), sg.data(), count), 0);
+    sigs[13][40] ^= 1;
+    std::swap(h[3], h[4]); // every signature valid, but not over these messages
+    EXPECT_EQ(shawncoin_schnorr_verify_batch(p.data(), h.data(), sg.data(), count), 0);
+}
+
+TEST(Blockchain, ConnectBatchVerifiesSchnorrInputs) {
+    std::vector<unsigned char> priv(32, 0x44);
+    shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+    unsigned char pub[33], h[20];
+    shawncoin_pubkey_get(key, pub);
+    shawncoin_hash160(pub, sizeof(pub), h);
+    Script script = { 0x76, 0xa9, 0x14 };
+    script.insert(script.end(), h, h + 20);
+    script.push_back(0x88);
+    script.push_back(0xac);
+
+    Blockchain chain;
+    CheckQueue queue(2);
+    chain.setCheckQueue(&queue);
+    // Enough Schnorr inputs for more than one batch
+    const uint32_t outputs = (uint32_t)Blockchain::SCHNORR_BATCH_SIZE + 6;
+    Block a1 = mineChild(chain.getBestBlockHash(), 0xa1);
+    Transaction& cb = a1.transactions[0];
+    cb.outputs.assign(outputs, TxOutput{});
+    for (auto& out : cb.outputs) {
+        out.amount = getBlockSubsidy(1) / outputs;
+        out.script_pubkey = script;
+    }
+    cb.cached_txid.reset();
+    a1.header.merkle_root = computeMerkleRoot(a1.transactions);
+    while (!checkProofOfWork(a1.header)) ++a1.header.nonce;
+    ASSERT_TRUE(chain.addBlock(a1, 1));
+
+    // One spend per coin, each with its own signature hash
+    std::vector<Transaction> spends;
+    for (uint32_t i = 0; i < outputs; ++i) {
+        Transaction tx;
+        tx.version = TX_VERSION_SCHNORR;
+        tx.inputs.push_back(TxInput{ cb.getTxid(), i, {}, {} });
+        tx.outputs.resize(1);
+        tx.outputs[0].amount = cb.outputs[i].amount - 100;
+        tx.outputs[0].script_pubkey = script;
+        uint256 hash = signatureHash(tx);
+        unsigned char sig[64];
+        ASSERT_EQ(shawncoin_schnorr_sign(key, hash.data(), sig), 1);
+        tx.inputs[0].signature.assign(sig, sig + 64);
+        tx.inputs[0].pubkey.assign(pub, pub + 33);
+        EXPECT_TRUE(verifyInputSchnorr(tx.inputs[0], script, hash));
+        EXPECT_FALSE(verifyInputSignature(tx.inputs[0], script, hash)); // not an ECDSA signature
+        spends.push_back(tx);
+    }
+    shawncoin_keypair_destroy(key);
+
+    auto withSpends = [&](const std::vector<Transaction>& txs, uint8_t tag) {
+        Block b = mineChild(a1.getHash(), tag);
+        b.transactions.insert(b.transactions.end(), txs.begin(), txs.end());
+        b.header.merkle_root = computeMerkleRoot(b.transactions);
+        while (!checkProofOfWork(b.header)) ++b.header.nonce;
+        return b;
+    };
+    std::vector<Transaction> forged = spends;
+    forged[outputs - 2].inputs[0].signature[50] ^= 1; // in the second batch
+    forged[outputs - 2].cached_txid.reset();
+    EXPECT_FALSE(chain.addBlock(withSpends(forged, 0xb2), 2));
+    std::vector<Transaction> downgraded = spends; // a Schnorr signature does not pass as ECDSA
+    downgraded[5].version = 1;
+    downgraded[5].cached_txid.reset();
+    EXPECT_FALSE(chain.addBlock(withSpends(downgraded, 0xb3), 2));
+    EXPECT_EQ(chain.getHeight(), 1u);
+
+    ASSERT_TRUE(chain.addBlock(withSpends(spends, 0xa2), 2));
+    EXPECT_EQ(chain.getHeight(), 2u);
+    EXPECT_TRUE(chain.utxo().has({ spends.back().getTxid(), 0 }));
+}
+
+TEST(Consensus, UndoRestoresSpentCoins) {
+    UTXOSet utxo;
+    OutPoint prev{ {}, 3 };
+    prev.hash[0] = 0x42;
+    Script script = { 0x76, 0xa9, 0x14 };
+    script.insert(script.end(), 20, 0x11);
+    script.push_back(0x88);
+    script.push_back(0xac);
+    utxo.put(prev, 7 * COIN, script);
+
+    Block block = mineChild(uint256{}, 1);
+    Transaction spend;
+    spend.inputs.resize(1);
+    spend.inputs[0].prev_tx_hash = prev.hash;
+    spend.inputs[0].output_index = prev.index;
+    spend.outputs.resize(1);
+    spend.outputs[0].amount = 6 * COIN;
+    spend.outputs[0].script_pubkey = script;
+    block.transactions.push_back(spend);
+
+    BlockUndo undo;
+    ASSERT_TRUE(connectBlockUTXO(block, utxo, &undo));
+    EXPECT_FALSE(utxo.has(prev));
+    ASSERT_EQ(undo.spent.size(), 1u);
+
+    std::vector<uint8_t> raw;
+    serializeBlockUndo(undo, raw);
+    BlockUndo decoded;
+    ASSERT_TRUE(deserializeBlockUndo(raw.data(), raw.size(), decoded));
+
+    ASSERT_TRUE(disconnectBlockUTXO(block, utxo, decoded));
+    auto restored = utxo.get(prev);
+    ASSERT_TRUE(restored.has_value());
+    EXPECT_EQ(restored->amount, 7 * COIN);
+    EXPECT_EQ(restored->script_pubkey, script);
+    EXPECT_FALSE(utxo.has({ spend.getTxid(), 0 }));
+
+    // A missing second input leaves the first one unspent
+    TxInput missing;
+    missing.prev_tx_hash[0] = 0x99;
+    block.transactions[1].inputs.push_back(missing);
+    block.transactions[1].cached_txid.reset();
+    EXPECT_FALSE(connectBlockUTXO(block, utxo, &undo));
+    EXPECT_TRUE(utxo.has(prev));
+    EXPECT_TRUE(undo.spent.empty());
+}
+
+TEST(Consensus, OutputSpentWithinBlock) {
+    UTXOSet utxo;
+    AddressIndex index;
+    Block block = mineChild(uint256{}, 2);
+    OutPoint cbOut{ block.transactions[0].getTxid(), 0 };
+    Script script = block.transactions[0].outputs[0].script_pubkey;
+    utxo.put(cbOut, 10 * COIN, script); // pretend an earlier identical coinbase paid 10 SHWN
+
+    Transaction t1;
+    t1.inputs.resize(1);
+    t1.inputs[0].prev_tx_hash = uint256{};
+    t1.inputs[0].prev_tx_hash[0] = 0x55;
+    t1.outputs.resize(1);
+    t1.outputs[0].amount = 3 * COIN;
+    t1.outputs[0].script_pubkey = script;
+    Transaction t2;
+    t2.inputs.resize(1);
+    t2.inputs[0].prev_tx_hash = t1.getTxid();
+    t2.outputs.resize(1);
+    t2.outputs[0].amount = 2 * COIN;
+    t2.outputs[0].script_pubkey = script;
+    block.transactions.push_back(t1);
+    block.transactions.push_back(t2);
+
+    // t1's input is missing: nothing may change, not even the coinbase overwrite
+    BlockUndo undo;
+    EXPECT_FALSE(connectBlockUTXO(block, utxo, &undo, &index));
+    EXPECT_EQ(utxo.get(cbOut)->amount, 10 * COIN);
+    EXPECT_EQ(utxo.size(), 1u);
+
+    OutPoint funding{ t1.inputs[0].prev_tx_hash, 0 };
+    utxo.put(funding, 4 * COIN, script);
+    ASSERT_TRUE(connectBlockUTXO(block, utxo, &undo, &index));
+    EXPECT_FALSE(utxo.has(funding));
+    EXPECT_FALSE(utxo.has({ t1.getTxid(), 0 }));
+    EXPECT_TRUE(utxo.has({ t2.getTxid(), 0 }));
+    EXPECT_EQ(utxo.size(), 2u); // coinbase + t2
+    ASSERT_EQ(undo.spent.size(), 2u);
+    EXPECT_EQ(index.size(), 2u);
+
+    ASSERT_TRUE(disconnectBlockUTXO(block, utxo, undo, &index));
+    EXPECT_TRUE(utxo.has(funding));
+    EXPECT_FALSE(utxo.has({ t1.getTxid(), 0 }));
+    EXPECT_FALSE(utxo.has({ t2.getTxid(), 0 }));
+    EXPECT_EQ(utxo.size(), 1u);
+    auto entries = index.get(*scriptHash160(script));
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].outpoint.hash, funding.hash);
+}
+
@@ -1,6 +1,22 @@
 #include <gtest/gtest.h>
 #include "core/mempool.hpp"
 #include "core/types.hpp"
+#include "core/utxo.hpp"
+#include "core/consensus.hpp"
+#include "core/mempoolaccept.hpp"
+#include "core/feeestimator.hpp"
+#include "core/orphanpool.hpp"
+#include "storage/mempoolfile.hpp"
+#include "util/checkqueue.hpp"
+#include "util/realtime.hpp"
+#include "crypto/hash.h"
+#include "crypto/keys.h"
+#include "crypto/signatures.h"
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <thread>
 
 using namespace shawncoin;
 
@@ -25,6 +41,527 @@ TEST(MempoolTest, AddAndTemplate) {
     ASSERT_EQ(tmpl.size(), 1);
 }
 
+// Transaction spending (prev, index) into one P2PKH output; tag keeps txids distinct.
+static Transaction spend(const uint256& prev, uint32_t index, uint8_t tag) {
+    Transaction tx;
+    tx.version = 1;
+    TxInput in;
+    in.prev_tx_hash = prev;
+    in.output_index = index;
+    tx.inputs.push_back(in);
+    TxOutput out;
+    out.amount = 1 * COIN;
+    out.script_pubkey = {0x76, 0xa9, 0x14};
+    out.script_pubkey.insert(out.script_pubkey.end(), 20, tag);
+    out.script_pubkey.push_back(0x88); out.script_pubkey.push_back(0xac);
+    tx.outputs.push_back(out);
+    return tx;
+}
+
+static uint256 hashOf(uint8_t tag) {
+    uint256 h{};
+    h.fill(tag);
+    return h;
+}
+
+TEST(MempoolTest, TemplateByFeeRateWithParentsFirst) {
+    Mempool mp;
+    Transaction low = spend(hashOf(1), 0, 1);
+    Transaction high = spend(hashOf(2), 0, 2);
+    Transaction parent = spend(hashOf(3), 0, 3);
+    Transaction child = spend(parent.getTxid(), 0, 4);
+    ASSERT_TRUE(mp.add(low, 100));
+    ASSERT_TRUE(mp.add(high, 10000));
+    ASSERT_TRUE(mp.add(parent, 10));
+    ASSERT_TRUE(mp.add(child, 50000)); // pays for its parent
+
+    auto entry = mp.getEntry(child.getTxid());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->ancestorCount, 2u);
+    EXPECT_EQ(entry->ancestorFee, 50010u);
+    EXPECT_EQ(mp.totalFees(), 60110u);
+
+    auto tmpl = mp.getBlockTemplate();
+    ASSERT_EQ(tmpl.size(), 4u);
+    EXPECT_EQ(tmpl[0].getTxid(), parent.getTxid());
+    EXPECT_EQ(tmpl[1].getTxid(), child.getTxid());
+    EXPECT_EQ(tmpl[2].getTxid(), high.getTxid());
+    EXPECT_EQ(tmpl[3].getTxid(), low.getTxid());
+
+    // A size bound keeps the best-paying transactions that fit
+    size_t oneTx = mp.getEntry(high.getTxid())->size;
+    auto small = mp.getBlockTemplate(oneTx);
+    ASSERT_EQ(small.size(), 1u);
+    EXPECT_EQ(small[0].getTxid(), high.getTxid());
+}
+
+TEST(MempoolTest, ConflictsAndRecursiveRemoval) {
+    Mempool mp;
+    Transaction parent = spend(hashOf(5), 0, 5);
+    Transaction child = spend(parent.getTxid(), 0, 6);
+    ASSERT_TRUE(mp.add(parent, 1000));
+    ASSERT_TRUE(mp.add(child, 1000));
+    EXPECT_FALSE(mp.add(spend(hashOf(5), 0, 7), 5000)); // same outpoint as parent
+    ASSERT_EQ(mp.getSpender(OutPoint{ hashOf(5), 0 }), parent.getTxid());
+
+    size_t bytes = mp.bytes();
+    EXPECT_GT(bytes, 0u);
+    EXPECT_TRUE(mp.remove(parent.getTxid()));
+    EXPECT_EQ(mp.size(), 0u); // the child spent the removed parent
+    EXPECT_EQ(mp.bytes(), 0u);
+    EXPECT_FALSE(mp.getSpender(OutPoint{ hashOf(5), 0 }).has_value());
+    EXPECT_TRUE(mp.add(spend(hashOf(5), 0, 7), 5000));
+    EXPECT_EQ(mp.expire(INT64_MAX), 1u);
+    EXPECT_EQ(mp.size(), 0u);
+}
+
+TEST(MempoolTest, ReplaceByFee) {
+    Mempool mp;
+    Transaction original = spend(hashOf(10), 0, 10);
+    Transaction child = spend(original.getTxid(), 0, 11);
+    ASSERT_TRUE(mp.add(original, 1000));
+    ASSERT_TRUE(mp.add(child, 500));
+    Transaction bump = spend(hashOf(10), 0, 12);
+    size_t size = mp.getEntry(original.getTxid())->size;
+    EXPECT_FALSE(mp.add(bump, 100000)); // replacement is off by default
+
+    mp.setReplaceByFee(true);
+    EXPECT_FALSE(mp.add(bump, 1400));            // less than the fees it would evict
+    EXPECT_FALSE(mp.add(bump, 1500 + size - 1)); // no room for the incremental relay fee
+    // Spending from a transaction it would evict
+    Transaction self = bump;
+    self.inputs.push_back(TxInput{ original.getTxid(), 0, {}, {} });
+    EXPECT_FALSE(mp.add(self, 100000));
+    EXPECT_EQ(mp.size(), 2u);
+
+    ASSERT_TRUE(mp.add(bump, 1500 + size));
+    EXPECT_EQ(mp.size(), 1u);
+    EXPECT_FALSE(mp.get(child.getTxid()).has_value());
+    EXPECT_EQ(mp.getSpender(OutPoint{ hashOf(10), 0 }), bump.getTxid());
+    EXPECT_FALSE(mp.getSpender(OutPoint{ original.getTxid(), 0 }).has_value());
+    EXPECT_EQ(mp.totalFees(), 1500 + size);
+}
+
+TEST(MempoolTest, RemoveForBlock) {
+    Mempool mp;
+    Transaction parent = spend(hashOf(20), 0, 20);
+    Transaction child = spend(parent.getTxid(), 0, 21);
+    Transaction loser = spend(hashOf(22), 0, 22);
+    Transaction loserChild = spend(loser.getTxid(), 0, 23);
+    ASSERT_TRUE(mp.add(parent, 1000));
+    ASSERT_TRUE(mp.add(child, 2000));
+    ASSERT_TRUE(mp.add(loser, 1000));
+    ASSERT_TRUE(mp.add(loserChild, 1000));
+
+    Block block;
+    block.transactions.push_back(spend(hashOf(0), 0, 0)); // stands in for the coinbase
+    block.transactions.push_back(parent);
+    block.transactions.push_back(spend(hashOf(22), 0, 24)); // double-spends loser
+    EXPECT_EQ(mp.removeForBlock(block, 1), 3u);
+    ASSERT_EQ(mp.size(), 1u);
+    auto entry = mp.getEntry(child.getTxid());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_TRUE(entry->parents.empty());
+    EXPECT_EQ(entry->ancestorCount, 1u);
+    EXPECT_EQ(entry->ancestorFee, 2000u);
+    EXPECT_EQ(mp.totalFees(), 2000u);
+    EXPECT_FALSE(mp.getSpender(OutPoint{ hashOf(22), 0 }).has_value());
+    EXPECT_EQ(mp.getBlockTemplate().size(), 1u);
+}
+
+TEST(MempoolTest, EvictsLowestRatePackagesWhenFull) {
+    Mempool mp;
+    Transaction cheapParent = spend(hashOf(10), 0, 10);
+    Transaction richChild = spend(cheapParent.getTxid(), 0, 11);
+    Transaction low = spend(hashOf(12), 0, 12);
+    Transaction mid = spend(hashOf(13), 0, 13);
+    ASSERT_TRUE(mp.add(cheapParent, 10));
+    ASSERT_TRUE(mp.add(richChild, 100000)); // keeps its parent alive
+    ASSERT_TRUE(mp.add(low, 100));
+    ASSERT_TRUE(mp.add(mid, 5000));
+    EXPECT_EQ(mp.getEntry(cheapParent.getTxid())->descendantCount, 2u);
+    EXPECT_EQ(mp.getMinFeeRate(), 0u);
+
+    size_t txBytes = mp.getEntry(low.getTxid())->size;
+    mp.setMaxBytes(mp.bytes() - 1);
+    EXPECT_EQ(mp.size(), 3u);
+    EXPECT_FALSE(mp.get(low.getTxid()).has_value());
+    EXPECT_TRUE(mp.get(cheapParent.getTxid()).has_value());
+    EXPECT_LE(mp.bytes(), mp.maxBytes());
+
+    // The floor is now above the evicted rate, so a copy of it is refused
+    uint64_t floor = mp.getMinFeeRate();
+    EXPECT_GT(floor, 100 * 1000 / txBytes);
+    EXPECT_FALSE(mp.add(spend(hashOf(14), 0, 14), 100));
+    // A newcomer that pays more than the pool's worst package displaces it
+    Transaction rich = spend(hashOf(15), 0, 15);
+    EXPECT_TRUE(mp.add(rich, 50000));
+    EXPECT_FALSE(mp.get(mid.getTxid()).has_value());
+    EXPECT_LE(mp.bytes(), mp.maxBytes());
+}
+
+TEST(MempoolTest, TemplateRevaluesChildrenOfIncludedParents) {
+    Mempool mp;
+    Transaction parent = spend(hashOf(20), 0, 20);
+    parent.outputs.push_back(parent.outputs[0]);
+    Transaction payer = spend(parent.getTxid(), 0, 21);
+    Transaction sibling = spend(parent.getTxid(), 1, 22);
+    Transaction other = spend(hashOf(23), 0, 23);
+    ASSERT_TRUE(mp.add(parent, 10));
+    ASSERT_TRUE(mp.add(payer, 100000));
+    ASSERT_TRUE(mp.add(sibling, 20000));
+    ASSERT_TRUE(mp.add(other, 15000));
+    auto p = mp.getEntry(parent.getTxid());
+    ASSERT_TRUE(p.has_value());
+    EXPECT_EQ(p->children.size(), 2u);
+    EXPECT_EQ(p->descendantFee, 120010u);
+
+    // With its parent already in, the sibling pays its own rate and beats the other tx
+    auto tmpl = mp.getBlockTemplate();
+    ASSERT_EQ(tmpl.size(), 4u);
+    EXPECT_EQ(tmpl[0].getTxid(), parent.getTxid());
+    EXPECT_EQ(tmpl[1].getTxid(), payer.getTxid());
+    EXPECT_EQ(tmpl[2].getTxid(), sibling.getTxid());
+    EXPECT_EQ(tmpl[3].getTxid(), other.getTxid());
+
+    EXPECT_TRUE(mp.remove(payer.getTxid()));
+    EXPECT_EQ(mp.getEntry(parent.getTxid())->children.size(), 1u);
+    EXPECT_EQ(mp.getEntry(parent.getTxid())->descendantFee, 20010u);
+}
+
+TEST(MempoolTest, TemplateTakesEachTransactionOnce) {
+    // P goes in alone; X and Y are then re-rated, and Y's package pulls X in with it
+    Mempool mp;
+    Transaction p = spend(hashOf(24), 0, 24);
+    Transaction x = spend(p.getTxid(), 0, 25);
+    Transaction y = spend(x.getTxid(), 0, 26);
+    ASSERT_TRUE(mp.add(p, 2000));
+    ASSERT_TRUE(mp.add(x, 100));
+    ASSERT_TRUE(mp.add(y, 700));
+
+    auto tmpl = mp.getBlockTemplate();
+    ASSERT_EQ(tmpl.size(), 3u);
+    EXPECT_EQ(tmpl[0].getTxid(), p.getTxid());
+    EXPECT_EQ(tmpl[1].getTxid(), x.getTxid());
+    EXPECT_EQ(tmpl[2].getTxid(), y.getTxid());
+}
+
+TEST(MempoolTest, PackageLimits) {
+    Mempool mp;
+    uint256 prev = hashOf(30);
+    for (size_t i = 0; i < Mempool::MAX_PACKAGE_COUNT; ++i) {
+        Transaction tx = spend(prev, 0, (uint8_t)i);
+        ASSERT_TRUE(mp.add(tx, 1000));
+        prev = tx.getTxid();
+    }
+    EXPECT_FALSE(mp.add(spend(prev, 0, 99), 1000)); // one more in the chain
+    EXPECT_EQ(mp.size(), Mempool::MAX_PACKAGE_COUNT);
+}
+
+// Key whose P2PKH outputs the tests spend, and signing with it.
+struct TestKey {
+    shawncoin_keypair_t* key = nullptr;
+    Script script;
+    TestKey() {
+        std::vector<unsigned char> priv(32, 0x11);
+        key = shawncoin_keypair_from_priv(priv.data());
+        unsigned char pub[33], h[20];
+        shawncoin_pubkey_get(key, pub);
+        shawncoin_hash160(pub, sizeof(pub), h);
+        script = {0x76, 0xa9, 0x14};
+        script.insert(script.end(), h, h + 20);
+        script.push_back(0x88); script.push_back(0xac);
+    }
+    ~TestKey() { shawncoin_keypair_destroy(key); }
+
+    // tx spending (prev, index) into one output of amount paid back to this key, signed
+    Transaction pay(const uint256& prev, uint32_t index, uint64_t amount) const {
+        Transaction tx;
+        tx.inputs.push_back(TxInput{ prev, index, {}, {} });
+        TxOutput out;
+        out.amount = amount;
+        out.script_pubkey = script;
+        tx.outputs.push_back(out);
+        sign(tx);
+        return tx;
+    }
+    void sign(Transaction& tx) const {
+        uint256 hash = signatureHash(tx);
+        unsigned char pub[33], sig[72];
+        size_t sigLen = sizeof(sig);
+        shawncoin_pubkey_get(key, pub);
+        shawncoin_sign(key, hash.data(), sig, &sigLen);
+        for (auto& in : tx.inputs) {
+            in.signature.assign(sig, sig + sigLen);
+            in.pubkey.assign(pub, pub + 33);
+        }
+    }
+};
+
+TEST(MempoolTest, AcceptorChecksInputsValueAndSignatures) {
+    TestKey k;
+    UTXOSet utxo;
+    utxo.put(OutPoint{ hashOf(40), 0 }, 2 * COIN, k.script);
+    Mempool mp;
+    MempoolAcceptor acceptor(mp, utxo, 2);
+
+    Transaction unsigned_ = k.pay(hashOf(40), 0, COIN);
+    unsigned_.inputs[0].signature.clear();
+    EXPECT_EQ(acceptor.accept(unsigned_).status, AcceptStatus::BadSignature);
+    Transaction tampered = k.pay(hashOf(40), 0, COIN);
+    tampered.outputs[0].amount -= 1; // no longer what was signed
+    EXPECT_EQ(acceptor.accept(tampered).status, AcceptStatus::BadSignature);
+    EXPECT_EQ(acceptor.accept(k.pay(hashOf(40), 0, 3 * COIN)).status, AcceptStatus::InsufficientValue);
+    EXPECT_EQ(acceptor.accept(k.pay(hashOf(41), 0, COIN)).status, AcceptStatus::MissingInputs);
+    EXPECT_EQ(mp.size(), 0u);
+
+    Transaction parent = k.pay(hashOf(40), 0, COIN);
+    AcceptResult r = acceptor.accept(parent);
+    EXPECT_EQ(r.status, AcceptStatus::Accepted);
+    EXPECT_EQ(r.fee, COIN);
+    // Spends an output that exists only in the pool
+    r = acceptor.accept(k.pay(parent.getTxid(), 0, COIN - 1000));
+    EXPECT_EQ(r.status, AcceptStatus::Accepted);
+    EXPECT_EQ(r.fee, 1000u);
+    EXPECT_EQ(acceptor.accept(k.pay(hashOf(40), 0, COIN / 2)).status, AcceptStatus::Rejected); // conflict
+}
+
+TEST(MempoolTest, AddRechecksInputsAgainstCoins) {
+    UTXOSet utxo;
+    utxo.put(OutPoint{ hashOf(42), 0 }, COIN, Script{});
+    utxo.put(OutPoint{ hashOf(43), 0 }, COIN, Script{});
+    Mempool mp;
+    mp.setCoinsView(&utxo);
+    Transaction parent = spend(hashOf(42), 0, 42);
+    ASSERT_TRUE(mp.add(parent, 5000));
+    EXPECT_TRUE(mp.add(spend(parent.getTxid(), 0, 44), 5000));
+    EXPECT_FALSE(mp.add(spend(parent.getTxid(), 1, 45), 5000)); // no such output
+
+    // Coin spent by a block, or parent removed, after the acceptor looked them up
+    ASSERT_TRUE(utxo.spend(OutPoint{ hashOf(43), 0 }));
+    EXPECT_FALSE(mp.add(spend(hashOf(43), 0, 46), 5000));
+    Transaction orphaned = spend(parent.getTxid(), 0, 47);
+    ASSERT_TRUE(mp.remove(parent.getTxid()));
+    EXPECT_FALSE(mp.add(orphaned, 5000));
+    EXPECT_EQ(mp.size(), 0u);
+}
+
+TEST(MempoolTest, AcceptorVerifiesInParallel) {
+    TestKey k;
+    UTXOSet utxo;
+    std::vector<Transaction> txs;
+    for (uint8_t i = 0; i < 64; ++i) {
+        utxo.put(OutPoint{ hashOf(i), 7 }, COIN, k.script);
+        txs.push_back(k.pay(hashOf(i), 7, COIN - 1000));
+    }
+    txs[10].outputs[0].amount += 1;
+    Mempool mp;
+    MempoolAcceptor acceptor(mp, utxo, 4);
+    std::vector<std::future<AcceptResult>> results;
+    for (const auto& tx : txs) results.push_back(acceptor.submit(tx));
+    for (size_t i = 0; i < results.size(); ++i)
+        EXPECT_EQ(results[i].get().status, i == 10 ? AcceptStatus::BadSignature : AcceptStatus::Accepted);
+    EXPECT_EQ(mp.size(), 63u);
+
+    // One transaction's inputs spread over a check queue
+    CheckQueue queue(3);
+    acceptor.setCheckQueue(&queue);
+    Transaction wide;
+    for (uint32_t i = 0; i < 20; ++i) {
+        utxo.put(OutPoint{ hashOf(70), i }, COIN, k.script);
+        wide.inputs.push_back(TxInput{ hashOf(70), i, {}, {} });
+    }
+    wide.outputs.push_back(TxOutput{ 20 * COIN - 1000, k.script });
+    k.sign(wide);
+    Transaction forged = wide;
+    forged.inputs[13].signature[8] ^= 1;
+    EXPECT_EQ(acceptor.accept(forged).status, AcceptStatus::BadSignature);
+    EXPECT_EQ(acceptor.accept(wide).status, AcceptStatus::Accepted);
+}
+
+TEST(MempoolTest, OrphanPoolLimits) {
+    Transaction parent = spend(hashOf(60), 0, 60);
+    Transaction a = spend(parent.getTxid(), 0, 61);
+    Transaction b = spend(parent.getTxid(), 0, 62); // same outpoint, still both held
+    OrphanPool orphans;
+    EXPECT_TRUE(orphans.add(a, 1));
+    EXPECT_FALSE(orphans.add(a, 1));
+    EXPECT_TRUE(orphans.add(b, 2));
+    EXPECT_TRUE(orphans.takeChildren(spend(hashOf(63), 0, 63)).empty());
+    auto children = orphans.takeChildren(parent);
+    EXPECT_EQ(children.size(), 2u);
+    EXPECT_EQ(orphans.size(), 0u);
+    EXPECT_EQ(orphans.bytes(), 0u);
+
+    // Per-peer share, then the overall cap by random eviction
+    std::vector<uint8_t> raw;
+    serializeTransaction(a, raw);
+    size_t perPeer = OrphanPool::MAX_PEER_BYTES / raw.size();
+    size_t held = 0;
+    for (size_t i = 0; i < perPeer + 5; ++i) {
+        if (orphans.add(spend(hashOf((uint8_t)i), 1000 + (uint32_t)i, 64), 7)) ++held;
+    }
+    EXPECT_EQ(held, perPeer);
+    EXPECT_EQ(orphans.eraseForPeer(7), perPeer);
+
+    OrphanPool small(raw.size() * 3);
+    for (uint32_t i = 0; i < 10; ++i) EXPECT_TRUE(small.add(spend(hashOf(65), i, 65), i));
+    EXPECT_EQ(small.size(), 3u);
+    EXPECT_LE(small.bytes(), raw.size() * 3);
+    EXPECT_EQ(small.expire(INT64_MAX), 3u);
+    EXPECT_EQ(small.size(), 0u);
+}
+
+TEST(MempoolTest, OrphansAcceptedWithParent) {
+    TestKey k;
+    UTXOSet utxo;
+    utxo.put(OutPoint{ hashOf(70), 0 }, COIN, k.script);
+    Mempool mp;
+    OrphanPool orphans;
+    MempoolAcceptor acceptor(mp, utxo, 2);
+    acceptor.setOrphanPool(&orphans);
+    Transaction parent = k.pay(hashOf(70), 0, COIN - 1000);
+    Transaction child = k.pay(parent.getTxid(), 0, COIN - 2000);
+    Transaction grandchild = k.pay(child.getTxid(), 0, COIN - 3000);
+
+    EXPECT_EQ(acceptor.accept(grandchild, 0, 5).status, AcceptStatus::MissingInputs);
+    EXPECT_EQ(acceptor.accept(child, 0, 5).status, AcceptStatus::MissingInputs);
+    EXPECT_EQ(orphans.size(), 2u);
+    EXPECT_EQ(acceptor.accept(parent).status, AcceptStatus::Accepted);
+    // The orphans go back through admission on the workers, one generation at a time
+    for (int i = 0; i < 200 && mp.size() < 3; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(mp.size(), 3u);
+    EXPECT_EQ(orphans.size(), 0u);
+}
+
+TEST(MempoolTest, SavedAndReloaded) {
+    TestKey k;
+    UTXOSet utxo;
+    utxo.put(OutPoint{ hashOf(30), 0 }, COIN, k.script);
+    utxo.put(OutPoint{ hashOf(32), 0 }, COIN, k.script);
+    Mempool mp;
+    MempoolAcceptor acceptor(mp, utxo, 1);
+    Transaction parent = k.pay(hashOf(30), 0, COIN - 3000);
+    Transaction child = k.pay(parent.getTxid(), 0, COIN - 7000);
+    Transaction gone = k.pay(hashOf(32), 0, COIN - 5000);
+    int64_t entered = (int64_t)std::time(nullptr) - 3600;
+    ASSERT_EQ(acceptor.accept(parent, entered).status, AcceptStatus::Accepted);
+    ASSERT_EQ(acceptor.accept(child).status, AcceptStatus::Accepted);
+    ASSERT_EQ(acceptor.accept(gone).status, AcceptStatus::Accepted);
+    std::string path = "test_mempool.dat";
+    ASSERT_TRUE(writeMempoolFile(path, mp));
+
+    std::vector<MempoolFileEntry> saved;
+    ASSERT_TRUE(readMempoolFile(path, saved));
+    ASSERT_EQ(saved.size(), 3u);
+    EXPECT_EQ(saved.back().tx.getTxid(), child.getTxid()); // parents come first
+
+    utxo.spend(OutPoint{ hashOf(32), 0 }); // spent while the node was down
+    Mempool reloaded;
+    MempoolAcceptor reloader(reloaded, utxo, 1);
+    EXPECT_EQ(loadMempoolFile(path, reloader), 2u);
+    auto entry = reloaded.getEntry(parent.getTxid());
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->fee, 3000u);
+    EXPECT_EQ(entry->time, entered); // kept, so expiry still counts from first entry
+    EXPECT_EQ(reloaded.getEntry(child.getTxid())->ancestorCount, 2u);
+    EXPECT_FALSE(reloaded.get(gone.getTxid()).has_value());
+    std::remove(path.c_str());
+}
+
+TEST(MempoolTest, FeeEstimatorFollowsConfirmations) {
+    FeeEstimator est;
+    EXPECT_FALSE(est.estimateFee(2).has_value());
+    std::vector<uint256> fast;
+    for (uint8_t i = 0; i < 10; ++i) {
+        est.trackTransaction(hashOf(i), 5000, 250);    // 20000 per 1000 bytes: mined next block
+        est.trackTransaction(hashOf(100 + i), 250, 250); // 1000: never mined
+        fast.push_back(hashOf(i));
+    }
+    est.processBlock(1, fast);
+    EXPECT_EQ(est.tracked(), 10u);
+    auto rate = est.estimateFee(1);
+    ASSERT_TRUE(rate.has_value());
+    EXPECT_EQ(*rate, 20000u);
+    for (uint64_t h = 2; h <= 10; ++h) est.processBlock(h, {});
+    EXPECT_EQ(est.estimateFee(5), 20000u); // the cheap ones are late, not a cheaper answer
+
+    // Started on a long chain: the first block's confirmations took one block, not 500
+    FeeEstimator resumed;
+    resumed.setHeight(500);
+    for (uint8_t i = 0; i < 10; ++i) resumed.trackTransaction(hashOf(i), 5000, 250);
+    resumed.processBlock(501, fast);
+    EXPECT_EQ(resumed.estimateFee(1), 20000u);
+
+    // Fed by the pool: entries tracked, confirmations and evictions reported
+    Mempool mp;
+    FeeEstimator fed;
+    mp.setFeeEstimator(&fed);
+    Transaction mined = spend(hashOf(50), 0, 50);
+    Transaction dropped = spend(hashOf(51), 0, 51);
+    ASSERT_TRUE(mp.add(mined, 1000));
+    ASSERT_TRUE(mp.add(dropped, 1000));
+    EXPECT_EQ(fed.tracked(), 2u);
+    mp.remove(dropped.getTxid());
+    Block block;
+    block.transactions.push_back(spend(hashOf(0), 0, 0));
+    block.transactions.push_back(mined);
+    mp.removeForBlock(block, 1);
+    EXPECT_EQ(fed.tracked(), 0u);
+}
+
+TEST(MempoolTest, FeeEstimatorSurvivesReorg) {
+    FeeEstimator est;
+    std::vector<uint256> fast;
+    for (uint8_t i = 0; i < 10; ++i) {
+        est.trackTransaction(hashOf(i), 5000, 250);
+        fast.push_back(hashOf(i));
+    }
+    est.processBlock(1, fast);
+    for (uint64_t h = 2; h <= 10; ++h) est.processBlock(h, {});
+    for (uint8_t i = 0; i < 10; ++i) est.trackTransaction(hashOf(100 + i), 5000, 250);
+    // Reconnecting a shorter branch lowers the tip below where those were tracked
+    est.processBlock(8, {});
+    EXPECT_EQ(est.estimateFee(2), 20000u);
+}
+
+TEST(MempoolTest, RealtimeBusDeliversInOrderAndDropsWhenFull) {
+    RealtimeBus bus(1024);
+    std::vector<std::string> seen;
+    bus.subscribe([&](const std::string& e) { seen.push_back(e); });
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&bus, p]() {
+            for (int i = 0; i < 200; ++i) bus.publish(std::to_string(p) + ":" + std::to_string(i));
+        });
+    }
+    for (auto& t : producers) t.join();
+    EXPECT_EQ(bus.drain(), 800u);
+    ASSERT_EQ(seen.size(), 800u);
+    int next[4] = {};
+    for (const auto& e : seen) {
+        int p = e[0] - '0';
+        EXPECT_EQ(e.substr(2), std::to_string(next[p]++)); // each producer's events stay in order
+    }
+    EXPECT_EQ(bus.dropped(), 0u);
+
+    for (int i = 0; i < 1100; ++i) bus.publish("x");
+    EXPECT_EQ(bus.dropped(), 76u); // the producer is never made to wait
+    EXPECT_EQ(bus.drain(), 1024u);
+
+    std::string dir = "test_realtime";
+    bus.start(dir);
+    bus.publish("{\"type\":\"tx\"}");
+    bus.stop();
+    std::ifstream feed(dir + "/realtime_feed.log");
+    std::string line;
+    ASSERT_TRUE(std::getline(feed, line));
+    EXPECT_EQ(line, "{\"type\":\"tx\"}");
+    feed.close();
+    std::remove((dir + "/realtime_feed.log").c_str());
+    std::remove(dir.c_str());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,447 @@
+#include <gtest/gtest.h>
+#include "core/cuckoofilter.hpp"
+#include "core/utxo.hpp"
+#include "storage/coinsdb.hpp"
+#include "storage/database.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace shawncoin;
+
+static OutPoint makeOutPoint(uint8_t tag, uint32_t index) {
+    OutPoint out;
+    out.hash.fill(tag);
+    out.index = index;
+    return out;
+}
+
+static Script p2pkh(uint8_t tag) {
+    Script s(25, tag);
+    s[0] = 0x76;
+    s[1] = 0xa9;
+    s[2] = 0x14;
+    s[23] = 0x88;
+    s[24] = 0xac;
+    return s;
+}
+
+static size_t countCoins(const UTXOSet& utxo) {
+    size_t n = 0;
+    utxo.forEach([&n](const OutPoint&, const Coin&) {
+        ++n;
+        return true;
+    });
+    return n;
+}
+
+TEST(UTXOCache, CreatedAndSpentCoinsNeverReachBackend) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 1 << 20, false);
+
+    utxo.put(makeOutPoint(1, 0), 50 * COIN, p2pkh(1));
+    utxo.put(makeOutPoint(2, 0), 10 * COIN, p2pkh(2));
+    ASSERT_TRUE(utxo.spend(makeOutPoint(2, 0)));
+    uint256 best{};
+    best[0] = 7;
+    ASSERT_TRUE(utxo.flush(best));
+
+    EXPECT_EQ(coins.getBestBlock(), best);
+    EXPECT_EQ(coins.getStats().coinCount, 1u);
+    EXPECT_TRUE(coins.getCoin(makeOutPoint(1, 0)).has_value());
+    EXPECT_FALSE(coins.getCoin(makeOutPoint(2, 0)).has_value());
+    EXPECT_EQ(utxo.cacheEntries(), 0u);
+
+    // Reads fall through to the backend; spending a flushed coin deletes it on the next flush
+    auto coin = utxo.get(makeOutPoint(1, 0));
+    ASSERT_TRUE(coin.has_value());
+    EXPECT_EQ(coin->amount, 50 * COIN);
+    EXPECT_EQ(coin->script_pubkey, p2pkh(1));
+    ASSERT_TRUE(utxo.spend(makeOutPoint(1, 0)));
+    EXPECT_FALSE(utxo.has(makeOutPoint(1, 0)));
+    EXPECT_EQ(utxo.size(), 0u);
+    ASSERT_TRUE(utxo.flush(best));
+    EXPECT_FALSE(coins.getCoin(makeOutPoint(1, 0)).has_value());
+    EXPECT_EQ(coins.getStats().coinCount, 0u);
+}
+
+TEST(UTXOCache, RespendAfterRestoreKeepsDelete) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 1 << 20, false);
+    utxo.put(makeOutPoint(3, 1), 5 * COIN, p2pkh(3));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+
+    // Spend, restore (as a disconnect would), spend again: the backend copy must go away
+    ASSERT_TRUE(utxo.spend(makeOutPoint(3, 1)));
+    utxo.put(makeOutPoint(3, 1), 5 * COIN, p2pkh(3));
+    ASSERT_TRUE(utxo.spend(makeOutPoint(3, 1)));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    EXPECT_FALSE(coins.getCoin(makeOutPoint(3, 1)).has_value());
+
+    // A coinbase-style overwrite of a flushed coin does not double count
+    utxo.put(makeOutPoint(4, 0), 1 * COIN, p2pkh(4));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    utxo.put(makeOutPoint(4, 0), 2 * COIN, p2pkh(4), true);
+    EXPECT_EQ(utxo.size(), 1u);
+    ASSERT_TRUE(utxo.spend(makeOutPoint(4, 0)));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    EXPECT_FALSE(coins.getCoin(makeOutPoint(4, 0)).has_value());
+}
+
+TEST(UTXOCache, FlushesWhenOverBudget) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 4096, false);
+    uint32_t n = 0;
+    while (!utxo.needsFlush()) utxo.put(makeOutPoint(5, n++), COIN, p2pkh(5));
+    EXPECT_GT(utxo.cacheUsage(), 4096u);
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    EXPECT_FALSE(utxo.needsFlush());
+    EXPECT_EQ(coins.getStats().coinCount, n);
+    EXPECT_EQ(countCoins(utxo), n);
+}
+
+TEST(UTXOCache, ManyInsertsAndErasesStayConsistent) {
+    UTXOSet utxo;
+    const uint32_t n = 5000;
+    for (uint32_t i = 0; i < n; ++i) utxo.put(makeOutPoint((uint8_t)(i % 7), i), i, p2pkh(1));
+    // Erase every third coin: exercises backward-shift deletion inside probe runs
+    for (uint32_t i = 0; i < n; i += 3) ASSERT_TRUE(utxo.spend(makeOutPoint((uint8_t)(i % 7), i)));
+    for (uint32_t i = 0; i < n; ++i) {
+        auto coin = utxo.get(makeOutPoint((uint8_t)(i % 7), i));
+        ASSERT_EQ(coin.has_value(), i % 3 != 0) << i;
+        if (coin) {
+            EXPECT_EQ(coin->amount, i);
+        }
+    }
+    EXPECT_EQ(utxo.size(), n - (n + 2) / 3);
+    EXPECT_EQ(countCoins(utxo), utxo.size());
+}
+
+TEST(UTXOCache, ConcurrentLookups) {
+    UTXOSet utxo;
+    const uint32_t n = 2000;
+    for (uint32_t i = 0; i < n; ++i) utxo.put(makeOutPoint(9, i), i, p2pkh(9));
+    std::atomic<uint32_t> found{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&utxo, &found, t] {
+            for (uint32_t i = 0; i < n; ++i) {
+                if (utxo.has(makeOutPoint(9, i))) ++found;
+                utxo.put(makeOutPoint((uint8_t)(20 + t), i), i, p2pkh(2));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    EXPECT_EQ(found.load(), 4 * n);
+    EXPECT_EQ(utxo.size(), 5 * n);
+}
+
+TEST(CoinEncoding, CompactRoundTrip) {
+    for (uint64_t amount : std::vector<uint64_t>{ 0, 1, 9, 10, 5000, 50 * COIN, 21000000 * COIN, 123456789 }) {
+        EXPECT_EQ(decompressAmount(compressAmount(amount)), amount) << amount;
+    }
+    Coin p2pkhCoin{ 50 * COIN, p2pkh(3) };
+    std::vector<uint8_t> enc;
+    encodeCoin(p2pkhCoin, enc);
+    EXPECT_EQ(enc.size(), 22u); // 1-byte amount, 1-byte tag, 20-byte hash
+    EXPECT_EQ(encodedCoinSize(enc.data()), enc.size());
+    Coin decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeCoin(enc.data(), enc.size(), decoded, used));
+    EXPECT_EQ(used, enc.size());
+    EXPECT_EQ(decoded.amount, p2pkhCoin.amount);
+    EXPECT_EQ(decoded.script_pubkey, p2pkhCoin.script_pubkey);
+
+    Coin other{ 7, Script{ 0x51, 0x52, 0x53 } };
+    enc.clear();
+    encodeCoin(other, enc);
+    ASSERT_TRUE(decodeCoin(enc.data(), enc.size(), decoded, used));
+    EXPECT_EQ(decoded.script_pubkey, other.script_pubkey);
+    EXPECT_FALSE(decodeCoin(enc.data(), enc.size() - 1, decoded, used));
+}
+
+TEST(UTXOCache, ArenaIsReclaimedAfterChurn) {
+    UTXOSet utxo;
+    for (uint32_t round = 0; round < 20; ++round) {
+        for (uint32_t i = 0; i < 20000; ++i) utxo.put(makeOutPoint(11, round * 20000 + i), COIN, p2pkh(4));
+        for (uint32_t i = 0; i < 20000; ++i) ASSERT_TRUE(utxo.spend(makeOutPoint(11, round * 20000 + i)));
+    }
+    utxo.put(makeOutPoint(12, 0), COIN, p2pkh(5));
+    EXPECT_EQ(utxo.size(), 1u);
+    // 400k coins (~9 MB encoded) passed through; live data is one coin, so the arena must have been compacted
+    EXPECT_LT(utxo.cacheUsage(), 4u << 20);
+    EXPECT_EQ(utxo.get(makeOutPoint(12, 0))->script_pubkey, p2pkh(5));
+}
+
+TEST(UTXOCache, ViewIsPointInTime) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 0, false);
+    for (uint32_t i = 0; i < 100; ++i) utxo.put(makeOutPoint(13, i), COIN, p2pkh(6));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    for (uint32_t i = 100; i < 200; ++i) utxo.put(makeOutPoint(13, i), COIN, p2pkh(6));
+
+    // Mutate the set from inside the scan: the view must neither see nor miss anything
+    size_t seen = 0;
+    bool mutated = false;
+    utxo.forEach([&](const OutPoint&, const Coin&) {
+        if (!mutated) {
+            mutated = true;
+            EXPECT_FALSE(utxo.needsFlush()); // deferred while the view is open
+            for (uint32_t i = 0; i < 200; i += 2) EXPECT_TRUE(utxo.spend(makeOutPoint(13, i)));
+            for (uint32_t i = 200; i < 300; ++i) utxo.put(makeOutPoint(13, i), COIN, p2pkh(6));
+        }
+        ++seen;
+        return true;
+    });
+    EXPECT_EQ(seen, 200u);
+    EXPECT_EQ(countCoins(utxo), 200u);
+    EXPECT_TRUE(utxo.needsFlush());
+
+    // Reads of backend coins from inside the scan must not block on the scan itself
+    seen = 0;
+    utxo.forEach([&](const OutPoint& out, const Coin&) {
+        OutPoint other = makeOutPoint(13, out.index ^ 1);
+        utxo.has(other);
+        ++seen;
+        return true;
+    });
+    EXPECT_EQ(seen, 200u);
+}
+
+TEST(UTXOCache, FlushWaitsForOpenViews) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 1 << 20, false);
+    for (uint32_t i = 0; i < 100; ++i) utxo.put(makeOutPoint(14, i), COIN, p2pkh(7));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    for (uint32_t i = 100; i < 150; ++i) utxo.put(makeOutPoint(14, i), COIN, p2pkh(7));
+
+    // Change the set and flush it while the scan runs: the scan keeps its point in time
+    std::vector<uint32_t> seen;
+    std::atomic<bool> flushed{false};
+    std::thread flusher;
+    utxo.forEach([&](const OutPoint& out, const Coin&) {
+        if (!flusher.joinable()) {
+            for (uint32_t i = 0; i < 150; i += 2) EXPECT_TRUE(utxo.spend(makeOutPoint(14, i)));
+            for (uint32_t i = 150; i < 200; ++i) utxo.put(makeOutPoint(14, i), COIN, p2pkh(7));
+            flusher = std::thread([&] { flushed = utxo.flush(uint256{}); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            EXPECT_FALSE(flushed.load());
+        }
+        seen.push_back(out.index);
+        return true;
+    });
+    flusher.join();
+    EXPECT_TRUE(flushed.load());
+    std::sort(seen.begin(), seen.end());
+    ASSERT_EQ(seen.size(), 150u);
+    for (uint32_t i = 0; i < 150; ++i) EXPECT_EQ(seen[i], i);
+    EXPECT_EQ(countCoins(utxo), 125u);
+    EXPECT_EQ(utxo.cacheEntries(), 0u);
+}
+
+TEST(MuHash, OrderFreeAndMergeable) {
+    std::vector<std::vector<uint8_t>> items;
+    for (uint8_t i = 0; i < 6; ++i) items.push_back(std::vector<uint8_t>(40, i));
+    MuHash3072 forward, backward, left, right;
+    for (size_t i = 0; i < items.size(); ++i) {
+        forward.insert(items[i].data(), items[i].size());
+        backward.insert(items[items.size() - 1 - i].data(), items[i].size());
+        (i % 2 ? left : right).insert(items[i].data(), items[i].size());
+    }
+    EXPECT_EQ(forward.digest(), backward.digest());
+    left *= right;
+    EXPECT_EQ(left.digest(), forward.digest());
+    EXPECT_NE(forward.digest(), MuHash3072().digest());
+
+    // Serialized state resumes exactly: one more insert matches a direct build
+    MuHash3072 resumed;
+    std::vector<uint8_t> state = forward.serialize();
+    ASSERT_TRUE(resumed.deserialize(state.data(), state.size()));
+    std::vector<uint8_t> extra(40, 0xee);
+    resumed.insert(extra.data(), extra.size());
+    forward.insert(extra.data(), extra.size());
+    EXPECT_EQ(resumed.digest(), forward.digest());
+    for (const auto& item : items) forward.remove(item.data(), item.size());
+    MuHash3072 single;
+    single.insert(extra.data(), extra.size());
+    EXPECT_EQ(forward.digest(), single.digest());
+}
+
+TEST(UTXOCache, StatsFollowChangesAndFlushes) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    UTXOSet utxo;
+    utxo.setBackend(&coins, 1 << 20, false);
+    UTXOSet reference;
+
+    for (uint32_t i = 0; i < 200; ++i) utxo.put(makeOutPoint(3, i), 1000 + i, p2pkh(3));
+    uint256 best{};
+    ASSERT_TRUE(utxo.flush(best));
+    for (uint32_t i = 0; i < 200; i += 2) ASSERT_TRUE(utxo.spend(makeOutPoint(3, i)));
+    utxo.put(makeOutPoint(4, 0), 7, p2pkh(4));
+    utxo.put(makeOutPoint(3, 1), 5, p2pkh(5), true); // overwrite replaces the old coin's element
+
+    reference.put(makeOutPoint(4, 0), 7, p2pkh(4));
+    reference.put(makeOutPoint(3, 1), 5, p2pkh(5));
+    uint64_t amount = 7 + 5;
+    for (uint32_t i = 3; i < 200; i += 2) {
+        reference.put(makeOutPoint(3, i), 1000 + i, p2pkh(3));
+        amount += 1000 + i;
+    }
+    CoinsStats stats = utxo.stats();
+    EXPECT_EQ(stats.coinCount, reference.size());
+    EXPECT_EQ(stats.totalAmount, amount);
+    EXPECT_EQ(stats.muhash.digest(), reference.stats().muhash.digest());
+
+    // Persisted totals come back with a fresh cache
+    ASSERT_TRUE(utxo.flush(best));
+    UTXOSet reopened;
+    reopened.setBackend(&coins, 1 << 20, false);
+    EXPECT_EQ(reopened.stats().totalAmount, amount);
+    EXPECT_EQ(reopened.stats().muhash.digest(), stats.muhash.digest());
+}
+
+TEST(CuckooFilter, NoFalseNegativesThroughChurn) {
+    CuckooFilter filter(20000);
+    auto item = [](uint64_t i) { return (i + 1) * 0x9e3779b97f4a7c15ULL; };
+    for (uint64_t i = 0; i < 18000; ++i) ASSERT_TRUE(filter.insert(item(i)));
+    for (uint64_t i = 0; i < 18000; i += 2) ASSERT_TRUE(filter.erase(item(i)));
+    for (uint64_t i = 18000; i < 27000; ++i) ASSERT_TRUE(filter.insert(item(i)));
+    EXPECT_EQ(filter.size(), 18000u);
+    for (uint64_t i = 1; i < 27000; i += i < 18000 ? 2 : 1) ASSERT_TRUE(filter.contains(item(i)));
+    size_t falsePositives = 0;
+    for (uint64_t i = 100000; i < 200000; ++i) falsePositives += filter.contains(item(i));
+    EXPECT_LT(falsePositives, 100u);
+
+    CuckooFilter tiny(8);
+    size_t inserted = 0;
+    while (inserted < 1000 && tiny.insert(item(inserted))) ++inserted;
+    EXPECT_LT(inserted, 1000u);
+    for (size_t i = 0; i <= inserted; ++i) EXPECT_TRUE(tiny.contains(item(i))); // overflow kept too
+}
+
+namespace {
+/** Counts backend reads so tests can see which lookups reach it. */
+class CountingView : public CoinsView {
+public:
+    explicit CountingView(CoinsView& inner) : inner_(inner) {}
+    std::optional<Coin> getCoin(const OutPoint& out) const override {
+        ++reads;
+        return inner_.getCoin(out);
+    }
+    bool batchWrite(const std::vector<Change>& changes, const uint256& best, const CoinsStats& stats) override {
+        return inner_.batchWrite(changes, best, stats);
+    }
+    uint256 getBestBlock() const override { return inner_.getBestBlock(); }
+    CoinsStats getStats() const override { return inner_.getStats(); }
+    void forEach(const Visitor& fn) const override { inner_.forEach(fn); }
+    bool clear() override { return inner_.clear(); }
+
+    mutable size_t reads = 0;
+
+private:
+    CoinsView& inner_;
+};
+} // namespace
+
+TEST(UTXOCache, FilterAnswersMissesWithoutBackendReads) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    CountingView counting(coins);
+    {
+        UTXOSet writer;
+        writer.setBackend(&coins, 1 << 20, false);
+        for (uint32_t i = 0; i < 500; ++i) writer.put(makeOutPoint(6, i), 1, p2pkh(6));
+        ASSERT_TRUE(writer.flush(uint256{}));
+    }
+    UTXOSet utxo;
+    utxo.setBackend(&counting, 1 << 20, false);
+    for (uint32_t i = 0; i < 500; ++i) EXPECT_FALSE(utxo.has(makeOutPoint(7, i)));
+    EXPECT_LT(counting.reads, 5u);
+
+    counting.reads = 0;
+    for (uint32_t i = 0; i < 500; ++i) EXPECT_TRUE(utxo.has(makeOutPoint(6, i)));
+    EXPECT_EQ(counting.reads, 500u);
+
+    // Spent coins leave the filter; new ones enter it before any flush
+    ASSERT_TRUE(utxo.spend(makeOutPoint(6, 0)));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    utxo.put(makeOutPoint(8, 0), 1, p2pkh(8));
+    counting.reads = 0;
+    EXPECT_FALSE(utxo.has(makeOutPoint(6, 0)));
+    EXPECT_TRUE(utxo.has(makeOutPoint(8, 0)));
+    EXPECT_LE(counting.reads, 1u);
+
+    // Outgrowing the filters falls back to backend reads until a flush rebuilds them
+    for (uint32_t i = 0; i < 80000; ++i) utxo.put(makeOutPoint(9, i), 1, p2pkh(9));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    counting.reads = 0;
+    for (uint32_t i = 0; i < 500; ++i) EXPECT_FALSE(utxo.has(makeOutPoint(7, i)));
+    EXPECT_LT(counting.reads, 5u);
+    EXPECT_TRUE(utxo.has(makeOutPoint(9, 79999)));
+}
+
+TEST(UTXOCache, WritesUnderViewCopyOnlyWhatChanges) {
+    auto db = createDatabase();
+    ASSERT_TRUE(db->open(""));
+    CoinsDB coins(*db);
+    CountingView counting(coins);
+    UTXOSet utxo;
+    utxo.setBackend(&counting, 64 << 20, false);
+    for (uint32_t i = 0; i < 1000; ++i) utxo.put(makeOutPoint(15, i), COIN, p2pkh(8));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    for (uint32_t i = 1000; i < 21000; ++i) utxo.put(makeOutPoint(15, i), COIN, p2pkh(8));
+    size_t usage = utxo.cacheUsage();
+
+    // Reads and writes touching every shard while a view is open must not copy the shards
+    size_t seen = 0;
+    bool mutated = false;
+    utxo.forEach([&](const OutPoint& out, const Coin&) {
+        EXPECT_LT(out.index, 21000u);
+        if (!mutated) {
+            mutated = true;
+            // Backend hits are not cached into a table the view shares, so they are read again
+            counting.reads = 0;
+            for (int pass = 0; pass < 2; ++pass) {
+                for (uint32_t i = 0; i < 1000; ++i) EXPECT_TRUE(utxo.has(makeOutPoint(15, i)));
+            }
+            EXPECT_EQ(counting.reads, 2000u);
+            for (uint32_t i = 0; i < 200; ++i) EXPECT_TRUE(utxo.spend(makeOutPoint(15, i * 5)));
+            for (uint32_t i = 21000; i < 21200; ++i) utxo.put(makeOutPoint(15, i), COIN, p2pkh(8));
+            EXPECT_LT(utxo.cacheUsage(), usage + usage / 4);
+        }
+        ++seen;
+        return true;
+    });
+    EXPECT_EQ(seen, 21000u);
+
+    // Once the view is gone the layers fold back and nothing is lost
+    utxo.put(makeOutPoint(15, 21200), COIN, p2pkh(8));
+    EXPECT_EQ(utxo.size(), 21001u);
+    EXPECT_EQ(countCoins(utxo), 21001u);
+    for (uint32_t i = 0; i < 1000; i += 5) EXPECT_FALSE(utxo.has(makeOutPoint(15, i)));
+    EXPECT_TRUE(utxo.has(makeOutPoint(15, 1)));
+    EXPECT_TRUE(utxo.has(makeOutPoint(15, 21100)));
+    ASSERT_TRUE(utxo.flush(uint256{}));
+    EXPECT_EQ(coins.getStats().coinCount, 21001u);
+    EXPECT_EQ(coins.getStats().muhash.digest(), utxo.stats().muhash.digest());
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "wallet/wallet.hpp"
+#include "crypto/address.hpp"
 
 using namespace shawncoin;
 
@@ -17,6 +18,16 @@ TEST(WalletTest, CreateSaveLoad) {
     ASSERT_EQ(m1, m2);
 }
 
+TEST(AddressTest, DecodeRoundTrip) {
+    uint8_t hash[20];
+    for (int i = 0; i < 20; ++i) hash[i] = (uint8_t)(i * 13 + 1);
+    std::string addr = pubKeyHashToAddress(hash);
+    std::vector<uint8_t> decoded = addressToPubKeyHash(addr);
+    ASSERT_EQ(decoded, std::vector<uint8_t>(hash, hash + 20));
+    addr.back() = addr.back() == '2' ? '3' : '2';
+    EXPECT_TRUE(addressToPubKeyHash(addr).empty());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
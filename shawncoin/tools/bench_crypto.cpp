@@ -0,0 +1,112 @@
+// bench_crypto - measure key, signing and verification throughput of the crypto layer.
+// Usage: bench_crypto [iterations] [threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "crypto/keys.h"
+#include "crypto/schnorr.h"
+#include "crypto/signatures.h"
+
+namespace {
+
+struct Sample {
+    unsigned char pub[33];
+    unsigned char hash[32];
+    unsigned char sig[64];
+    unsigned char schnorr[64];
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* what, size_t count, double seconds) {
+    std::printf("%-28s %8zu in %7.3f s  %10.0f /s\n", what, count, seconds, count / seconds);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? (size_t)std::strtoul(argv[1], nullptr, 10) : 2000;
+    unsigned threads = argc > 2 ? (unsigned)std::strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (iterations == 0) iterations = 1;
+    if (threads == 0) threads = 1;
+
+    std::vector<unsigned char> priv(32, 0x42);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        priv[0] = (unsigned char)i;
+        priv[1] = (unsigned char)(i >> 8);
+        shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+        if (!key) return 1;
+        shawncoin_keypair_destroy(key);
+    }
+    report("keypair_from_priv", iterations, secondsSince(start));
+
+    shawncoin_keypair_t* key = shawncoin_keypair_from_priv(priv.data());
+    if (!key) return 1;
+    std::vector<Sample> samples(iterations);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        Sample& s = samples[i];
+        shawncoin_sha256((const unsigned char*)&i, sizeof(i), s.hash);
+        size_t len = sizeof(s.sig);
+        if (shawncoin_sign(key, s.hash, s.sig, &len) != 1) return 1;
+    }
+    report("sign", iterations, secondsSince(start));
+    start = std::chrono::steady_clock::now();
+    for (auto& s : samples) {
+        if (shawncoin_schnorr_sign(key, s.hash, s.schnorr) != 1) return 1;
+    }
+    report("schnorr sign", iterations, secondsSince(start));
+    for (auto& s : samples) shawncoin_pubkey_get(key, s.pub);
+    shawncoin_keypair_destroy(key);
+
+    start = std::chrono::steady_clock::now();
+    for (const auto& s : samples) {
+        if (shawncoin_verify(s.pub, s.hash, s.sig, sizeof(s.sig)) != 1) return 1;
+    }
+    report("verify (1 thread)", iterations, secondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    for (const auto& s : samples) {
+        if (shawncoin_schnorr_verify(s.pub, s.hash, s.schnorr) != 1) return 1;
+    }
+    report("schnorr verify", iterations, secondsSince(start));
+
+    // Batches of the size a block's Schnorr inputs are split into
+    const size_t batch = 64;
+    std::vector<const unsigned char*> pubs, hashes, sigs;
+    for (const auto& s : samples) {
+        pubs.push_back(s.pub);
+        hashes.push_back(s.hash);
+        sigs.push_back(s.schnorr);
+    }
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i += batch) {
+        size_t n = std::min(batch, iterations - i);
+        if (shawncoin_schnorr_verify_batch(&pubs[i], &hashes[i], &sigs[i], n) != 1) return 1;
+    }
+    report("schnorr verify (batch 64)", iterations, secondsSince(start));
+
+    std::vector<std::thread> workers;
+    bool ok = true;
+    start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&samples, &ok]() {
+            for (const auto& s : samples)
+                if (shawncoin_verify(s.pub, s.hash, s.sig, sizeof(s.sig)) != 1) ok = false;
+        });
+    }
+    for (auto& w : workers) w.join();
+    char label[64];
+    std::snprintf(label, sizeof(label), "verify (%u threads)", threads);
+    report(label, iterations * threads, secondsSince(start));
+    return ok ? 0 : 1;
+}